@@ -80,7 +80,7 @@ extern"C" {
  *    and minor number definitions represent the complete version number for
  *    this interface.
  *****************************************************************************/
-#define QATZIP_API_VERSION_NUM_MINOR (3)
+#define QATZIP_API_VERSION_NUM_MINOR (4)
 
 /* Define a macro as an integer to test */
 #define QATZIP_API_VERSION    (QATZIP_API_VERSION_NUM_MAJOR * 10000 +      \
@@ -175,8 +175,11 @@ extern"C" {
 typedef enum QzHuffmanHdr_E {
     QZ_DYNAMIC_HDR = 0,
     /**< Full Dynamic Huffman Trees */
-    QZ_STATIC_HDR
+    QZ_STATIC_HDR,
     /**< Static Huffman Trees */
+    QZ_AUTO_HDR
+    /**< Chosen per chunk: static for small or high entropy chunks, */
+    /**< dynamic otherwise */
 } QzHuffmanHdr_T;
 
 /**
@@ -224,8 +227,8 @@ typedef enum QzDirection_E {
  * @description
  *      This enumerated list identifies the data format supported by
  *    QATzip streaming API. A format can be raw deflate data block, deflate
- *    block wrapped by GZip header and footer, or deflate data block wrapped
- *    by GZip extension header and footer.
+ *    block wrapped by GZip header and footer, deflate data block wrapped
+ *    by GZip extension header and footer, or a zlib stream.
  *
  *****************************************************************************/
 typedef enum QzDataFormat_E {
@@ -237,6 +240,10 @@ typedef enum QzDataFormat_E {
     /**< Data is in deflate wrapped by GZip extended header and footer */
     QZ_DEFLATE_RAW,
     /**< Data is in raw deflate format */
+    QZ_DEFLATE_ZLIB,
+    /**< Data is in deflate wrapped by zlib (RFC 1950) header and Adler-32 */
+    QZ_DEFLATE_BGZF,
+    /**< Data is in BGZF blocks (SAM/BAM spec), ended by an EOF block */
     QZ_FMT_NUM
 } QzDataFormat_T;
 
@@ -366,6 +373,26 @@ typedef struct QzSessionParams_S {
 #endif
     bool is_busy_polling;
     /**< true means busy polling */
+    unsigned int strm_flush_timeout;
+    /**< Latency deadline of qzCompressStream in microseconds. Pending */
+    /**< input older than this is flushed on the next call, as with */
+    /**< QZ_SYNC_FLUSH. 0 means disabled, which is the default */
+    unsigned char member_index;
+    /**< 1 appends a member index to QZ_DEFLATE_GZIP_EXT output on the */
+    /**< last call, see qzDecompressRange. With QZ_DEFLATE_BGZF the */
+    /**< blocks are kept for qzGetGziIndex instead. 0 means disabled */
+    unsigned int entropy_thrshold;
+    /**< Byte entropy, in 1/100 bit per byte, from which a chunk is */
+    /**< predicted incompressible and written as stored blocks without */
+    /**< being compressed. It is sampled before submission, between */
+    /**< 1 and 800, random bytes sample close to 800. The sample only */
+    /**< sees byte frequencies, not repetition, so this is opt-in: */
+    /**< 0 means disabled, which is the default */
+    unsigned char member_verify;
+    /**< 1 trial inflates the start of every std gzip member found */
+    /**< while decompressing before splitting the input there. 0 only */
+    /**< checks the header fields and the ISIZE of the footer in front */
+    /**< of it, which is the default */
 } QzSessionParams_T;
 
 #define QZ_HUFF_HDR_DEFAULT          QZ_DYNAMIC_HDR
@@ -388,6 +415,12 @@ typedef struct QzSessionParams_S {
 #define QZ_REQ_THRESHOLD_MAXIMUM     NUM_BUFF
 #define QZ_REQ_THRESHOLD_DEFAULT     QZ_REQ_THRESHOLD_MAXIMUM
 #define QZ_WAIT_CNT_THRESHOLD_DEFAULT 8
+#define QZ_STRM_FLUSH_TIMEOUT_DEFAULT 0
+#define QZ_MEMBER_INDEX_DEFAULT      0
+#define QZ_ENTROPY_THRESHOLD_DEFAULT 0
+#define QZ_ENTROPY_THRESHOLD_MAXIMUM 800
+#define QZ_MEMBER_VERIFY_DEFAULT     0
+#define QZ_DICT_MAX_SZ               (32 * 1024)
 #define QZ_DEFLATE_COMP_LVL_MINIMUM   (1)
 
 #include <cpa_dc.h>
@@ -399,6 +432,11 @@ typedef struct QzSessionParams_S {
 
 #define QZ_PERIODICAL_POLLING         (false)
 #define QZ_BUSY_POLLING               (true)
+
+/* Values of the last parameter of qzCompressStream */
+#define QZ_NO_FLUSH                   (0)
+#define QZ_FINISH                     (1)
+#define QZ_SYNC_FLUSH                 (2)
 /**
  *****************************************************************************
  * @ingroup qatZip
@@ -453,6 +491,16 @@ typedef struct QzStatus_S {
     /**< Support software algorithms */
     unsigned char algo_hw[QZ_MAX_ALGORITHMS];
     /**< Count of hardware devices supporting algorithms */
+    unsigned long chunks_sampled;
+    /**< Chunks of this session whose entropy was sampled */
+    unsigned long chunks_stored;
+    /**< Of them, chunks written as stored blocks, see entropy_thrshold */
+    unsigned long chunks_static_hdr;
+    /**< Chunks of a QZ_AUTO_HDR session given static Huffman trees */
+    unsigned long chunks_dynamic_hdr;
+    /**< Chunks of a QZ_AUTO_HDR session given dynamic Huffman trees */
+    unsigned long chunks_uniform;
+    /**< Chunks of one byte value written from a cached encoding */
 } QzStatus_T;
 
 /**
@@ -726,6 +774,65 @@ QATZIP_API int qzCompressCrc(QzSession_T *sess, const unsigned char *src,
                              unsigned int *dest_len, unsigned int last,
                              unsigned long *crc);
 
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Compress a buffer and return the Adler-32 checksum
+ *
+ * @description
+ *      This function behaves as qzCompressCrc, except that the checksum
+ *    accumulated in *adler is the Adler-32 of the consumed input, as used
+ *    by the zlib format (RFC 1950). The gzip members written to dest still
+ *    carry their CRC32 footers.
+ *
+ *    *adler should be 1 for the first call of a stream and is updated to
+ *    cover all input consumed so far.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      Yes
+ * @reentrant
+ *      No
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]       sess     Session handle
+ *                           (pointer to opaque instance and session data)
+ * @param[in]       src      Point to source buffer
+ * @param[in,out]   src_len  Length of source buffer. Modified to number
+ *                           of bytes consumed
+ * @param[in]       dest     Point to destination buffer
+ * @param[in,out]   dest_len Length of destination buffer. Modified
+ *                           to length of compressed data when
+ *                           function returns
+ * @param[in]       last     1 for 'No more data to be compressed'
+ *                           0 for 'More data to be compressed'
+ * @param[in,out]   adler    Point to Adler-32 checksum buffer
+ *
+ * @retval QZ_OK             Function executed successfully
+ * @retval QZ_FAIL           Function did not succeed
+ * @retval QZ_PARAMS         *sess is NULL or member of params is invalid
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      Only a synchronous version of this function is provided.
+ *
+ * @see
+ *      qzCompressCrc
+ *
+ *****************************************************************************/
+QATZIP_API int qzCompressAdler(QzSession_T *sess, const unsigned char *src,
+                               unsigned int *src_len, unsigned char *dest,
+                               unsigned int *dest_len, unsigned int last,
+                               unsigned long *adler);
+
 /**
  *****************************************************************************
  * @ingroup qatZip
@@ -782,6 +889,330 @@ QATZIP_API int qzDecompress(QzSession_T *sess, const unsigned char *src,
                             unsigned int *src_len, unsigned char *dest,
                             unsigned int *dest_len);
 
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Decompress a range of a gzip-ext archive
+ *
+ * @description
+ *      This function decompresses dest_len bytes starting at uncompressed
+ *    offset of an archive written with member_index set in
+ *    QzSessionParams_T. The trailing member index maps the offset to the
+ *    member holding it, so only the members covering the range are
+ *    decompressed, whatever the size of the archive.
+ *
+ *    The session must use the QZ_DEFLATE_GZIP_EXT data format.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      Yes
+ * @reentrant
+ *      No
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]      sess     Session handle
+ *                          (pointer to opaque instance and session data)
+ * @param[in]      src      Point to the whole compressed archive
+ * @param[in]      src_len  Length of the archive, including its index
+ * @param[in]      offset   Uncompressed offset of the first byte wanted
+ * @param[in]      dest     Point to destination buffer
+ * @param[in,out]  dest_len Length of the range wanted. Modified to the
+ *                          length returned, which is shorter when the
+ *                          range runs past the end of the data
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_FAIL          Function did not succeed
+ * @retval QZ_PARAMS        *sess is NULL or member of params is invalid
+ * @retval QZ_DATA_ERROR    src has no member index
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      Only a synchronous version of this function is provided.
+ *      Members written by the software fallback span a whole compress
+ *    call, so a range inside one is decompressed from that member start.
+ *
+ * @see
+ *      qzDecompress
+ *
+ *****************************************************************************/
+QATZIP_API int qzDecompressRange(QzSession_T *sess, const unsigned char *src,
+                                 unsigned long src_len, unsigned long offset,
+                                 unsigned char *dest, unsigned int *dest_len);
+
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Get the .gzi index of the last BGZF stream
+ *
+ * @description
+ *      This function writes the index of the BGZF blocks compressed since
+ *    the first call of the last stream, in the .gzi layout used by
+ *    htslib: the number of entries, then the compressed and uncompressed
+ *    offset of every block but the first, all as little endian 64 bit
+ *    integers.
+ *
+ *    The session must use the QZ_DEFLATE_BGZF data format with
+ *    member_index set in QzSessionParams_T. The index stays available
+ *    after the call with last set, until the next stream is compressed.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      No
+ * @reentrant
+ *      No
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]      sess     Session handle
+ *                          (pointer to opaque instance and session data)
+ * @param[in]      gzi      Point to destination buffer, may be NULL
+ * @param[in,out]  gzi_len  Length of the destination buffer. Modified to
+ *                          the length of the index
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_PARAMS        *sess is NULL or member of params is invalid
+ * @retval QZ_BUF_ERROR     gzi is too short, *gzi_len holds the length
+ *                          needed
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      Calling it with gzi set to NULL only returns the length.
+ *
+ * @see
+ *      qzCompress
+ *
+ *****************************************************************************/
+QATZIP_API int qzGetGziIndex(QzSession_T *sess, unsigned char *gzi,
+                             unsigned long *gzi_len);
+
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Get the decompressed size of compressed data
+ *
+ * @description
+ *      This function returns the exact size qzDecompress produces for src,
+ *    without decompressing it, so the destination buffer can be allocated
+ *    once. Gzip-ext and BGZF members record their sizes in the header, a
+ *    trailing member index records the total, and standard gzip members
+ *    are delimited the way qzDecompress finds them and give their ISIZE.
+ *
+ *    Raw deflate, zlib and 4B data do not record the decompressed size,
+ *    sessions set up with those data formats fail.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      No
+ * @reentrant
+ *      Yes
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]       sess      Session handle, may be NULL
+ * @param[in]       src       Point to the complete compressed data
+ * @param[in]       src_len   Length of src
+ * @param[out]      dest_len  Decompressed size of src
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_FAIL          The data format does not record the size
+ * @retval QZ_PARAMS        src or dest_len is NULL
+ * @retval QZ_DATA_ERROR    src is not complete gzip members
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      ISIZE is the size modulo 2^32, a standard gzip member of 4GB or
+ *    more is not sized right.
+ *
+ * @see
+ *      qzGetDecompressedSizeExt, qzDecompress
+ *
+ *****************************************************************************/
+QATZIP_API int qzGetDecompressedSize(QzSession_T *sess,
+                                     const unsigned char *src,
+                                     unsigned long src_len,
+                                     unsigned long *dest_len);
+
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Get the decompressed size and member count of compressed data
+ *
+ * @description
+ *      This function is qzGetDecompressedSize that also returns the number
+ *    of gzip members holding data. Member index members and empty
+ *    members, such as the BGZF EOF block, are not counted.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      No
+ * @reentrant
+ *      Yes
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]       sess        Session handle, may be NULL
+ * @param[in]       src         Point to the complete compressed data
+ * @param[in]       src_len     Length of src
+ * @param[out]      dest_len    Decompressed size of src
+ * @param[out]      member_cnt  Number of members, may be NULL
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_FAIL          The data format does not record the size
+ * @retval QZ_PARAMS        src or dest_len is NULL
+ * @retval QZ_DATA_ERROR    src is not complete gzip members
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      None
+ *
+ * @see
+ *      qzGetDecompressedSize
+ *
+ *****************************************************************************/
+QATZIP_API int qzGetDecompressedSizeExt(QzSession_T *sess,
+                                        const unsigned char *src,
+                                        unsigned long src_len,
+                                        unsigned long *dest_len,
+                                        unsigned long *member_cnt);
+
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Set the preset dictionary of a session
+ *
+ * @description
+ *      This function sets the dictionary both compression and
+ *    decompression start from, so small inputs find matches in it rather
+ *    than carrying no history. The same dictionary must be set to
+ *    decompress the data.
+ *
+ *    With QZ_DEFLATE_GZIP_EXT every chunk is a member of its own naming
+ *    the dictionary by its Adler-32 in a 'QD' subfield of the extra field,
+ *    QZ_DEFLATE_ZLIB sets FDICT and DICTID in the zlib header.
+ *    QZ_DEFLATE_RAW and QZ_DEFLATE_4B carry no dictionary ID. Standard
+ *    gzip and BGZF have no dictionary support and fail.
+ *
+ *    A NULL dict or a dict_len of 0 removes the dictionary.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      No
+ * @reentrant
+ *      No
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]       sess      Session handle, set up by qzSetupSession
+ * @param[in]       dict      Point to the dictionary, copied
+ * @param[in]       dict_len  Length of the dictionary, at most
+ *                            QZ_DICT_MAX_SZ
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_FAIL          A stream is in progress or out of memory
+ * @retval QZ_PARAMS        *sess is not set up, dict_len is too large or
+ *                          the data format has no dictionary support
+ * @pre
+ *      qzSetupSession has been called. It drops the dictionary
+ *    again.
+ * @post
+ *      None
+ * @note
+ *      The engine has no preset dictionary support, so a session with
+ *    a dictionary compresses and decompresses in software.
+ *
+ * @see
+ *      qzTrainDictionary
+ *
+ *****************************************************************************/
+QATZIP_API int qzSetDictionary(QzSession_T *sess, const unsigned char *dict,
+                               unsigned int dict_len);
+
+/**
+ *****************************************************************************
+ * @ingroup qatZip
+ *      Build a preset dictionary from sample records
+ *
+ * @description
+ *      This function builds a dictionary for qzSetDictionary out of
+ *    records like the ones to be compressed. It keeps the segments of
+ *    the records richest in byte strings that recur across records,
+ *    the most common ones at the end where deflate reaches them with
+ *    the shortest distances. Large sample sets are sampled.
+ *
+ * @context
+ *      This function shall not be called in an interrupt context.
+ * @assumptions
+ *      None
+ * @sideEffects
+ *      None
+ * @blocking
+ *      No
+ * @reentrant
+ *      Yes
+ * @threadSafe
+ *      Yes
+ *
+ * @param[in]       samples      Point to the records, back to back
+ * @param[in]       sample_lens  Length of each record
+ * @param[in]       sample_cnt   Number of records
+ * @param[in]       dict         Point to destination buffer
+ * @param[in,out]   dict_len     Length of the destination buffer.
+ *                               Modified to the dictionary length, which
+ *                               is 0 when no string recurs
+ *
+ * @retval QZ_OK            Function executed successfully
+ * @retval QZ_FAIL          Out of memory
+ * @retval QZ_PARAMS        A pointer is NULL or sample_cnt is 0
+ * @pre
+ *      None
+ * @post
+ *      None
+ * @note
+ *      None
+ *
+ * @see
+ *      qzSetDictionary
+ *
+ *****************************************************************************/
+QATZIP_API int qzTrainDictionary(const unsigned char *samples,
+                                 const unsigned int *sample_lens,
+                                 unsigned int sample_cnt,
+                                 unsigned char *dict, unsigned int *dict_len);
+
 /**
  *****************************************************************************
  * @ingroup qatZip
@@ -1196,7 +1627,8 @@ typedef struct QzStream_S {
     QzCrcType_T crc_type;
     /**< Checksum type in Adler, CRC32 or none */
     unsigned int crc_32;
-    /**< Checksum value */
+    /**< Checksum of the input accepted so far, CRC32 or Adler-32 as
+     *   selected by crc_type */
     unsigned long long reserved;
     /**< Reserved for future use */
     void *opaque;
@@ -1243,6 +1675,12 @@ typedef struct QzStream_S {
  *    will be the number of processed bytes held in QATzip. The calling API
  *    may have to process the destination buffer and call again.
  *
+ *    When last is QZ_SYNC_FLUSH, all pending input is compressed immediately
+ *    without ending the stream. The emitted data is byte aligned and can be
+ *    fully decompressed by the peer, at the cost of compression ratio. If
+ *    strm_flush_timeout in QzSessionParams_T is not 0, the same flush is
+ *    done on any call that finds pending input older than the timeout.
+ *
  * @context
  *      This function shall not be called in an interrupt context.
  * @assumptions
@@ -1261,6 +1699,8 @@ typedef struct QzStream_S {
  * @param[in,out]   strm     Stream handle
  * @param[in]       last     1 for 'No more data to be compressed'
  *                           0 for 'More data to be compressed'
+ *                           QZ_SYNC_FLUSH for 'Flush pending data and
+ *                           more data to be compressed'
  *                           (always set to 1 in the Microsoft(R)
  *                           Windows(TM) QATzip implementation)
  *
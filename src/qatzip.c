@@ -77,7 +77,7 @@ const unsigned int g_polling_interval[] = { 10, 10, 20, 30, 60, 100, 200, 400,
                                     / sizeof(unsigned int))
 #define MAX_GRAB_RETRY            (10)
 
-#define IS_DEFLATE(fmt)  (QZ_DEFLATE_RAW == (fmt))
+#define IS_DEFLATE(fmt)  (QZ_DEFLATE_RAW == (fmt) || QZ_DEFLATE_ZLIB == (fmt))
 #define IS_DEFLATE_OR_GZIP(fmt) \
         (QZ_DEFLATE_RAW == (fmt) || QZ_DEFLATE_GZIP == (fmt))
 
@@ -97,7 +97,11 @@ QzSessionParams_T g_sess_params_default = {
     .input_sz_thrshold = QZ_COMP_THRESHOLD_DEFAULT,
     .req_cnt_thrshold  = QZ_REQ_THRESHOLD_DEFAULT,
     .wait_cnt_thrshold = QZ_WAIT_CNT_THRESHOLD_DEFAULT,
-    .is_busy_polling   = QZ_PERIODICAL_POLLING
+    .is_busy_polling   = QZ_PERIODICAL_POLLING,
+    .strm_flush_timeout = QZ_STRM_FLUSH_TIMEOUT_DEFAULT,
+    .member_index      = QZ_MEMBER_INDEX_DEFAULT,
+    .entropy_thrshold  = QZ_ENTROPY_THRESHOLD_DEFAULT,
+    .member_verify     = QZ_MEMBER_VERIFY_DEFAULT
 };
 
 processData_T g_process = {
@@ -307,7 +311,7 @@ int qz_sessParamsCheck(QzSessionParams_T *params)
         return FAILURE;
     }
 
-    if (params->huffman_hdr > QZ_STATIC_HDR                   ||
+    if (params->huffman_hdr > QZ_AUTO_HDR                     ||
         params->direction > QZ_DIR_BOTH                       ||
         params->comp_lvl < 1                                  ||
         params->comp_lvl > QZ_DEFLATE_COMP_LVL_MAXIMUM        ||
@@ -320,13 +324,114 @@ int qz_sessParamsCheck(QzSessionParams_T *params)
         (params->hw_buff_sz & (params->hw_buff_sz - 1))       ||
         params->input_sz_thrshold < QZ_COMP_THRESHOLD_MINIMUM ||
         params->req_cnt_thrshold < QZ_REQ_THRESHOLD_MINIMUM   ||
-        params->req_cnt_thrshold > QZ_REQ_THRESHOLD_MAXIMUM) {
+        params->req_cnt_thrshold > QZ_REQ_THRESHOLD_MAXIMUM   ||
+        params->member_index > 1                              ||
+        params->entropy_thrshold > QZ_ENTROPY_THRESHOLD_MAXIMUM ||
+        params->member_verify > 1) {
         return FAILURE;
     }
 
     return SUCCESS;
 }
 
+/* log2(x) in 1/256 bits, x > 0 */
+static unsigned long log2Q8(unsigned long x)
+{
+    unsigned long e = 0, y;
+    int k;
+
+    while (x >> (e + 1)) {
+        e++;
+    }
+    /* y is x / 2^e in Q16, square it for each bit of the fraction */
+    y = (x << 16) >> e;
+    e <<= 8;
+    for (k = 7; k >= 0; k--) {
+        y = (y * y) >> 16;
+        if (y >= (2UL << 16)) {
+            y >>= 1;
+            e |= 1UL << k;
+        }
+    }
+    return e;
+}
+
+/*
+ * Estimates the byte entropy of a chunk, in 1/100 bit per byte, from a
+ * histogram of a few strided samples. Encrypted or already compressed
+ * data is close to 800. Returns 0 when nothing asks for it.
+ */
+unsigned int sampleChunk(QzSess_T *qz_sess, const unsigned char *src,
+                         unsigned int len)
+{
+    unsigned int hist[256] = {0};
+    unsigned int i, k, n, stride;
+    unsigned long sum = 0, entropy;
+
+    if ((0 == qz_sess->sess_params.entropy_thrshold &&
+         QZ_AUTO_HDR != qz_sess->sess_params.huffman_hdr) ||
+        len < QZ_SAMPLE_SZ) {
+        return 0;
+    }
+
+    if (len <= QZ_SAMPLE_CNT * QZ_SAMPLE_SZ) {
+        for (i = 0; i < len; i++) {
+            hist[src[i]]++;
+        }
+        n = len;
+    } else {
+        stride = (len - QZ_SAMPLE_SZ) / (QZ_SAMPLE_CNT - 1);
+        for (k = 0; k < QZ_SAMPLE_CNT; k++) {
+            for (i = 0; i < QZ_SAMPLE_SZ; i++) {
+                hist[src[k * stride + i]]++;
+            }
+        }
+        n = QZ_SAMPLE_CNT * QZ_SAMPLE_SZ;
+    }
+
+    /* H = log2(n) - sum(c * log2(c)) / n */
+    for (i = 0; i < 256; i++) {
+        if (hist[i]) {
+            sum += hist[i] * log2Q8(hist[i]);
+        }
+    }
+    entropy = log2Q8(n) - sum / n;
+
+    qz_sess->chunks_sampled++;
+    return (unsigned int)((entropy * 100) >> 8);
+}
+
+/* Deflate would only give such a chunk back as stored blocks */
+int isIncompressible(QzSess_T *qz_sess, unsigned int entropy)
+{
+    unsigned int thrshold = qz_sess->sess_params.entropy_thrshold;
+
+    if (0 == thrshold || entropy < thrshold) {
+        return 0;
+    }
+    qz_sess->chunks_stored++;
+    return 1;
+}
+
+/*
+ * Dynamic trees cost a header and gain little when a chunk is tiny or
+ * its bytes are close to uniform, static ones are faster to build.
+ */
+QzHuffmanHdr_T chooseHuffmanHdr(QzSess_T *qz_sess, unsigned int entropy,
+                                unsigned int len)
+{
+    if (QZ_AUTO_HDR != qz_sess->sess_params.huffman_hdr) {
+        return qz_sess->sess_params.huffman_hdr;
+    }
+
+    if (len < QZ_AUTO_HDR_MIN_SZ || entropy >= QZ_AUTO_HDR_ENTROPY) {
+        qz_sess->chunks_static_hdr++;
+        return QZ_STATIC_HDR;
+    }
+    qz_sess->chunks_dynamic_hdr++;
+    return QZ_DYNAMIC_HDR;
+}
+
 static void stopQat(void)
 {
     int i;
@@ -669,6 +774,7 @@ static void cleanUpInstMem(int i)
     }
 
     qzFree(g_process.qz_inst[i].cpaSess);
+    qzFree(g_process.qz_inst[i].cpaSessStatic);
     g_process.qz_inst[i].mem_setup = 0;
 }
 
@@ -876,11 +982,26 @@ int qzSetupSession(QzSession_T *sess, QzSessionParams_T *params)
     qz_sess->inflate_stat = InflateNull;
     qz_sess->deflate_strm = NULL;
     qz_sess->deflate_stat = DeflateNull;
+    qz_sess->zlib_started = 0;
+    qz_sess->zlib_adler = 1;
+    qz_sess->mbr_idx_cnt = 0;
+    qz_sess->mbr_comp_off = 0;
+    qz_sess->mbr_orig_off = 0;
+    qz_sess->mbr_idx_closed = 0;
+    qz_sess->chunks_sampled = 0;
+    qz_sess->chunks_stored = 0;
+    qz_sess->chunks_static_hdr = 0;
+    qz_sess->chunks_dynamic_hdr = 0;
+    qz_sess->chunks_uniform = 0;
+    free(qz_sess->dict);
+    qz_sess->dict = NULL;
+    qz_sess->dict_len = 0;
+    qz_sess->dict_id = 0;
 
     /*set up cpaDc Session params*/
     qz_sess->session_setup_data.compLevel = qz_sess->sess_params.comp_lvl;
     qz_sess->session_setup_data.compType = CPA_DC_DEFLATE;
-    if (qz_sess->sess_params.huffman_hdr == QZ_DYNAMIC_HDR) {
+    if (qz_sess->sess_params.huffman_hdr != QZ_STATIC_HDR) {
         qz_sess->session_setup_data.huffType = CPA_DC_HT_FULL_DYNAMIC;
     } else {
         qz_sess->session_setup_data.huffType = CPA_DC_HT_STATIC;
@@ -925,6 +1046,38 @@ int qzSetupSession(QzSession_T *sess, QzSessionParams_T *params)
     return sess->hw_session_stat;
 }
 
+/* Set up the static Huffman session of instance i that QZ_AUTO_HDR
+ * requests are sent to when chooseHuffmanHdr picks static trees
+ */
+static int setupStaticSession(QzSess_T *qz_sess, int i)
+{
+    CpaDcSessionSetupData setup_data = qz_sess->session_setup_data;
+    CpaDcSessionHandle cpa_sess;
+    Cpa32U session_size, ctx_size;
+
+    setup_data.huffType = CPA_DC_HT_STATIC;
+    if (CPA_STATUS_SUCCESS !=
+        cpaDcGetSessionSize(g_process.dc_inst_handle[i], &setup_data,
+                            &session_size, &ctx_size)) {
+        return QZ_FAIL;
+    }
+
+    cpa_sess = qzMalloc((size_t)session_size, NODE_0, PINNED_MEM);
+    if (NULL == cpa_sess) {
+        return qz_sess->sess_params.sw_backup ? QZ_LOW_MEM : QZ_NOSW_LOW_MEM;
+    }
+
+    if (CPA_STATUS_SUCCESS !=
+        cpaDcInitSession(g_process.dc_inst_handle[i], cpa_sess, &setup_data,
+                         NULL, dcCallback)) {
+        qzFree(cpa_sess);
+        return QZ_FAIL;
+    }
+    g_process.qz_inst[i].cpaSessStatic = cpa_sess;
+
+    return QZ_OK;
+}
+
 /* Set up the QAT session associate with current process's
  * QAT instance
  */
@@ -991,6 +1144,12 @@ int qzSetupHW(QzSession_T *sess, int i)
         g_process.qz_inst[i].cpa_sess_setup = 1;
     }
 
+    if (rc == QZ_OK &&
+        QZ_AUTO_HDR == qz_sess->sess_params.huffman_hdr &&
+        NULL == g_process.qz_inst[i].cpaSessStatic) {
+        rc = setupStaticSession(qz_sess, i);
+    }
+
 done_sess:
     return rc;
 }
@@ -1009,6 +1168,9 @@ static void *doCompressIn(void *in)
     unsigned int src_sz, dest_sz;
     CpaStatus rc;
     int src_pinned, dest_pinned;
+    unsigned int entropy;
+    const QzRunEnc_T *run;
+    CpaDcSessionHandle cpa_sess;
     QzDataFormat_T data_fmt;
     QzSession_T *sess = (QzSession_T *)in;
     QzSess_T *qz_sess = (QzSess_T *)sess->internal;
@@ -1029,7 +1191,7 @@ static void *doCompressIn(void *in)
     src_pinned = qzMemFindAddr(src_ptr);
     dest_pinned = qzMemFindAddr(dest_ptr);
     remaining = *qz_sess->src_sz - qz_sess->qz_in_len;
-    src_sz = qz_sess->sess_params.hw_buff_sz;
+    src_sz = CHUNK_SZ(qz_sess);
     dest_sz = *qz_sess->dest_sz;
     data_fmt = qz_sess->sess_params.data_fmt;
     opData.flushFlag = IS_DEFLATE(data_fmt) ? CPA_DC_FLUSH_FULL :
@@ -1069,14 +1231,34 @@ static void *doCompressIn(void *in)
                 dest_sz - outputHeaderSz(data_fmt);
         }
 
-        if (0 == src_pinned) {
+        /* a run of one byte value has a cached encoding, nothing to stage */
+        run = qzUniformChunk(qz_sess, src_ptr, src_send_sz,
+                             !IS_DEFLATE(data_fmt) ||
+                             CPA_DC_FLUSH_FINAL == opData.flushFlag);
+        if (NULL != run && run->enc_len >
+            g_process.qz_inst[i].dest_buffers[j]->pBuffers->dataLenInBytes) {
+            run = NULL;
+        }
+        if (NULL != run) {
+            g_process.qz_inst[i].stream[j].src_pinned = 0;
+        } else if (0 == src_pinned) {
             QZ_DEBUG("memory copy in doCompressIn\n");
-            QZ_MEMCPY(g_process.qz_inst[i].src_buffers[j]->pBuffers->pData,
-                      src_ptr,
-                      src_send_sz,
-                      src_send_sz);
+            if (NULL != qz_sess->crc32 && QZ_ADLER == qz_sess->crc_type) {
+                g_process.qz_inst[i].stream[j].adler =
+                    qzCopyAdler32(g_process.qz_inst[i].src_buffers[j]->pBuffers->pData,
+                                  src_ptr, src_send_sz, 1);
+            } else {
+                QZ_MEMCPY(g_process.qz_inst[i].src_buffers[j]->pBuffers->pData,
+                          src_ptr,
+                          src_send_sz,
+                          src_send_sz);
+            }
             g_process.qz_inst[i].stream[j].src_pinned = 0;
         } else {
+            if (NULL != qz_sess->crc32 && QZ_ADLER == qz_sess->crc_type) {
+                g_process.qz_inst[i].stream[j].adler =
+                    qzAdler32(1, src_ptr, src_send_sz);
+            }
             QZ_DEBUG("changing src_ptr to 0x%lx\n", (unsigned long)src_ptr);
             g_process.qz_inst[i].stream[j].src_pinned = 1;
             g_process.qz_inst[i].stream[j].orig_src =
@@ -1094,13 +1276,40 @@ static void *doCompressIn(void *in)
         }
 
         g_process.qz_inst[i].stream[j].res.checksum = 0;
+        if (NULL != run) {
+            memcpy(g_process.qz_inst[i].dest_buffers[j]->pBuffers->pData,
+                   run->enc, run->enc_len);
+            g_process.qz_inst[i].stream[j].res.status = CPA_DC_OK;
+            g_process.qz_inst[i].stream[j].res.produced = run->enc_len;
+            g_process.qz_inst[i].stream[j].res.consumed = src_send_sz;
+            g_process.qz_inst[i].stream[j].res.checksum = run->crc32;
+            g_process.qz_inst[i].stream[j].adler = run->adler;
+            g_process.qz_inst[i].stream[j].job_status = CPA_STATUS_SUCCESS;
+            g_process.qz_inst[i].stream[j].sink1++;
+            rc = CPA_STATUS_SUCCESS;
+            goto submitted;
+        }
+        entropy = sampleChunk(qz_sess, src_ptr, src_send_sz);
+        /* skip the engine, complete it as the callback would */
+        if (isIncompressible(qz_sess, entropy)) {
+            g_process.qz_inst[i].stream[j].stored = 1;
+            g_process.qz_inst[i].stream[j].job_status = CPA_STATUS_SUCCESS;
+            g_process.qz_inst[i].stream[j].sink1++;
+            rc = CPA_STATUS_SUCCESS;
+            goto submitted;
+        }
+        cpa_sess = g_process.qz_inst[i].cpaSess;
+        if (QZ_STATIC_HDR == chooseHuffmanHdr(qz_sess, entropy, src_send_sz) &&
+            NULL != g_process.qz_inst[i].cpaSessStatic) {
+            cpa_sess = g_process.qz_inst[i].cpaSessStatic;
+        }
         do {
             tag = (i << 16) | j;
             QZ_DEBUG("Comp Sending %u bytes ,opData.flushFlag = %d, i = %ld j = %d seq = %ld tag = %ld\n",
                      g_process.qz_inst[i].src_buffers[j]->pBuffers->dataLenInBytes, opData.flushFlag,
                      i, j, g_process.qz_inst[i].stream[j].seq, tag);
             rc = cpaDcCompressData2(g_process.dc_inst_handle[i],
-                                    g_process.qz_inst[i].cpaSess,
+                                    cpa_sess,
                                     g_process.qz_inst[i].src_buffers[j],
                                     g_process.qz_inst[i].dest_buffers[j],
                                     &opData,
@@ -1123,6 +1332,7 @@ static void *doCompressIn(void *in)
             goto err_exit;
         }
 
+submitted:
         QZ_DEBUG("remaining = %u, src_send_sz = %u, seq = %ld\n", remaining,
                  src_send_sz,  qz_sess->seq);
         g_process.qz_inst[i].num_retries = 0;
@@ -1163,6 +1373,20 @@ err_exit:
     return ((void *)NULL);
 }
 
+/* Adler-32 of the bytes a request consumed. It was taken over the whole
+ * request at submit time, redo it over the source if the engine stopped
+ * short of that.
+ */
+static unsigned long consumedAdler32(int i, int j, unsigned int consumed)
+{
+    CpaFlatBuffer *src = g_process.qz_inst[i].src_buffers[j]->pBuffers;
+
+    if (likely(consumed == src->dataLenInBytes)) {
+        return g_process.qz_inst[i].stream[j].adler;
+    }
+    return qzAdler32(1, src->pData, consumed);
+}
+
 /* The internal function to g_process the comrpession response
  * from the QAT hardware
  */
@@ -1230,13 +1454,19 @@ static void *doCompressOut(void *in)
                 QZ_DEBUG("\tconsumed = %d, produced = %d, seq_in = %ld\n",
                          resl->consumed, resl->produced, g_process.qz_inst[i].stream[j].seq);
 
-                if (unlikely(CPA_DC_VERIFY_ERROR == resl->status)) {
+                /* a BGZF block that would outgrow 64K is stored instead */
+                if (unlikely(g_process.qz_inst[i].stream[j].stored ||
+                             CPA_DC_VERIFY_ERROR == resl->status ||
+                             (QZ_DEFLATE_BGZF == data_fmt &&
+                              outputHeaderSz(data_fmt) + resl->produced +
+                              outputFooterSz(data_fmt) > QZ_BGZF_BLK_MAX_SZ))) {
                     long src_len;
                     int src_location;
                     long block_count;
                     int out_len;
                     // detected a CnV error
                     src_len = g_process.qz_inst[i].src_buffers[j]->pBuffers->dataLenInBytes;
+                    g_process.qz_inst[i].stream[j].stored = 0;
 
                     {
                         // Create the stored block(s) for
@@ -1290,8 +1520,12 @@ static void *doCompressOut(void *in)
                                 this_block_len = STORED_BLK_MAX_LEN;
                             }
                             src_len -= this_block_len;
-                            // create store block header here
-                            if (src_len == 0) {
+                            // create store block header here, only the
+                            // last chunk of a deflate stream is final
+                            if (src_len == 0 &&
+                                (!IS_DEFLATE(data_fmt) ||
+                                 (1 == qz_sess->last &&
+                                  qz_sess->qz_in_len == *qz_sess->src_sz))) {
                                 //set bfinal bit + block type
                                 *(unsigned char *)(qz_sess->next_dest) = 0x01;
                                 QZ_DEBUG("Creating the final block\n");
@@ -1309,15 +1543,11 @@ static void *doCompressOut(void *in)
                             qz_sess->next_dest += 2;
                             *(unsigned short *)(qz_sess->next_dest) = ~this_block_len;
                             qz_sess->next_dest += 2;
-                            // copy the source data
-                            QZ_MEMCPY(qz_sess->next_dest,
-                                      &g_process.qz_inst[i].src_buffers[j]->pBuffers->pData[src_location],
-                                      this_block_len,
-                                      this_block_len);
-                            // update the crc
-                            resl->checksum = crc32(resl->checksum,
-                                                   &g_process.qz_inst[i].src_buffers[j]->pBuffers->pData[src_location],
-                                                   this_block_len);
+                            // copy the source data and update the crc
+                            resl->checksum = qzCopyCrc32(qz_sess->next_dest,
+                                                         &g_process.qz_inst[i].src_buffers[j]->pBuffers->pData[src_location],
+                                                         this_block_len,
+                                                         resl->checksum);
                             // jump to next source data location
                             qz_sess->next_dest += this_block_len;
                             src_location += this_block_len;
@@ -1326,9 +1556,23 @@ static void *doCompressOut(void *in)
                         }
                         QZ_DEBUG("\tgzip checksum = 0x%x\n", resl->checksum);
                         QZ_DEBUG("\tlen = 0x%x\n", resl->produced);
+                        if (likely(NULL != qz_sess->crc32)) {
+                            if (QZ_ADLER == qz_sess->crc_type) {
+                                *(qz_sess->crc32) =
+                                    adler32_combine(*(qz_sess->crc32),
+                                                    consumedAdler32(i, j, resl->consumed),
+                                                    resl->consumed);
+                            } else {
+                                *(qz_sess->crc32) =
+                                    qzCrc32Combine(*(qz_sess->crc32), resl->checksum, resl->consumed);
+                            }
+                        }
                         //Append footer
                         outputFooterGen(qz_sess, resl, data_fmt);
-                        qz_sess->next_dest += stdGzipFooterSz();
+                        qz_sess->next_dest += outputFooterSz(data_fmt);
+                        if (IS_MEMBER_INDEXED(qz_sess)) {
+                            qzMemberIndexAdd(qz_sess, out_len, resl->consumed);
+                        }
                         if (1 == g_process.qz_inst[i].stream[j].src_pinned) {
                             g_process.qz_inst[i].src_buffers[j]->pBuffers->pData =
                                 g_process.qz_inst[i].stream[j].orig_src;
@@ -1371,14 +1615,20 @@ static void *doCompressOut(void *in)
                     qz_sess->next_dest += resl->produced;
                     qz_sess->qz_in_len += resl->consumed;
 
-                    if (likely(NULL != qz_sess->crc32)) {
+                    if (likely(NULL != qz_sess->crc32) &&
+                        QZ_ADLER == qz_sess->crc_type) {
+                        *(qz_sess->crc32) =
+                            adler32_combine(*(qz_sess->crc32),
+                                            consumedAdler32(i, j, resl->consumed),
+                                            resl->consumed);
+                    } else if (likely(NULL != qz_sess->crc32)) {
                         if (0 == *(qz_sess->crc32)) {
                             *(qz_sess->crc32) = resl->checksum;
                             QZ_DEBUG("crc32 1st blk is 0x%lX \n", *(qz_sess->crc32));
                         } else {
                             QZ_DEBUG("crc32 input 0x%lX, ", *(qz_sess->crc32));
                             *(qz_sess->crc32) =
-                                crc32_combine(*(qz_sess->crc32), resl->checksum, resl->consumed);
+                                qzCrc32Combine(*(qz_sess->crc32), resl->checksum, resl->consumed);
                             QZ_DEBUG("Result 0x%lX, checksum 0x%X, consumed %u, produced %u\n",
                                      *(qz_sess->crc32), resl->checksum, resl->consumed, resl->produced);
                         }
@@ -1388,6 +1638,12 @@ static void *doCompressOut(void *in)
                     outputFooterGen(qz_sess, resl, data_fmt);
                     qz_sess->next_dest += outputFooterSz(data_fmt);
                     qz_sess->qz_out_len += outputFooterSz(data_fmt);
+                    if (IS_MEMBER_INDEXED(qz_sess)) {
+                        qzMemberIndexAdd(qz_sess,
+                                         outputHeaderSz(data_fmt) + resl->produced +
+                                         outputFooterSz(data_fmt),
+                                         resl->consumed);
+                    }
 
                     if (1 == g_process.qz_inst[i].stream[j].src_pinned) {
                         g_process.qz_inst[i].src_buffers[j]->pBuffers->pData =
@@ -1524,69 +1780,24 @@ int qzCompress(QzSession_T *sess, const unsigned char *src,
     return qzCompressCrc(sess, src, src_len, dest, dest_len, last, NULL);
 }
 
-int qzCompressCrc(QzSession_T *sess, const unsigned char *src,
-                  unsigned int *src_len, unsigned char *dest,
-                  unsigned int *dest_len, unsigned int last, unsigned long *crc)
+/* Compresses src hw_buff_sz at a time, each chunk framed per data_fmt */
+static int compressChunks(QzSession_T *sess, const unsigned char *src,
+                          unsigned int *src_len, unsigned char *dest,
+                          unsigned int *dest_len, unsigned int last,
+                          unsigned long *crc, QzCrcType_T crc_type)
 {
     int i, reqcnt;
     unsigned int out_len;
-    QzSess_T *qz_sess;
+    QzSess_T *qz_sess = (QzSess_T *)(sess->internal);
     int rc;
 
-    if (unlikely(NULL == sess     || \
-                 NULL == src      || \
-                 NULL == src_len  || \
-                 NULL == dest     || \
-                 NULL == dest_len || \
-                 (last != 0 && last != 1))) {
-        if (NULL != src_len) {
-            *src_len = 0;
-        }
-        if (NULL != dest_len) {
-            *dest_len = 0;
-        }
-        return QZ_PARAMS;
-    }
-
-
-    /*check if init called*/
-    rc = qzInit(sess, getSwBackup(sess));
-    if (QZ_INIT_FAIL(rc)) {
-        *src_len = 0;
-        *dest_len = 0;
-        return rc;
-    }
-
-    /*check if setupSession called*/
-    if (NULL == sess->internal || QZ_NONE == sess->hw_session_stat) {
-        rc = qzSetupSession(sess, NULL);
-        if (unlikely(QZ_SETUP_SESSION_FAIL(rc))) {
-            *src_len = 0;
-            *dest_len = 0;
-            return rc;
-        }
-    }
-
-    qz_sess = (QzSess_T *)(sess->internal);
-
-    QzDataFormat_T data_fmt = qz_sess->sess_params.data_fmt;
-    if (unlikely(data_fmt != QZ_DEFLATE_4B &&
-                 data_fmt != QZ_DEFLATE_RAW &&
-                 data_fmt != QZ_DEFLATE_GZIP &&
-                 data_fmt != QZ_DEFLATE_GZIP_EXT)) {
-        QZ_ERROR("Unknown data formt: %d\n", data_fmt);
-        *src_len = 0;
-        *dest_len = 0;
-        return QZ_PARAMS;
-    }
-    QZ_DEBUG("qzCompressCrc data_fmt: %d, input crc32 is 0x%lX\n",
-             data_fmt, crc ? *crc : 0);
-
     qz_sess->crc32 = crc;
+    qz_sess->crc_type = crc_type;
 
     if (*src_len < qz_sess->sess_params.input_sz_thrshold
          || g_process.qz_init_status == QZ_NO_HW
          || sess->hw_session_stat == QZ_NO_HW
+         || NULL != qz_sess->dict
 #if !((CPA_DC_API_VERSION_NUM_MAJOR >= 3) && (CPA_DC_API_VERSION_NUM_MINOR >= 0))
          || qz_sess->sess_params.comp_lvl == 9
 #endif
@@ -1692,6 +1903,237 @@ sw_compression:
     return qzSWCompress(sess, src, src_len, dest, dest_len, last);
 }
 
+/*
+ * QZ_DEFLATE_ZLIB: chunks are compressed as one raw deflate stream
+ * across calls, wrapped in a zlib header on the first call and the
+ * Adler-32 trailer on the last one.
+ */
+static int compressZlib(QzSession_T *sess, const unsigned char *src,
+                        unsigned int *src_len, unsigned char *dest,
+                        unsigned int *dest_len, unsigned int last,
+                        unsigned long *crc, QzCrcType_T crc_type)
+{
+    QzSess_T *qz_sess = (QzSess_T *)(sess->internal);
+    unsigned int hdr_sz = qz_sess->zlib_started ? 0 : zlibHeaderSz(qz_sess);
+    unsigned int ftr_sz = last ? zlibFooterSz() : 0;
+    unsigned long adler = 1;
+    int rc;
+
+    if (*dest_len < hdr_sz + ftr_sz) {
+        *src_len = 0;
+        *dest_len = 0;
+        return QZ_BUF_ERROR;
+    }
+
+    if (hdr_sz) {
+        zlibHeaderGen(dest, qz_sess);
+    }
+    *dest_len -= hdr_sz + ftr_sz;
+    rc = compressChunks(sess, src, src_len, dest + hdr_sz, dest_len, last,
+                        &adler, QZ_ADLER);
+    /* the header and the checksums only count once the stream made
+     * progress, a failed first call leaves the session unstarted */
+    if (QZ_OK != rc && (QZ_BUF_ERROR != rc || 0 == *src_len)) {
+        *src_len = 0;
+        *dest_len = 0;
+        return rc;
+    }
+    *dest_len += hdr_sz;
+    qz_sess->zlib_started = 1;
+
+    qz_sess->zlib_adler = adler32_combine(qz_sess->zlib_adler, adler,
+                                          *src_len);
+    if (NULL != crc) {
+        *crc = (QZ_ADLER == crc_type) ?
+               adler32_combine(*crc, adler, *src_len) :
+               qzCrc32(*crc, src, *src_len);
+    }
+
+    if (QZ_OK == rc && last) {
+        zlibFooterGen(dest + *dest_len, qz_sess->zlib_adler);
+        *dest_len += ftr_sz;
+        qz_sess->zlib_started = 0;
+        qz_sess->zlib_adler = 1;
+    }
+
+    return rc;
+}
+
+/*
+ * Gzip-ext with member_index: members are recorded as they are written
+ * and the index of all of them follows the last call's output.
+ */
+static int compressIndexed(QzSession_T *sess, const unsigned char *src,
+                           unsigned int *src_len, unsigned char *dest,
+                           unsigned int *dest_len, unsigned int last,
+                           unsigned long *crc, QzCrcType_T crc_type)
+{
+    QzSess_T *qz_sess = (QzSess_T *)(sess->internal);
+    unsigned long cnt = qz_sess->mbr_idx_cnt +
+                        *src_len / qz_sess->sess_params.hw_buff_sz + 2;
+    unsigned long idx_sz = last ? qzMemberIndexSz(cnt) : 0;
+    int rc;
+
+    if (QZ_OK != qzMemberIndexReserve(qz_sess, cnt)) {
+        *src_len = 0;
+        *dest_len = 0;
+        return QZ_FAIL;
+    }
+    if (*dest_len < idx_sz) {
+        *src_len = 0;
+        *dest_len = 0;
+        return QZ_BUF_ERROR;
+    }
+
+    *dest_len -= idx_sz;
+    rc = compressChunks(sess, src, src_len, dest, dest_len, last,
+                        crc, crc_type);
+    if (QZ_OK == rc && last) {
+        *dest_len += qzMemberIndexGen(qz_sess, dest + *dest_len);
+    }
+
+    return rc;
+}
+
+/*
+ * BGZF: blocks of at most 64K, the EOF block follows the last call's
+ * output. With member_index the blocks stay recorded for qzGetGziIndex
+ * until the next stream starts.
+ */
+static int compressBgzf(QzSession_T *sess, const unsigned char *src,
+                        unsigned int *src_len, unsigned char *dest,
+                        unsigned int *dest_len, unsigned int last,
+                        unsigned long *crc, QzCrcType_T crc_type)
+{
+    QzSess_T *qz_sess = (QzSess_T *)(sess->internal);
+    unsigned long eof_sz = last ? bgzfEofSz() : 0;
+    unsigned long cnt;
+    int rc;
+
+    if (qz_sess->mbr_idx_closed) {
+        qz_sess->mbr_idx_cnt = 0;
+        qz_sess->mbr_comp_off = 0;
+        qz_sess->mbr_orig_off = 0;
+        qz_sess->mbr_idx_closed = 0;
+    }
+    if (IS_MEMBER_INDEXED(qz_sess)) {
+        cnt = qz_sess->mbr_idx_cnt + *src_len / CHUNK_SZ(qz_sess) + 2;
+        if (QZ_OK != qzMemberIndexReserve(qz_sess, cnt)) {
+            *src_len = 0;
+            *dest_len = 0;
+            return QZ_FAIL;
+        }
+    }
+    if (*dest_len < eof_sz) {
+        *src_len = 0;
+        *dest_len = 0;
+        return QZ_BUF_ERROR;
+    }
+
+    *dest_len -= eof_sz;
+    rc = compressChunks(sess, src, src_len, dest, dest_len, last,
+                        crc, crc_type);
+    if (QZ_OK == rc && last) {
+        bgzfEofGen(dest + *dest_len);
+        *dest_len += eof_sz;
+        qz_sess->mbr_idx_closed = 1;
+    }
+
+    return rc;
+}
+
+static int compressWithChecksum(QzSession_T *sess, const unsigned char *src,
+                                unsigned int *src_len, unsigned char *dest,
+                                unsigned int *dest_len, unsigned int last,
+                                unsigned long *crc, QzCrcType_T crc_type)
+{
+    QzSess_T *qz_sess;
+    int rc;
+
+    if (unlikely(NULL == sess     || \
+                 NULL == src      || \
+                 NULL == src_len  || \
+                 NULL == dest     || \
+                 NULL == dest_len || \
+                 (last != 0 && last != 1))) {
+        if (NULL != src_len) {
+            *src_len = 0;
+        }
+        if (NULL != dest_len) {
+            *dest_len = 0;
+        }
+        return QZ_PARAMS;
+    }
+
+
+    /*check if init called*/
+    rc = qzInit(sess, getSwBackup(sess));
+    if (QZ_INIT_FAIL(rc)) {
+        *src_len = 0;
+        *dest_len = 0;
+        return rc;
+    }
+
+    /*check if setupSession called*/
+    if (NULL == sess->internal || QZ_NONE == sess->hw_session_stat) {
+        rc = qzSetupSession(sess, NULL);
+        if (unlikely(QZ_SETUP_SESSION_FAIL(rc))) {
+            *src_len = 0;
+            *dest_len = 0;
+            return rc;
+        }
+    }
+
+    qz_sess = (QzSess_T *)(sess->internal);
+
+    QzDataFormat_T data_fmt = qz_sess->sess_params.data_fmt;
+    if (unlikely(data_fmt != QZ_DEFLATE_4B &&
+                 data_fmt != QZ_DEFLATE_RAW &&
+                 data_fmt != QZ_DEFLATE_GZIP &&
+                 data_fmt != QZ_DEFLATE_GZIP_EXT &&
+                 data_fmt != QZ_DEFLATE_ZLIB &&
+                 data_fmt != QZ_DEFLATE_BGZF)) {
+        QZ_ERROR("Unknown data formt: %d\n", data_fmt);
+        *src_len = 0;
+        *dest_len = 0;
+        return QZ_PARAMS;
+    }
+    QZ_DEBUG("qzCompressCrc data_fmt: %d, input crc32 is 0x%lX\n",
+             data_fmt, crc ? *crc : 0);
+
+    if (QZ_DEFLATE_ZLIB == data_fmt) {
+        return compressZlib(sess, src, src_len, dest, dest_len, last,
+                            crc, crc_type);
+    }
+    if (QZ_DEFLATE_BGZF == data_fmt) {
+        return compressBgzf(sess, src, src_len, dest, dest_len, last,
+                            crc, crc_type);
+    }
+    if (IS_MEMBER_INDEXED(qz_sess)) {
+        return compressIndexed(sess, src, src_len, dest, dest_len, last,
+                               crc, crc_type);
+    }
+    return compressChunks(sess, src, src_len, dest, dest_len, last,
+                          crc, crc_type);
+}
+
+int qzCompressCrc(QzSession_T *sess, const unsigned char *src,
+                  unsigned int *src_len, unsigned char *dest,
+                  unsigned int *dest_len, unsigned int last, unsigned long *crc)
+{
+    return compressWithChecksum(sess, src, src_len, dest, dest_len, last,
+                                crc, QZ_CRC32);
+}
+
+int qzCompressAdler(QzSession_T *sess, const unsigned char *src,
+                    unsigned int *src_len, unsigned char *dest,
+                    unsigned int *dest_len, unsigned int last,
+                    unsigned long *adler)
+{
+    return compressWithChecksum(sess, src, src_len, dest, dest_len, last,
+                                adler, QZ_ADLER);
+}
+
 /*To handle compression expansion*/
 static void swapDataBuffer(unsigned long i, int j)
 {
@@ -1703,14 +2145,44 @@ static void swapDataBuffer(unsigned long i, int j)
     g_process.qz_inst[i].dest_buffers[j]->pBuffers->pData = p_tmp_data;
 }
 
+/*
+ * Footer of the std gzip member at src_ptr. Boundaries are located a
+ * batch at a time, so consecutive members are not rescanned.
+ */
+static StdGzF_T *nextStdGzipFooter(QzSess_T *qz_sess, unsigned char *src_ptr,
+                                   long src_avail_len)
+{
+    int idx = qz_sess->gz_footer_idx;
+    unsigned char *member;
+
+    if (idx < qz_sess->gz_footer_cnt) {
+        member = (0 == idx) ? qz_sess->gz_first :
+                 qz_sess->gz_footer[idx - 1] + stdGzipFooterSz();
+        if (member == src_ptr) {
+            qz_sess->gz_footer_idx++;
+            return (StdGzF_T *)qz_sess->gz_footer[idx];
+        }
+    }
+
+    qz_sess->gz_footer_cnt = findStdGzipMembers(src_ptr, src_avail_len,
+                                                qz_sess->gz_footer,
+                                                QZ_GZIP_MEMBER_BATCH,
+                                                GZIP_SCAN_LEVEL(qz_sess));
+    qz_sess->gz_first = src_ptr;
+    qz_sess->gz_footer_idx = 1;
+    return (StdGzF_T *)qz_sess->gz_footer[0];
+}
+
 static int checkHeader(QzSess_T *qz_sess, unsigned char *src,
                        long src_avail_len, long dest_avail_len,
                        QzGzH_T *hdr)
 {
     unsigned char *src_ptr = src;
     long src_send_sz, dest_recv_sz;
+    long blk_sz;
     StdGzF_T *qzFooter = NULL;
     int isEndWithFooter = 0;
+    uint32_t dict_id;
     QzDataFormat_T data_fmt = qz_sess->sess_params.data_fmt;
 
     if ((src_avail_len <= 0) || (dest_avail_len <= 0)) {
@@ -1729,15 +2201,43 @@ static int checkHeader(QzSess_T *qz_sess, unsigned char *src,
     }
 
     if (QZ_DEFLATE_GZIP == data_fmt) {
-        qzFooter = (StdGzF_T *)(findStdGzipFooter(src_ptr, src_avail_len));
+        qzFooter = nextStdGzipFooter(qz_sess, src_ptr, src_avail_len);
         hdr->extra.qz_e.dest_sz = (unsigned char *)qzFooter - src_ptr -
                                   stdGzipHeaderSz();
         hdr->extra.qz_e.src_sz = qzFooter->i_size;
         if ((unsigned char *)qzFooter == src_ptr + src_avail_len - stdGzipFooterSz()) {
             isEndWithFooter = 1;
         }
+    } else if (QZ_DEFLATE_4B == data_fmt) {
+        /* the decompressed size is not framed, the engine gets hw_buff_sz
+         * and a block that overflows it is redone by decompress4BBlockSW */
+        hdr->extra.qz_e.dest_sz = qz4BHeaderExt(src_ptr);
+        hdr->extra.qz_e.src_sz = (dest_avail_len < qz_sess->sess_params.hw_buff_sz) ?
+                                 dest_avail_len : qz_sess->sess_params.hw_buff_sz;
+    } else if (QZ_DEFLATE_BGZF == data_fmt) {
+        blk_sz = bgzfBlockSz(src_ptr, src_avail_len);
+        if (blk_sz < (long)(sizeof(BgzfH_T) + stdGzipFooterSz())) {
+            return QZ_FAIL;
+        } else if (blk_sz > src_avail_len) {
+            QZ_DEBUG("checkHeader: incomplete source buffer\n");
+            return QZ_DATA_ERROR;
+        }
+        qzFooter = (StdGzF_T *)(src_ptr + blk_sz - stdGzipFooterSz());
+        /* the EOF block inflates to nothing, let the SW path skip it */
+        if (0 == qzFooter->i_size) {
+            return QZ_LOW_DEST_MEM;
+        }
+        hdr->extra.qz_e.dest_sz = blk_sz - sizeof(BgzfH_T) - stdGzipFooterSz();
+        hdr->extra.qz_e.src_sz = qzFooter->i_size;
+        isEndWithFooter = 1;
+    } else if (QZ_OK == qzGzipDictHeaderExt(src_ptr, src_avail_len, hdr,
+                                            &dict_id)) {
+        /* QAT has no preset dictionary, the SW path inflates it */
+        return QZ_LOW_DEST_MEM;
     } else if (QZ_OK != qzGzipHeaderExt(src_ptr, hdr)) {
-        return QZ_FAIL;
+        /* a member index inflates to nothing, let the SW path skip it */
+        return isMemberIndex(src_ptr, src_avail_len) ? QZ_LOW_DEST_MEM :
+               QZ_FAIL;
     }
 
     src_send_sz = (long)(hdr->extra.qz_e.dest_sz);
@@ -1745,7 +2245,8 @@ static int checkHeader(QzSess_T *qz_sess, unsigned char *src,
     if ((src_send_sz > DEST_SZ(qz_sess->sess_params.hw_buff_sz)) ||
         (dest_recv_sz > qz_sess->sess_params.hw_buff_sz)) {
         if (1 == qz_sess->sess_params.sw_backup) {
-            if (QZ_DEFLATE_GZIP == data_fmt &&
+            if ((QZ_DEFLATE_GZIP == data_fmt ||
+                 QZ_DEFLATE_BGZF == data_fmt) &&
                 1 == isEndWithFooter) {
                 return QZ_LOW_DEST_MEM;
             }
@@ -1786,6 +2287,7 @@ static void *doDecompressIn(void *in)
     unsigned char *dest_ptr;
     int src_pinned = 0;
     int dest_pinned = 0;
+    unsigned int submitted = 0;
     QzGzH_T hdr = {{0}, 0};
     QzSession_T *sess = (QzSession_T *)in;
     QzSess_T *qz_sess = (QzSess_T *)sess->internal;
@@ -1801,6 +2303,10 @@ static void *doDecompressIn(void *in)
     dest_ptr = qz_sess->next_dest;
     src_pinned = qzMemFindAddr(src_ptr);
     dest_pinned = qzMemFindAddr(dest_ptr);
+    /* where a 4B block's output lands is only known once the previous completes */
+    if (QZ_DEFLATE_4B == data_fmt) {
+        dest_pinned = 0;
+    }
     remaining = *qz_sess->src_sz - qz_sess->qz_in_len;
     src_avail_len = remaining;
     dest_avail_len = (long)(*qz_sess->dest_sz - qz_sess->qz_out_len);
@@ -1826,6 +2332,12 @@ static void *doDecompressIn(void *in)
         case QZ_LOW_MEM:
         case QZ_LOW_DEST_MEM:
         case QZ_FORCE_SW:
+            if (QZ_DEFLATE_4B == data_fmt && submitted > 0) {
+                /* dest_ptr is only an estimate behind 4B blocks in flight */
+                sess->thd_sess_stat = QZ_OK;
+                remaining = 0;
+                break;
+            }
             tmp_src_avail_len = src_avail_len;
             tmp_dest_avail_len = dest_avail_len;
             rc = qzSWDecompress(sess,
@@ -1839,13 +2351,13 @@ static void *doDecompressIn(void *in)
                 break;
             }
 
-            sess->total_in  += qz_sess->inflate_strm->total_in;
-            sess->total_out += qz_sess->inflate_strm->total_out;
-            src_ptr         += qz_sess->inflate_strm->total_in;
-            dest_ptr        += qz_sess->inflate_strm->total_out;
-            src_avail_len   -= qz_sess->inflate_strm->total_in;
-            dest_avail_len  -= qz_sess->inflate_strm->total_out;
-            remaining       -= qz_sess->inflate_strm->total_in;
+            sess->total_in  += tmp_src_avail_len;
+            sess->total_out += tmp_dest_avail_len;
+            src_ptr         += tmp_src_avail_len;
+            dest_ptr        += tmp_dest_avail_len;
+            src_avail_len   -= tmp_src_avail_len;
+            dest_avail_len  -= tmp_dest_avail_len;
+            remaining       -= tmp_src_avail_len;
             break;
 
         case QZ_OK:
@@ -1886,10 +2398,13 @@ static void *doDecompressIn(void *in)
             qz_sess->seq++;
             QZ_DEBUG("sending seq number %d %d %ld\n", i, j, qz_sess->seq);
 
-            qzFooter = (StdGzF_T *)(src_ptr + src_send_sz);
-            g_process.qz_inst[i].stream[j].gzip_footer_checksum = qzFooter->crc32;
-            g_process.qz_inst[i].stream[j].gzip_footer_orgdatalen = qzFooter->i_size;
+            if (QZ_DEFLATE_4B != data_fmt) {
+                qzFooter = (StdGzF_T *)(src_ptr + src_send_sz);
+                g_process.qz_inst[i].stream[j].gzip_footer_checksum = qzFooter->crc32;
+                g_process.qz_inst[i].stream[j].gzip_footer_orgdatalen = qzFooter->i_size;
+            }
             qz_sess->submitted++;
+            submitted++;
             /*send to compression engine here*/
             g_process.qz_inst[i].stream[j].src2++;/*this buffer is in use*/
 
@@ -1949,13 +2464,13 @@ static void *doDecompressIn(void *in)
             }
 
             g_process.qz_inst[i].num_retries = 0;
-            src_avail_len -= (outputHeaderSz(data_fmt) + src_send_sz + stdGzipFooterSz());
+            src_avail_len -= (outputHeaderSz(data_fmt) + src_send_sz + outputFooterSz(data_fmt));
             dest_avail_len -= dest_receive_sz;
 
             dest_ptr += dest_receive_sz;
 
-            src_ptr += (src_send_sz + stdGzipFooterSz());
-            remaining -= (src_send_sz + stdGzipFooterSz());
+            src_ptr += (src_send_sz + outputFooterSz(data_fmt));
+            remaining -= (src_send_sz + outputFooterSz(data_fmt));
             break;
 
         default:
@@ -1998,6 +2513,31 @@ err_exit:
     return ((void *)NULL);
 }
 
+/*
+ * A 4B block does not frame its decompressed size, so the engine gets at
+ * most hw_buff_sz of output for it. A block that inflates past that is
+ * inflated by qzSWDecompress straight into its place in dest.
+ */
+static int decompress4BBlockSW(QzSession_T *sess, unsigned int blk_sz,
+                               unsigned int *produced)
+{
+    QzSess_T *qz_sess = (QzSess_T *)sess->internal;
+    unsigned int in_len = outputHeaderSz(QZ_DEFLATE_4B) + blk_sz;
+    unsigned int out_len = *qz_sess->dest_sz - qz_sess->qz_out_len;
+    int rc;
+
+    rc = qzSWDecompress(sess, qz_sess->src + qz_sess->qz_in_len, &in_len,
+                        qz_sess->next_dest, &out_len);
+    if (QZ_OK == rc && InflateNull != qz_sess->inflate_stat) {
+        /* dest is full before the block ends */
+        (void)inflateEnd(qz_sess->inflate_strm);
+        qz_sess->inflate_stat = InflateNull;
+        rc = QZ_BUF_ERROR;
+    }
+    *produced = out_len;
+    return rc;
+}
+
 /* The internal function to g_process the decomrpession response
  * from the QAT hardware
  */
@@ -2007,7 +2547,7 @@ err_exit:
  */
 static void *__attribute__((cold)) doDecompressOut(void *in)
 {
-    int i = 0, j = 0, si = 0, good;
+    int i = 0, j = 0, si = 0, good, rc, overflow;
     CpaDcRqResults *resl;
     CpaStatus sts;
     unsigned int sleep_cnt = 0;
@@ -2061,7 +2601,14 @@ static void *__attribute__((cold)) doDecompressOut(void *in)
                          resl->consumed, resl->produced, g_process.qz_inst[i].stream[j].seq,
                          g_process.qz_inst[i].src_buffers[j]->pBuffers->dataLenInBytes);
 
-                if (0 == g_process.qz_inst[i].stream[j].dest_pinned) {
+                src_send_sz = g_process.qz_inst[i].src_buffers[j]->pBuffers->dataLenInBytes;
+                overflow = (QZ_DEFLATE_4B == data_fmt &&
+                            (CPA_DC_OVERFLOW == resl->status ||
+                             resl->consumed < src_send_sz));
+
+                if (unlikely(overflow)) {
+                    QZ_DEBUG("4B block overflows the engine output, redo in sw\n");
+                } else if (0 == g_process.qz_inst[i].stream[j].dest_pinned) {
                     QZ_DEBUG("memory copy in doDecompressOut\n");
                     QZ_MEMCPY(qz_sess->next_dest,
                               g_process.qz_inst[i].dest_buffers[j]->pBuffers->pData,
@@ -2079,9 +2626,20 @@ static void *__attribute__((cold)) doDecompressOut(void *in)
                     g_process.qz_inst[i].stream[j].src_pinned = 0;
                 }
 
-                if (unlikely(resl->checksum !=
-                             g_process.qz_inst[i].stream[j].gzip_footer_checksum ||
-                             resl->produced != g_process.qz_inst[i].stream[j].gzip_footer_orgdatalen)) {
+                if (unlikely(overflow)) {
+                    rc = decompress4BBlockSW(sess, src_send_sz, &resl->produced);
+                    if (unlikely(QZ_OK != rc)) {
+                        sess->thd_sess_stat = rc;
+                        g_process.qz_inst[i].stream[j].sink2++;
+                        qz_sess->processed++;
+                        goto err_check_footer;
+                    }
+                }
+
+                if (unlikely(QZ_DEFLATE_4B != data_fmt &&
+                             (resl->checksum !=
+                              g_process.qz_inst[i].stream[j].gzip_footer_checksum ||
+                              resl->produced != g_process.qz_inst[i].stream[j].gzip_footer_orgdatalen))) {
                     QZ_ERROR("Error in check footer, inst %ld, stream %ld\n", i, j);
                     QZ_DEBUG("resp checksum: %x data checksum %x\n",
                              resl->checksum,
@@ -2095,10 +2653,9 @@ static void *__attribute__((cold)) doDecompressOut(void *in)
                     goto err_check_footer;
                 }
 
-                src_send_sz = g_process.qz_inst[i].src_buffers[j]->pBuffers->dataLenInBytes;
                 qz_sess->next_dest += resl->produced;
                 qz_sess->qz_in_len += (outputHeaderSz(data_fmt) + src_send_sz +
-                                       stdGzipFooterSz());
+                                       outputFooterSz(data_fmt));
                 qz_sess->qz_out_len += resl->produced;
 
                 QZ_DEBUG("qz_sess->next_dest = %p\n", qz_sess->next_dest);
@@ -2222,9 +2779,12 @@ int qzDecompress(QzSession_T *sess, const unsigned char *src,
     qz_sess = (QzSess_T *)(sess->internal);
 
     QzDataFormat_T data_fmt = qz_sess->sess_params.data_fmt;
-    if (unlikely(data_fmt != QZ_DEFLATE_RAW &&
+    if (unlikely(data_fmt != QZ_DEFLATE_4B &&
+                 data_fmt != QZ_DEFLATE_RAW &&
                  data_fmt != QZ_DEFLATE_GZIP &&
-                 data_fmt != QZ_DEFLATE_GZIP_EXT)) {
+                 data_fmt != QZ_DEFLATE_GZIP_EXT &&
+                 data_fmt != QZ_DEFLATE_ZLIB &&
+                 data_fmt != QZ_DEFLATE_BGZF)) {
         QZ_ERROR("Unknown data formt: %d\n", data_fmt);
         *src_len = 0;
         *dest_len = 0;
@@ -2232,12 +2792,15 @@ int qzDecompress(QzSession_T *sess, const unsigned char *src,
     }
 
     QZ_DEBUG("qzDecompress data_fmt: %d\n", data_fmt);
-    if (hdr->extra.qz_e.src_sz < qz_sess->sess_params.input_sz_thrshold ||
+    if ((QZ_DEFLATE_4B == data_fmt || QZ_DEFLATE_BGZF == data_fmt ?
+         *src_len : hdr->extra.qz_e.src_sz) < qz_sess->sess_params.input_sz_thrshold ||
         g_process.qz_init_status == QZ_NO_HW                            ||
         sess->hw_session_stat == QZ_NO_HW                               ||
         !(isQATProcessable(src, src_len, qz_sess))                      ||
         qz_sess->inflate_stat == InflateOK                              ||
-        QZ_DEFLATE_RAW == data_fmt) {
+        NULL != qz_sess->dict                                           ||
+        QZ_DEFLATE_RAW == data_fmt                                      ||
+        QZ_DEFLATE_ZLIB == data_fmt) {
         QZ_DEBUG("decompression src_len=%u, hdr->extra.qz_e.src_sz = %u, "
                  "g_process.qz_init_status = %d, sess->hw_session_stat = %d, "
                  "isQATProcessable = %d, switch to software.\n",
@@ -2298,6 +2861,8 @@ int qzDecompress(QzSession_T *sess, const unsigned char *src,
     qz_sess->qz_out_len = 0;
     qz_sess->force_sw = 0;
     qz_sess->single_thread = 0;
+    qz_sess->gz_footer_cnt = 0;
+    qz_sess->gz_footer_idx = 0;
 
     qz_sess->src = (unsigned char *)src;
     qz_sess->src_sz = src_len;
@@ -2337,6 +2902,218 @@ sw_decompression:
     return qzSWDecompressMultiGzip(sess, src, src_len, dest, dest_len);
 }
 
+int qzDecompressRange(QzSession_T *sess, const unsigned char *src,
+                      unsigned long src_len, unsigned long offset,
+                      unsigned char *dest, unsigned int *dest_len)
+{
+    int rc;
+    unsigned long lo, hi, mid, k;
+    unsigned long comp_len, orig_len, end;
+    unsigned long comp_done = 0, orig_done = 0;
+    unsigned int in_len, out_len;
+    unsigned char *out = NULL;
+    QzMemberIndex_T idx;
+    QzMemberIdx_T first, ent;
+    QzSess_T *qz_sess;
+
+    if (unlikely(NULL == sess || NULL == src || NULL == dest ||
+                 NULL == dest_len)) {
+        if (NULL != dest_len) {
+            *dest_len = 0;
+        }
+        return QZ_PARAMS;
+    }
+
+    /*check if init called*/
+    rc = qzInit(sess, getSwBackup(sess));
+    if (QZ_INIT_FAIL(rc)) {
+        *dest_len = 0;
+        return rc;
+    }
+
+    /*check if setupSession called*/
+    if (NULL == sess->internal || QZ_NONE == sess->hw_session_stat) {
+        rc = qzSetupSession(sess, NULL);
+        if (unlikely(QZ_SETUP_SESSION_FAIL(rc))) {
+            *dest_len = 0;
+            return rc;
+        }
+    }
+
+    qz_sess = (QzSess_T *)(sess->internal);
+    if (QZ_DEFLATE_GZIP_EXT != qz_sess->sess_params.data_fmt) {
+        *dest_len = 0;
+        return QZ_PARAMS;
+    }
+    if (QZ_OK != qzMemberIndexExt(src, src_len, &idx)) {
+        QZ_ERROR("qzDecompressRange: no member index found\n");
+        *dest_len = 0;
+        return QZ_DATA_ERROR;
+    }
+    if (0 == idx.cnt || offset >= idx.orig_total) {
+        *dest_len = 0;
+        return QZ_OK;
+    }
+    end = offset + *dest_len;
+    if (end > idx.orig_total) {
+        end = idx.orig_total;
+    }
+
+    /* the last member starting at or before offset */
+    lo = 0;
+    hi = idx.cnt - 1;
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        qzMemberIndexEntry(&idx, mid, &ent);
+        if (ent.orig_off <= offset) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    qzMemberIndexEntry(&idx, lo, &first);
+
+    /* then every member up to the one holding end - 1 */
+    ent.comp_off = idx.comp_total;
+    ent.orig_off = idx.orig_total;
+    for (k = lo + 1; k < idx.cnt; k++) {
+        qzMemberIndexEntry(&idx, k, &ent);
+        if (ent.orig_off >= end) {
+            break;
+        }
+    }
+    if (k == idx.cnt) {
+        ent.comp_off = idx.comp_total;
+        ent.orig_off = idx.orig_total;
+    }
+    comp_len = ent.comp_off - first.comp_off;
+    orig_len = ent.orig_off - first.orig_off;
+
+    if (first.orig_off == offset && orig_len == end - offset) {
+        out = dest;
+    } else {
+        out = malloc(orig_len);
+        if (NULL == out) {
+            *dest_len = 0;
+            return QZ_FAIL;
+        }
+    }
+
+    while (comp_done < comp_len) {
+        in_len = comp_len - comp_done;
+        out_len = orig_len - orig_done;
+        rc = qzDecompress(sess, src + first.comp_off + comp_done, &in_len,
+                          out + orig_done, &out_len);
+        if (QZ_OK != rc) {
+            goto done;
+        }
+        if (0 == in_len) {
+            rc = QZ_FAIL;
+            goto done;
+        }
+        comp_done += in_len;
+        orig_done += out_len;
+    }
+
+    if (orig_done != orig_len) {
+        QZ_ERROR("qzDecompressRange: members hold %lu bytes, index says %lu\n",
+                 orig_done, orig_len);
+        rc = QZ_DATA_ERROR;
+        goto done;
+    }
+    if (out != dest) {
+        QZ_MEMCPY(dest, out + offset - first.orig_off, *dest_len,
+                  end - offset);
+    }
+    rc = QZ_OK;
+
+done:
+    if (out != dest) {
+        free(out);
+    }
+    *dest_len = (QZ_OK == rc) ? (unsigned int)(end - offset) : 0;
+    return rc;
+}
+
+int qzGetDecompressedSizeExt(QzSession_T *sess, const unsigned char *src,
+                             unsigned long src_len, unsigned long *dest_len,
+                             unsigned long *member_cnt)
+{
+    QzDataFormat_T data_fmt;
+    unsigned long cnt = 0;
+    int rc;
+
+    if (unlikely(NULL == src || NULL == dest_len)) {
+        return QZ_PARAMS;
+    }
+
+    *dest_len = 0;
+    if (NULL != sess && NULL != sess->internal) {
+        data_fmt = ((QzSess_T *)sess->internal)->sess_params.data_fmt;
+        if (QZ_DEFLATE_RAW == data_fmt || QZ_DEFLATE_ZLIB == data_fmt ||
+            QZ_DEFLATE_4B == data_fmt) {
+            rc = QZ_FAIL;
+            goto done;
+        }
+    }
+
+    rc = qzGzipMembersSz(src, src_len, dest_len, &cnt,
+                         (NULL != sess && NULL != sess->internal) ?
+                         GZIP_SCAN_LEVEL((QzSess_T *)sess->internal) :
+                         GzipScanCheap);
+    if (QZ_OK != rc) {
+        *dest_len = 0;
+        cnt = 0;
+    }
+
+done:
+    if (NULL != member_cnt) {
+        *member_cnt = cnt;
+    }
+    return rc;
+}
+
+int qzGetDecompressedSize(QzSession_T *sess, const unsigned char *src,
+                          unsigned long src_len, unsigned long *dest_len)
+{
+    return qzGetDecompressedSizeExt(sess, src, src_len, dest_len, NULL);
+}
+
+/* The first block is implied at offset 0, htslib leaves it out */
+int qzGetGziIndex(QzSession_T *sess, unsigned char *gzi,
+                  unsigned long *gzi_len)
+{
+    QzSess_T *qz_sess;
+    uint64_t cnt;
+    unsigned long sz;
+
+    if (unlikely(NULL == sess || NULL == sess->internal ||
+                 NULL == gzi_len)) {
+        return QZ_PARAMS;
+    }
+
+    qz_sess = (QzSess_T *)sess->internal;
+    if (QZ_DEFLATE_BGZF != qz_sess->sess_params.data_fmt ||
+        !IS_MEMBER_INDEXED(qz_sess)) {
+        return QZ_PARAMS;
+    }
+
+    cnt = qz_sess->mbr_idx_cnt ? qz_sess->mbr_idx_cnt - 1 : 0;
+    sz = sizeof(cnt) + cnt * sizeof(QzMemberIdx_T);
+    if (NULL == gzi || *gzi_len < sz) {
+        *gzi_len = sz;
+        return (NULL == gzi) ? QZ_OK : QZ_BUF_ERROR;
+    }
+
+    QZ_MEMCPY(gzi, &cnt, sizeof(cnt), sizeof(cnt));
+    if (cnt) {
+        QZ_MEMCPY(gzi + sizeof(cnt), qz_sess->mbr_idx + 1,
+                  cnt * sizeof(QzMemberIdx_T), cnt * sizeof(QzMemberIdx_T));
+    }
+    *gzi_len = sz;
+    return QZ_OK;
+}
+
 int qzTeardownSession(QzSession_T *sess)
 {
     if (unlikely(sess == NULL)) {
@@ -2357,6 +3134,9 @@ int qzTeardownSession(QzSession_T *sess)
             qz_sess->deflate_strm = NULL;
         }
 
+        free(qz_sess->mbr_idx);
+        free(qz_sess->dict);
+        qzRunCacheFree(qz_sess);
         free(sess->internal);
         sess->internal = NULL;
     }
@@ -2385,6 +3165,18 @@ void removeSession(int i)
             QZ_ERROR("ERROR in Remove Instance %d session\n", i);
         }
     }
+
+    if ((NULL != g_process.dc_inst_handle[i]) &&
+        (NULL != g_process.qz_inst[i].cpaSessStatic)) {
+        status = cpaDcRemoveSession(g_process.dc_inst_handle[i],
+                                    g_process.qz_inst[i].cpaSessStatic);
+        if (CPA_STATUS_SUCCESS == status) {
+            qzFree(g_process.qz_inst[i].cpaSessStatic);
+            g_process.qz_inst[i].cpaSessStatic = NULL;
+        } else {
+            QZ_ERROR("ERROR in Remove Instance %d static session\n", i);
+        }
+    }
 }
 
 int qzClose(QzSession_T *sess)
@@ -2416,10 +3208,26 @@ int qzClose(QzSession_T *sess)
 
 int qzGetStatus(QzSession_T *sess, QzStatus_T *status)
 {
+    QzSess_T *qz_sess;
+
     if (sess == NULL || status == NULL) {
         return QZ_PARAMS;
     }
 
+    status->chunks_sampled = 0;
+    status->chunks_stored = 0;
+    status->chunks_static_hdr = 0;
+    status->chunks_dynamic_hdr = 0;
+    status->chunks_uniform = 0;
+    if (NULL != sess->internal) {
+        qz_sess = (QzSess_T *)sess->internal;
+        status->chunks_sampled = qz_sess->chunks_sampled;
+        status->chunks_stored = qz_sess->chunks_stored;
+        status->chunks_static_hdr = qz_sess->chunks_static_hdr;
+        status->chunks_dynamic_hdr = qz_sess->chunks_dynamic_hdr;
+        status->chunks_uniform = qz_sess->chunks_uniform;
+    }
+
     return QZ_OK;
 }
 
@@ -2465,7 +3273,7 @@ unsigned int qzMaxCompressedLength(unsigned int src_sz, QzSession_T *sess)
         chunk_sz = QZ_HW_BUFF_SZ;
     } else {
         qz_sess = (QzSess_T *)sess->internal;
-        chunk_sz = qz_sess->sess_params.hw_buff_sz;
+        chunk_sz = CHUNK_SZ(qz_sess);
     }
 
     chunk_cnt = src_sz / chunk_sz;
@@ -2482,6 +3290,19 @@ unsigned int qzMaxCompressedLength(unsigned int src_sz, QzSession_T *sess)
         dest_sz = QZ_COMPRESSED_SZ_OF_EMPTY_FILE;
     }
 
+    if (NULL != qz_sess &&
+        QZ_DEFLATE_BGZF == qz_sess->sess_params.data_fmt) {
+        dest_sz += bgzfEofSz();
+    } else if (NULL != qz_sess && IS_MEMBER_INDEXED(qz_sess)) {
+        dest_sz += qzMemberIndexSz(chunk_cnt + 2);
+    }
+
+    /* dictionary members carry an extra subfield each */
+    if (NULL != qz_sess && NULL != qz_sess->dict &&
+        QZ_DEFLATE_GZIP_EXT == qz_sess->sess_params.data_fmt) {
+        dest_sz += (chunk_cnt + 1) * sizeof(QzDictField_T);
+    }
+
     if (dest_sz <= src_sz) {
         dest_sz = 0;
     }
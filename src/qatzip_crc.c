@@ -0,0 +1,531 @@
+/***************************************************************************
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2007-2021 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cpa.h"
+#include "cpa_dc.h"
+#include "qatzip.h"
+#include "qatzip_internal.h"
+#include "qz_utils.h"
+
+/* CRC-32 (RFC 1952) polynomial, bit reflected */
+#define CRC32_POLY          0xedb88320UL
+/* Shortest buffer worth the folding setup and final reduction */
+#define CRC32_FOLD_MIN_LEN  64
+#define CRC32_FOLD512_MIN_LEN 256
+
+/* Adler-32 (RFC 1950) modulus and the longest run before s2 can overflow */
+#define ADLER32_BASE        65521UL
+#define ADLER32_NMAX        5552
+#define ADLER32_SIMD_BLK_LEN 32
+#define ADLER32_SIMD_MIN_LEN 64
+
+/* Copy granule for the generic and Adler-32 paths, stays in L1 */
+#define COPY_CSUM_BLK_LEN   4096
+
+/* Fold kernels also store every block they load to dst unless it is NULL */
+typedef uint32_t (*Crc32Fold_T)(uint32_t crc, unsigned char *dst,
+                                const unsigned char *buf, size_t len);
+typedef uint32_t (*Adler32_T)(uint32_t adler, const unsigned char *buf,
+                              size_t len);
+
+/* x^(2^n) mod P(x), n = 0..31, used to build x^(8*len) for combining */
+static const uint32_t g_x2n_table[32] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000,
+    0x00008000, 0xedb88320, 0xb1e6b092, 0xa06a2517,
+    0xed627dae, 0x88d14467, 0xd7bbfe6a, 0xec447f11,
+    0x8e7ea170, 0x6427800e, 0x4d47bae0, 0x09fe548f,
+    0x83852d0f, 0x30362f1a, 0x7b5a9cc3, 0x31fec169,
+    0x9fec022a, 0x6c8dedc4, 0x15d6874d, 0x5fde7a4e,
+    0xbad90e37, 0x2e4e5eef, 0x4eaba214, 0xa8a472c0,
+    0x429a969e, 0x148d302a, 0xc40ba6d0, 0xc4e22c3c
+};
+
+/* Last combine operator, chunks of one session mostly share a length */
+static __thread size_t g_combine_len = 0;
+static __thread uint32_t g_combine_op = 0x80000000;
+
+/* Picked once per process from the CPU features, see crc32SelectFold */
+static pthread_once_t g_crc32_once = PTHREAD_ONCE_INIT;
+static Crc32Fold_T g_crc32_fold = NULL;
+static pthread_once_t g_adler32_once = PTHREAD_ONCE_INIT;
+static Adler32_T g_adler32 = NULL;
+
+/* Multiply a and b modulo P(x), both bit reflected */
+static uint32_t multModP(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if (0 == (a & (m - 1))) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+/* x^(n * 2^k) mod P(x) */
+static uint32_t x2nModP(size_t n, unsigned int k)
+{
+    uint32_t p = (uint32_t)1 << 31;
+
+    while (n) {
+        if (n & 1) {
+            p = multModP(g_x2n_table[k & 31], p);
+        }
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+static uint32_t crc32FoldGeneric(uint32_t crc, unsigned char *dst,
+                                 const unsigned char *buf, size_t len)
+{
+    size_t blk;
+
+    if (NULL == dst) {
+        return (uint32_t)crc32(crc, buf, len);
+    }
+
+    /* the checksum reads the block back while it is still in L1 */
+    while (len > 0) {
+        blk = len > COPY_CSUM_BLK_LEN ? COPY_CSUM_BLK_LEN : len;
+        memcpy(dst, buf, blk);
+        crc = (uint32_t)crc32(crc, dst, blk);
+        dst += blk;
+        buf += blk;
+        len -= blk;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+/*
+ * Folding constants for the reflected domain, x^(D+32) and x^(D-32)
+ * mod P(x) for a fold distance of D bits, see "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" by Intel.
+ */
+static const uint64_t g_k_fold2048[2] __attribute__((aligned(16))) = {
+    0x011542778a, 0x01322d1430
+};
+static const uint64_t g_k_fold512[2] __attribute__((aligned(16))) = {
+    0x0154442bd4, 0x01c6e41596
+};
+static const uint64_t g_k_fold128[2] __attribute__((aligned(16))) = {
+    0x01751997d0, 0x00ccaa009e
+};
+static const uint64_t g_k_fold64[2] __attribute__((aligned(16))) = {
+    0x0163cd6124, 0x0000000000
+};
+static const uint64_t g_k_barrett[2] __attribute__((aligned(16))) = {
+    0x01db710641, 0x01f7011641
+};
+
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i fold128(__m128i x, __m128i k, __m128i next)
+{
+    __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), next);
+}
+
+/* Fold the remaining 16 byte blocks into x, then reduce x to 32 bits */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32FoldTail(__m128i x, unsigned char *dst,
+                              const unsigned char *buf, size_t len)
+{
+    __m128i k = _mm_load_si128((const __m128i *)g_k_fold128);
+    __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i t;
+
+    while (len >= 16) {
+        t = _mm_loadu_si128((const __m128i *)buf);
+        if (NULL != dst) {
+            _mm_storeu_si128((__m128i *)dst, t);
+            dst += 16;
+        }
+        x = fold128(x, k, t);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 bits to 64 bits */
+    t = _mm_clmulepi64_si128(x, k, 0x10);
+    x = _mm_xor_si128(_mm_srli_si128(x, 8), t);
+
+    k = _mm_loadl_epi64((const __m128i *)g_k_fold64);
+    t = _mm_srli_si128(x, 4);
+    x = _mm_and_si128(x, mask);
+    x = _mm_clmulepi64_si128(x, k, 0x00);
+    x = _mm_xor_si128(x, t);
+
+    /* Barrett reduction to 32 bits */
+    k = _mm_load_si128((const __m128i *)g_k_barrett);
+    t = _mm_and_si128(x, mask);
+    t = _mm_clmulepi64_si128(t, k, 0x10);
+    t = _mm_and_si128(t, mask);
+    t = _mm_clmulepi64_si128(t, k, 0x00);
+    x = _mm_xor_si128(x, t);
+
+    return (uint32_t)_mm_extract_epi32(x, 1);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static inline void load64(const unsigned char *buf, unsigned char *dst,
+                          __m128i *y0, __m128i *y1, __m128i *y2, __m128i *y3)
+{
+    *y0 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    *y1 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    *y2 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    *y3 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    if (NULL != dst) {
+        _mm_storeu_si128((__m128i *)(dst + 0x00), *y0);
+        _mm_storeu_si128((__m128i *)(dst + 0x10), *y1);
+        _mm_storeu_si128((__m128i *)(dst + 0x20), *y2);
+        _mm_storeu_si128((__m128i *)(dst + 0x30), *y3);
+    }
+}
+
+/* len must be at least CRC32_FOLD_MIN_LEN and a multiple of 16 */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32FoldPclmul(uint32_t crc, unsigned char *dst,
+                                const unsigned char *buf, size_t len)
+{
+    __m128i x0, x1, x2, x3, y0, y1, y2, y3, k;
+
+    load64(buf, dst, &x0, &x1, &x2, &x3);
+    x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128((int)~crc));
+    buf += 64;
+    dst = dst ? dst + 64 : NULL;
+    len -= 64;
+
+    k = _mm_load_si128((const __m128i *)g_k_fold512);
+    while (len >= 64) {
+        load64(buf, dst, &y0, &y1, &y2, &y3);
+        x0 = fold128(x0, k, y0);
+        x1 = fold128(x1, k, y1);
+        x2 = fold128(x2, k, y2);
+        x3 = fold128(x3, k, y3);
+        buf += 64;
+        dst = dst ? dst + 64 : NULL;
+        len -= 64;
+    }
+
+    k = _mm_load_si128((const __m128i *)g_k_fold128);
+    x1 = fold128(x0, k, x1);
+    x2 = fold128(x1, k, x2);
+    x3 = fold128(x2, k, x3);
+
+    return ~crc32FoldTail(x3, dst, buf, len);
+}
+
+__attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")))
+static inline __m512i fold512(__m512i z, __m512i k, __m512i next)
+{
+    __m512i lo = _mm512_clmulepi64_epi128(z, k, 0x00);
+    __m512i hi = _mm512_clmulepi64_epi128(z, k, 0x11);
+
+    return _mm512_ternarylogic_epi64(lo, hi, next, 0x96);
+}
+
+__attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")))
+static inline void load256(const unsigned char *buf, unsigned char *dst,
+                           __m512i *w0, __m512i *w1, __m512i *w2, __m512i *w3)
+{
+    *w0 = _mm512_loadu_si512((const void *)(buf + 0x00));
+    *w1 = _mm512_loadu_si512((const void *)(buf + 0x40));
+    *w2 = _mm512_loadu_si512((const void *)(buf + 0x80));
+    *w3 = _mm512_loadu_si512((const void *)(buf + 0xc0));
+    if (NULL != dst) {
+        _mm512_storeu_si512((void *)(dst + 0x00), *w0);
+        _mm512_storeu_si512((void *)(dst + 0x40), *w1);
+        _mm512_storeu_si512((void *)(dst + 0x80), *w2);
+        _mm512_storeu_si512((void *)(dst + 0xc0), *w3);
+    }
+}
+
+/* len must be at least CRC32_FOLD512_MIN_LEN and a multiple of 16 */
+__attribute__((target("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")))
+static uint32_t crc32FoldVpclmul(uint32_t crc, unsigned char *dst,
+                                 const unsigned char *buf, size_t len)
+{
+    __m512i z0, z1, z2, z3, w0, w1, w2, w3, k;
+    __m128i x, k128;
+
+    load256(buf, dst, &z0, &z1, &z2, &z3);
+    z0 = _mm512_xor_si512(z0,
+                          _mm512_castsi128_si512(_mm_cvtsi32_si128((int)~crc)));
+    buf += 256;
+    dst = dst ? dst + 256 : NULL;
+    len -= 256;
+
+    k = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)g_k_fold2048));
+    while (len >= 256) {
+        load256(buf, dst, &w0, &w1, &w2, &w3);
+        z0 = fold512(z0, k, w0);
+        z1 = fold512(z1, k, w1);
+        z2 = fold512(z2, k, w2);
+        z3 = fold512(z3, k, w3);
+        buf += 256;
+        dst = dst ? dst + 256 : NULL;
+        len -= 256;
+    }
+
+    k = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)g_k_fold512));
+    z1 = fold512(z0, k, z1);
+    z2 = fold512(z1, k, z2);
+    z3 = fold512(z2, k, z3);
+
+    k128 = _mm_load_si128((const __m128i *)g_k_fold128);
+    x = _mm512_extracti32x4_epi32(z3, 0);
+    x = fold128(x, k128, _mm512_extracti32x4_epi32(z3, 1));
+    x = fold128(x, k128, _mm512_extracti32x4_epi32(z3, 2));
+    x = fold128(x, k128, _mm512_extracti32x4_epi32(z3, 3));
+
+    return ~crc32FoldTail(x, dst, buf, len);
+}
+#endif
+
+static void crc32SelectFold(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("vpclmulqdq") &&
+        __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vl")) {
+        QZ_DEBUG("crc32: use VPCLMULQDQ folding\n");
+        g_crc32_fold = crc32FoldVpclmul;
+        return;
+    }
+    if (__builtin_cpu_supports("pclmul") &&
+        __builtin_cpu_supports("sse4.1")) {
+        QZ_DEBUG("crc32: use PCLMULQDQ folding\n");
+        g_crc32_fold = crc32FoldPclmul;
+        return;
+    }
+#endif
+    QZ_DEBUG("crc32: use generic implementation\n");
+    g_crc32_fold = crc32FoldGeneric;
+}
+
+static unsigned long crc32Run(unsigned long crc, unsigned char *dst,
+                              const unsigned char *buf, size_t len)
+{
+    size_t fold_len;
+    size_t min_len = CRC32_FOLD_MIN_LEN;
+    Crc32Fold_T fold;
+
+    pthread_once(&g_crc32_once, crc32SelectFold);
+    fold = g_crc32_fold;
+
+#if defined(__x86_64__)
+    if (crc32FoldVpclmul == fold) {
+        min_len = CRC32_FOLD512_MIN_LEN;
+        if (len < min_len) {
+            fold = crc32FoldPclmul;
+            min_len = CRC32_FOLD_MIN_LEN;
+        }
+    }
+#endif
+
+    if (len < min_len) {
+        fold = crc32FoldGeneric;
+    }
+    if (crc32FoldGeneric == fold) {
+        return crc32FoldGeneric((uint32_t)crc, dst, buf, len);
+    }
+
+    fold_len = len & ~(size_t)15;
+    crc = fold((uint32_t)crc, dst, buf, fold_len);
+    if (len != fold_len) {
+        crc = crc32FoldGeneric((uint32_t)crc, dst ? dst + fold_len : NULL,
+                               buf + fold_len, len - fold_len);
+    }
+    return crc;
+}
+
+unsigned long qzCrc32(unsigned long crc, const unsigned char *buf,
+                      size_t len)
+{
+    return crc32Run(crc, NULL, buf, len);
+}
+
+unsigned long qzCopyCrc32(unsigned char *dst, const unsigned char *src,
+                          size_t len, unsigned long crc)
+{
+    return crc32Run(crc, dst, src, len);
+}
+
+static uint32_t adler32Generic(uint32_t adler, const unsigned char *buf,
+                               size_t len)
+{
+    return (uint32_t)adler32(adler, buf, len);
+}
+
+#if defined(__x86_64__)
+/*
+ * 32 bytes per step: s1 gathers byte sums with psadbw, s2 gathers the
+ * position weighted sums (32..1) with pmaddubsw, and the s1 carried into
+ * s2 by every step is accumulated in ps and added as 32 * ps at the end.
+ * Blocks are sized so no 32-bit lane overflows before the modulo.
+ */
+__attribute__((target("ssse3")))
+static uint32_t adler32Ssse3(uint32_t adler, const unsigned char *buf,
+                             size_t len)
+{
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    size_t blocks = len / ADLER32_SIMD_BLK_LEN;
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                       24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                       8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * ADLER32_SIMD_BLK_LEN;
+    while (blocks) {
+        unsigned int n = ADLER32_NMAX / ADLER32_SIMD_BLK_LEN;
+        __m128i v_ps, v_s1, v_s2, b1, b2;
+
+        if (n > blocks) {
+            n = (unsigned int)blocks;
+        }
+        blocks -= n;
+
+        v_ps = _mm_setr_epi32(s1 * n, 0, 0, 0);
+        v_s2 = _mm_setr_epi32(s2, 0, 0, 0);
+        v_s1 = _mm_setzero_si128();
+        do {
+            b1 = _mm_loadu_si128((const __m128i *)buf);
+            b2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b1, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                                 _mm_madd_epi16(_mm_maddubs_epi16(b1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(b2, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                                 _mm_madd_epi16(_mm_maddubs_epi16(b2, tap2), ones));
+            buf += ADLER32_SIMD_BLK_LEN;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 += (uint32_t)_mm_cvtsi128_si32(v_s1);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s2 = (uint32_t)_mm_cvtsi128_si32(v_s2);
+
+        s1 %= ADLER32_BASE;
+        s2 %= ADLER32_BASE;
+    }
+
+    adler = s1 | (s2 << 16);
+    if (len) {
+        adler = (uint32_t)adler32(adler, buf, len);
+    }
+    return adler;
+}
+#endif
+
+static void adler32Select(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        QZ_DEBUG("adler32: use SSSE3 implementation\n");
+        g_adler32 = adler32Ssse3;
+        return;
+    }
+#endif
+    QZ_DEBUG("adler32: use generic implementation\n");
+    g_adler32 = adler32Generic;
+}
+
+unsigned long qzAdler32(unsigned long adler, const unsigned char *buf,
+                        size_t len)
+{
+    if (len < ADLER32_SIMD_MIN_LEN) {
+        return adler32(adler, buf, len);
+    }
+    pthread_once(&g_adler32_once, adler32Select);
+    return g_adler32((uint32_t)adler, buf, len);
+}
+
+/* The copy runs ahead of the checksum in L1 sized blocks */
+unsigned long qzCopyAdler32(unsigned char *dst, const unsigned char *src,
+                            size_t len, unsigned long adler)
+{
+    size_t blk;
+
+    while (len > 0) {
+        blk = len > COPY_CSUM_BLK_LEN ? COPY_CSUM_BLK_LEN : len;
+        memcpy(dst, src, blk);
+        adler = qzAdler32(adler, dst, blk);
+        dst += blk;
+        src += blk;
+        len -= blk;
+    }
+    return adler;
+}
+
+unsigned long qzCrc32Combine(unsigned long crc1, unsigned long crc2,
+                             size_t len2)
+{
+    if (len2 != g_combine_len) {
+        g_combine_op = x2nModP(len2, 3);
+        g_combine_len = len2;
+    }
+    return multModP(g_combine_op, (uint32_t)crc1) ^ (crc2 & 0xffffffff);
+}
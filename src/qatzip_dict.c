@@ -0,0 +1,223 @@
+/***************************************************************************
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2007-2021 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "cpa.h"
+#include "cpa_dc.h"
+#include "qatzip.h"
+#include "qatzip_internal.h"
+#include "qz_utils.h"
+
+/* Training scores k-mers by the number of samples they occur in and
+ * picks the fixed size segments that cover the most common ones */
+#define DICT_TRAIN_K            8
+#define DICT_TRAIN_SEG_SZ       64
+#define DICT_TRAIN_HASH_LOG     16
+#define DICT_TRAIN_HASH_SZ      (1U << DICT_TRAIN_HASH_LOG)
+/* Larger sample sets are sampled down to about this many bytes */
+#define DICT_TRAIN_MAX_INPUT    (16 * 1024 * 1024)
+
+typedef struct DictSeg_S {
+    const unsigned char *ptr;
+    unsigned int len;
+    unsigned int score;
+} DictSeg_T;
+
+int qzSetDictionary(QzSession_T *sess, const unsigned char *dict,
+                    unsigned int dict_len)
+{
+    QzSess_T *qz_sess;
+    QzDataFormat_T data_fmt;
+    unsigned char *copy = NULL;
+
+    if (unlikely(NULL == sess || NULL == sess->internal ||
+                 (NULL == dict && 0 != dict_len) ||
+                 dict_len > QZ_DICT_MAX_SZ)) {
+        return QZ_PARAMS;
+    }
+
+    qz_sess = (QzSess_T *)sess->internal;
+    data_fmt = qz_sess->sess_params.data_fmt;
+    /* standard gzip and BGZF readers have no way to get a dictionary */
+    if (QZ_DEFLATE_RAW != data_fmt && QZ_DEFLATE_ZLIB != data_fmt &&
+        QZ_DEFLATE_GZIP_EXT != data_fmt && QZ_DEFLATE_4B != data_fmt) {
+        return QZ_PARAMS;
+    }
+    /* not in the middle of a stream */
+    if (DeflateNull != qz_sess->deflate_stat ||
+        InflateNull != qz_sess->inflate_stat || qz_sess->zlib_started) {
+        return QZ_FAIL;
+    }
+
+    if (dict_len) {
+        copy = malloc(dict_len);
+        if (NULL == copy) {
+            return QZ_FAIL;
+        }
+        QZ_MEMCPY(copy, dict, dict_len, dict_len);
+    }
+
+    free(qz_sess->dict);
+    qz_sess->dict = copy;
+    qz_sess->dict_len = dict_len;
+    /* DICTID of RFC 1950 */
+    qz_sess->dict_id = dict_len ? (uint32_t)qzAdler32(1, dict, dict_len) : 0;
+    return QZ_OK;
+}
+
+static inline uint32_t kmerHash(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9e3779b97f4a7c15ULL) >>
+                      (64 - DICT_TRAIN_HASH_LOG));
+}
+
+static unsigned int segScore(const DictSeg_T *seg, const uint32_t *cnt)
+{
+    unsigned int i, score = 0;
+
+    for (i = 0; i + DICT_TRAIN_K <= seg->len; i++) {
+        score += cnt[kmerHash(seg->ptr + i)];
+    }
+    return score;
+}
+
+static int segCmp(const void *a, const void *b)
+{
+    const DictSeg_T *x = a, *y = b;
+
+    return (x->score < y->score) - (x->score > y->score);
+}
+
+int qzTrainDictionary(const unsigned char *samples,
+                      const unsigned int *sample_lens,
+                      unsigned int sample_cnt,
+                      unsigned char *dict, unsigned int *dict_len)
+{
+    int rc = QZ_FAIL;
+    uint32_t *cnt = NULL, *seen = NULL;
+    DictSeg_T *segs = NULL;
+    unsigned long total = 0, seg_cnt = 0, seg_cap = 0;
+    unsigned int i, j, h, step, score;
+    unsigned int cap, used = 0, take;
+    const unsigned char *p;
+
+    if (unlikely(NULL == samples || NULL == sample_lens || NULL == dict ||
+                 NULL == dict_len || 0 == sample_cnt)) {
+        return QZ_PARAMS;
+    }
+
+    cap = MIN(*dict_len, QZ_DICT_MAX_SZ);
+    for (i = 0; i < sample_cnt; i++) {
+        total += sample_lens[i];
+    }
+    /* take every step-th record, so all of the set is represented */
+    step = (unsigned int)(total / DICT_TRAIN_MAX_INPUT) + 1;
+
+    cnt = calloc(DICT_TRAIN_HASH_SZ, sizeof(*cnt));
+    seen = calloc(DICT_TRAIN_HASH_SZ, sizeof(*seen));
+    seg_cap = MIN(total, DICT_TRAIN_MAX_INPUT) / DICT_TRAIN_SEG_SZ +
+              sample_cnt / step + 1;
+    segs = malloc(seg_cap * sizeof(*segs));
+    if (NULL == cnt || NULL == seen || NULL == segs) {
+        goto done;
+    }
+
+    /* count each k-mer once per sample it occurs in */
+    for (i = 0, p = samples; i < sample_cnt; p += sample_lens[i++]) {
+        if (i % step || sample_lens[i] < DICT_TRAIN_K) {
+            continue;
+        }
+        for (j = 0; j + DICT_TRAIN_K <= sample_lens[i]; j++) {
+            h = kmerHash(p + j);
+            if (seen[h] != i + 1) {
+                seen[h] = i + 1;
+                cnt[h]++;
+            }
+        }
+        for (j = 0; j < sample_lens[i] && seg_cnt < seg_cap;
+             j += DICT_TRAIN_SEG_SZ) {
+            segs[seg_cnt].ptr = p + j;
+            segs[seg_cnt].len = MIN(DICT_TRAIN_SEG_SZ, sample_lens[i] - j);
+            seg_cnt++;
+        }
+    }
+
+    /* a k-mer in a single sample saves nothing across records */
+    for (h = 0; h < DICT_TRAIN_HASH_SZ; h++) {
+        if (cnt[h] < 2) {
+            cnt[h] = 0;
+        }
+    }
+    for (i = 0; i < seg_cnt; i++) {
+        segs[i].score = segScore(&segs[i], cnt);
+    }
+    qsort(segs, seg_cnt, sizeof(*segs), segCmp);
+
+    /*
+     * Best segments go last, where deflate reaches them with the shortest
+     * distances. A segment whose k-mers an earlier pick already covers
+     * for the most part is skipped.
+     */
+    for (i = 0; i < seg_cnt && used < cap && segs[i].score; i++) {
+        score = segScore(&segs[i], cnt);
+        if (score * 2 < segs[i].score) {
+            continue;
+        }
+        take = MIN(segs[i].len, cap - used);
+        QZ_MEMCPY(dict + cap - used - take, segs[i].ptr + segs[i].len - take,
+                  take, take);
+        used += take;
+        for (j = 0; j + DICT_TRAIN_K <= segs[i].len; j++) {
+            cnt[kmerHash(segs[i].ptr + j)] = 0;
+        }
+    }
+
+    memmove(dict, dict + cap - used, used);
+    *dict_len = used;
+    rc = QZ_OK;
+
+done:
+    free(cnt);
+    free(seen);
+    free(segs);
+    return rc;
+}
@@ -38,7 +38,11 @@
 #include <string.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <assert.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 #include "cpa.h"
 #include "cpa_dc.h"
@@ -67,7 +71,9 @@ inline unsigned long outputFooterSz(QzDataFormat_T data_fmt)
 {
     unsigned long size = 0;
     switch (data_fmt) {
+    case QZ_DEFLATE_4B:
     case QZ_DEFLATE_RAW:
+    case QZ_DEFLATE_ZLIB:
         size = 0;
         break;
     case QZ_DEFLATE_GZIP_EXT:
@@ -84,11 +90,18 @@ unsigned long outputHeaderSz(QzDataFormat_T data_fmt)
     unsigned long size = 0;
 
     switch (data_fmt) {
+    case QZ_DEFLATE_4B:
+        size = sizeof(QzDeflate4BH_T);
+        break;
     case QZ_DEFLATE_RAW:
+    case QZ_DEFLATE_ZLIB:
         break;
     case QZ_DEFLATE_GZIP:
         size = stdGzipHeaderSz();
         break;
+    case QZ_DEFLATE_BGZF:
+        size = sizeof(BgzfH_T);
+        break;
     case QZ_DEFLATE_GZIP_EXT:
     default:
         size = qzGzipHeaderSz();
@@ -131,6 +144,44 @@ void qzGzipHeaderGen(unsigned char *ptr, CpaDcRqResults *res)
     qzGzipHeaderExtraFieldGen((unsigned char *)&hdr->extra, res);
 }
 
+void qzGzipDictHeaderGen(unsigned char *ptr, CpaDcRqResults *res,
+                         uint32_t dict_id)
+{
+    QzGzDictH_T *hdr;
+
+    hdr = (QzGzDictH_T *)ptr;
+    qzGzipHeaderGen(ptr, res);
+    hdr->x_len = (uint16_t)(sizeof(hdr->extra) + sizeof(hdr->dict));
+    hdr->dict.st1 = 'Q';
+    hdr->dict.st2 = 'D';
+    hdr->dict.x2_len = (uint16_t)sizeof(hdr->dict.dict_id);
+    hdr->dict.dict_id = dict_id;
+}
+
+/* Same as qzGzipHeaderExt for members compressed with a dictionary */
+int qzGzipDictHeaderExt(const unsigned char *const ptr, long src_len,
+                        QzGzH_T *hdr, uint32_t *dict_id)
+{
+    const QzGzDictH_T *h = (const QzGzDictH_T *)ptr;
+
+    if (src_len < sizeof(QzGzDictH_T)                              || \
+        h->std_hdr.id1 != 0x1f || h->std_hdr.id2 != 0x8b            || \
+        h->std_hdr.cm != QZ_DEFLATE || h->std_hdr.flag != 0x04      || \
+        h->x_len != sizeof(h->extra) + sizeof(h->dict)              || \
+        h->extra.st1 != 'Q' || h->extra.st2 != 'Z'                  || \
+        h->extra.x2_len != sizeof(h->extra.qz_e)                    || \
+        h->dict.st1 != 'Q' || h->dict.st2 != 'D'                    || \
+        h->dict.x2_len != sizeof(h->dict.dict_id)) {
+        return QZ_FAIL;
+    }
+
+    if (NULL != hdr) {
+        QZ_MEMCPY(hdr, ptr, sizeof(*hdr), sizeof(*hdr));
+    }
+    *dict_id = h->dict.dict_id;
+    return QZ_OK;
+}
+
 void stdGzipHeaderGen(unsigned char *ptr, CpaDcRqResults *res)
 {
     assert(ptr != NULL);
@@ -150,6 +201,312 @@ void stdGzipHeaderGen(unsigned char *ptr, CpaDcRqResults *res)
     hdr->os       = 255;
 }
 
+void qz4BHeaderGen(unsigned char *ptr, CpaDcRqResults *res)
+{
+    assert(ptr != NULL);
+    assert(res != NULL);
+    QzDeflate4BH_T *hdr;
+
+    hdr = (QzDeflate4BH_T *)ptr;
+    hdr->blk_size = res->produced;
+}
+
+unsigned int qz4BHeaderExt(const unsigned char *const ptr)
+{
+    return ((const QzDeflate4BH_T *)ptr)->blk_size;
+}
+
+void bgzfHeaderGen(unsigned char *ptr, CpaDcRqResults *res)
+{
+    assert(ptr != NULL);
+    assert(res != NULL);
+    BgzfH_T *hdr;
+
+    hdr = (BgzfH_T *)ptr;
+    stdGzipHeaderGen(ptr, res);
+    hdr->std_hdr.flag = 0x04; /*Fextra BIT SET*/
+    hdr->x_len = 6;
+    hdr->si1 = 'B';
+    hdr->si2 = 'C';
+    hdr->s_len = 2;
+    hdr->bsize = (uint16_t)(sizeof(BgzfH_T) + res->produced +
+                            stdGzipFooterSz() - 1);
+}
+
+/* Total size of the BGZF block at ptr, -1 if ptr is not one */
+long bgzfBlockSz(const unsigned char *const ptr, long src_len)
+{
+    const BgzfH_T *h = (const BgzfH_T *)ptr;
+
+    if (src_len < sizeof(BgzfH_T) ||
+        h->std_hdr.id1 != 0x1f       || \
+        h->std_hdr.id2 != 0x8b       || \
+        h->std_hdr.cm  != QZ_DEFLATE || \
+        h->std_hdr.flag != 0x04      || \
+        h->x_len != 6                || \
+        h->si1 != 'B'                || \
+        h->si2 != 'C'                || \
+        h->s_len != 2) {
+        return -1;
+    }
+
+    return (long)h->bsize + 1;
+}
+
+/* The empty block a BGZF file must end with */
+static const unsigned char g_bgzf_eof[] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+    0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+unsigned long bgzfEofSz(void)
+{
+    return sizeof(g_bgzf_eof);
+}
+
+void bgzfEofGen(unsigned char *ptr)
+{
+    assert(ptr != NULL);
+    QZ_MEMCPY(ptr, g_bgzf_eof, sizeof(g_bgzf_eof), sizeof(g_bgzf_eof));
+}
+
+/*
+ * A zlib stream wraps all chunks of a QZ_DEFLATE_ZLIB session, so its
+ * header and trailer are written once per stream, not per chunk.
+ */
+unsigned long zlibHeaderSz(const QzSess_T *qz_sess)
+{
+    /* DICTID follows when there is a preset dictionary */
+    return (NULL != qz_sess->dict) ? 6 : 2;
+}
+
+unsigned long zlibFooterSz(void)
+{
+    return 4;
+}
+
+void zlibHeaderGen(unsigned char *ptr, const QzSess_T *qz_sess)
+{
+    unsigned int hdr;
+    unsigned int level;
+    unsigned int comp_lvl = qz_sess->sess_params.comp_lvl;
+
+    assert(ptr != NULL);
+    /* FLEVEL is informational, mapped the way zlib does */
+    if (comp_lvl < 2) {
+        level = 0;
+    } else if (comp_lvl < 6) {
+        level = 1;
+    } else if (comp_lvl == 6) {
+        level = 2;
+    } else {
+        level = 3;
+    }
+
+    /* CM 8, 32K window */
+    hdr = (0x78 << 8) | (level << 6);
+    if (NULL != qz_sess->dict) {
+        hdr |= 0x20; /* FDICT */
+    }
+    hdr += 31 - (hdr % 31);
+    ptr[0] = (unsigned char)(hdr >> 8);
+    ptr[1] = (unsigned char)hdr;
+    if (NULL != qz_sess->dict) {
+        zlibFooterGen(ptr + 2, qz_sess->dict_id);
+    }
+}
+
+void zlibFooterGen(unsigned char *ptr, unsigned long adler)
+{
+    assert(ptr != NULL);
+    ptr[0] = (unsigned char)(adler >> 24);
+    ptr[1] = (unsigned char)(adler >> 16);
+    ptr[2] = (unsigned char)(adler >> 8);
+    ptr[3] = (unsigned char)adler;
+}
+
+/*
+ * The member index is a run of empty gzip members, skipped by any gzip
+ * reader. Each carries up to QZ_MEMBER_INDEX_PER_MBR entries in a 'QI'
+ * subfield, the last one also a fixed size 'QL' subfield with the
+ * totals, so the index is found from the end of the archive.
+ */
+#define MBR_IDX_ENTRY_SZ    (2 * sizeof(uint64_t))
+#define MBR_IDX_HDR_SZ      (sizeof(StdGzH_T) + sizeof(uint16_t) + 4)
+#define MBR_IDX_TAIL_SZ     (2 + sizeof(StdGzF_T))
+#define MBR_IDX_QL_LEN      (2 * sizeof(uint64_t) + 2 * sizeof(uint32_t))
+#define MBR_IDX_QL_SZ       (4 + MBR_IDX_QL_LEN)
+#define MBR_IDX_FULL_SZ     (MBR_IDX_HDR_SZ + \
+                             QZ_MEMBER_INDEX_PER_MBR * MBR_IDX_ENTRY_SZ + \
+                             MBR_IDX_TAIL_SZ)
+
+int qzMemberIndexReserve(QzSess_T *qz_sess, unsigned long cnt)
+{
+    QzMemberIdx_T *idx;
+
+    if (cnt <= qz_sess->mbr_idx_cap) {
+        return QZ_OK;
+    }
+    if (cnt < 2 * qz_sess->mbr_idx_cap) {
+        cnt = 2 * qz_sess->mbr_idx_cap;
+    }
+    idx = realloc(qz_sess->mbr_idx, cnt * sizeof(*idx));
+    if (NULL == idx) {
+        return QZ_FAIL;
+    }
+    qz_sess->mbr_idx = idx;
+    qz_sess->mbr_idx_cap = cnt;
+    return QZ_OK;
+}
+
+/* Room is reserved before the request is sent, this never allocates */
+void qzMemberIndexAdd(QzSess_T *qz_sess, unsigned long comp_sz,
+                      unsigned long orig_sz)
+{
+    assert(qz_sess->mbr_idx_cnt < qz_sess->mbr_idx_cap);
+    qz_sess->mbr_idx[qz_sess->mbr_idx_cnt].comp_off = qz_sess->mbr_comp_off;
+    qz_sess->mbr_idx[qz_sess->mbr_idx_cnt].orig_off = qz_sess->mbr_orig_off;
+    qz_sess->mbr_idx_cnt++;
+    qz_sess->mbr_comp_off += comp_sz;
+    qz_sess->mbr_orig_off += orig_sz;
+}
+
+unsigned long qzMemberIndexSz(unsigned long cnt)
+{
+    unsigned long mbrs = (cnt + QZ_MEMBER_INDEX_PER_MBR - 1) /
+                         QZ_MEMBER_INDEX_PER_MBR;
+
+    if (0 == mbrs) {
+        mbrs = 1;
+    }
+    return mbrs * (MBR_IDX_HDR_SZ + MBR_IDX_TAIL_SZ) +
+           cnt * MBR_IDX_ENTRY_SZ + MBR_IDX_QL_SZ;
+}
+
+static unsigned char *putSubfieldHdr(unsigned char *p, char si2,
+                                     uint16_t len)
+{
+    p[0] = 'Q';
+    p[1] = si2;
+    QZ_MEMCPY(p + 2, &len, sizeof(len), sizeof(len));
+    return p + 4;
+}
+
+/* Writes the index of the members added so far and starts a new one */
+unsigned long qzMemberIndexGen(QzSess_T *qz_sess, unsigned char *ptr)
+{
+    unsigned long done = 0, n;
+    unsigned long total = qzMemberIndexSz(qz_sess->mbr_idx_cnt);
+    unsigned char *p = ptr;
+    CpaDcRqResults res = {0};
+    uint16_t x_len;
+    uint32_t u32;
+
+    do {
+        n = qz_sess->mbr_idx_cnt - done;
+        if (n > QZ_MEMBER_INDEX_PER_MBR) {
+            n = QZ_MEMBER_INDEX_PER_MBR;
+        }
+        stdGzipHeaderGen(p, &res);
+        ((StdGzH_T *)p)->flag = 0x04; /*Fextra BIT SET*/
+        p += sizeof(StdGzH_T);
+        x_len = (uint16_t)(4 + n * MBR_IDX_ENTRY_SZ);
+        if (done + n == qz_sess->mbr_idx_cnt) {
+            x_len += MBR_IDX_QL_SZ;
+        }
+        QZ_MEMCPY(p, &x_len, sizeof(x_len), sizeof(x_len));
+        p += sizeof(x_len);
+
+        p = putSubfieldHdr(p, 'I', (uint16_t)(n * MBR_IDX_ENTRY_SZ));
+        QZ_MEMCPY(p, qz_sess->mbr_idx + done, n * MBR_IDX_ENTRY_SZ,
+                  n * MBR_IDX_ENTRY_SZ);
+        p += n * MBR_IDX_ENTRY_SZ;
+        done += n;
+
+        if (done == qz_sess->mbr_idx_cnt) {
+            p = putSubfieldHdr(p, 'L', MBR_IDX_QL_LEN);
+            QZ_MEMCPY(p, &qz_sess->mbr_comp_off, sizeof(uint64_t),
+                      sizeof(uint64_t));
+            QZ_MEMCPY(p + 8, &qz_sess->mbr_orig_off, sizeof(uint64_t),
+                      sizeof(uint64_t));
+            u32 = (uint32_t)total;
+            QZ_MEMCPY(p + 16, &u32, sizeof(u32), sizeof(u32));
+            u32 = (uint32_t)qz_sess->mbr_idx_cnt;
+            QZ_MEMCPY(p + 20, &u32, sizeof(u32), sizeof(u32));
+            p += MBR_IDX_QL_LEN;
+        }
+
+        /* empty final fixed Huffman block, crc32 and isize of nothing */
+        *p++ = 0x03;
+        *p++ = 0x00;
+        memset(p, 0, sizeof(StdGzF_T));
+        p += sizeof(StdGzF_T);
+    } while (done < qz_sess->mbr_idx_cnt);
+
+    assert(p - ptr == total);
+    qz_sess->mbr_idx_cnt = 0;
+    qz_sess->mbr_comp_off = 0;
+    qz_sess->mbr_orig_off = 0;
+    return total;
+}
+
+/* Finds the member index ending src, QZ_FAIL if there is none */
+int qzMemberIndexExt(const unsigned char *src, unsigned long src_len,
+                     QzMemberIndex_T *idx)
+{
+    const unsigned char *ql;
+    uint32_t region_sz, cnt;
+
+    if (src_len < MBR_IDX_HDR_SZ + MBR_IDX_QL_SZ + MBR_IDX_TAIL_SZ) {
+        return QZ_FAIL;
+    }
+    ql = src + src_len - MBR_IDX_TAIL_SZ - MBR_IDX_QL_SZ;
+    if (ql[0] != 'Q' || ql[1] != 'L' || ql[2] != MBR_IDX_QL_LEN ||
+        ql[3] != 0 || ql[MBR_IDX_QL_SZ] != 0x03) {
+        return QZ_FAIL;
+    }
+    ql += 4;
+    QZ_MEMCPY(&idx->comp_total, ql, sizeof(uint64_t), sizeof(uint64_t));
+    QZ_MEMCPY(&idx->orig_total, ql + 8, sizeof(uint64_t), sizeof(uint64_t));
+    QZ_MEMCPY(&region_sz, ql + 16, sizeof(uint32_t), sizeof(uint32_t));
+    QZ_MEMCPY(&cnt, ql + 20, sizeof(uint32_t), sizeof(uint32_t));
+
+    if (region_sz != qzMemberIndexSz(cnt) ||
+        region_sz > src_len ||
+        idx->comp_total != src_len - region_sz ||
+        !isMemberIndex(src + idx->comp_total, region_sz)) {
+        return QZ_FAIL;
+    }
+    idx->region = src + idx->comp_total;
+    idx->cnt = cnt;
+    return QZ_OK;
+}
+
+void qzMemberIndexEntry(const QzMemberIndex_T *idx, unsigned long k,
+                        QzMemberIdx_T *ent)
+{
+    const unsigned char *p = idx->region +
+                             (k / QZ_MEMBER_INDEX_PER_MBR) * MBR_IDX_FULL_SZ +
+                             MBR_IDX_HDR_SZ +
+                             (k % QZ_MEMBER_INDEX_PER_MBR) * MBR_IDX_ENTRY_SZ;
+
+    assert(k < idx->cnt);
+    QZ_MEMCPY(ent, p, sizeof(*ent), sizeof(*ent));
+}
+
+/* Whether src starts with a member of an index */
+int isMemberIndex(const unsigned char *src, long src_len)
+{
+    const StdGzH_T *h = (const StdGzH_T *)src;
+
+    return (src_len >= MBR_IDX_HDR_SZ + MBR_IDX_TAIL_SZ &&
+            h->id1 == 0x1f && h->id2 == 0x8b && h->cm == QZ_DEFLATE &&
+            h->flag == 0x04 &&
+            src[sizeof(StdGzH_T) + 2] == 'Q' &&
+            src[sizeof(StdGzH_T) + 3] == 'I');
+}
+
 void outputHeaderGen(unsigned char *ptr,
                      CpaDcRqResults *res,
                      QzDataFormat_T data_fmt)
@@ -157,11 +514,18 @@ void outputHeaderGen(unsigned char *ptr,
     QZ_DEBUG("Generate header\n");
 
     switch (data_fmt) {
+    case QZ_DEFLATE_4B:
+        qz4BHeaderGen(ptr, res);
+        break;
     case QZ_DEFLATE_RAW:
+    case QZ_DEFLATE_ZLIB:
         break;
     case QZ_DEFLATE_GZIP:
         stdGzipHeaderGen(ptr, res);
         break;
+    case QZ_DEFLATE_BGZF:
+        bgzfHeaderGen(ptr, res);
+        break;
     case QZ_DEFLATE_GZIP_EXT:
     default:
         qzGzipHeaderGen(ptr, res);
@@ -178,12 +542,24 @@ int isQATProcessable(const unsigned char *ptr,
     long buff_sz = (DEST_SZ(qz_sess->sess_params.hw_buff_sz) < *src_len ? DEST_SZ(
                         qz_sess->sess_params.hw_buff_sz) : *src_len);
 
+    /* 4B blocks carry their compressed length, no need to look further */
+    if (QZ_DEFLATE_4B == qz_sess->sess_params.data_fmt) {
+        return (*src_len >= sizeof(QzDeflate4BH_T) &&
+                qz4BHeaderExt(ptr) <= DEST_SZ(qz_sess->sess_params.hw_buff_sz));
+    }
+
+    /* a BGZF block never exceeds 64K, whatever the other end used */
+    if (QZ_DEFLATE_BGZF == qz_sess->sess_params.data_fmt) {
+        return (bgzfBlockSz(ptr, *src_len) > 0);
+    }
+
     /*check if HW can process*/
     if (h->std_hdr.id1 == 0x1f       && \
         h->std_hdr.id2 == 0x8b       && \
         h->std_hdr.cm  == QZ_DEFLATE && \
         h->std_hdr.flag == 0x00) {
-        qzFooter = (StdGzF_T *)(findStdGzipFooter((const unsigned char *)h, buff_sz));
+        qzFooter = (StdGzF_T *)(findStdGzipFooter((const unsigned char *)h, buff_sz,
+                                                        GZIP_SCAN_LEVEL(qz_sess)));
         if ((unsigned char *)qzFooter - ptr - stdGzipHeaderSz() > DEST_SZ(
                 qz_sess->sess_params.hw_buff_sz) ||
             qzFooter->i_size > qz_sess->sess_params.hw_buff_sz) {
@@ -253,7 +629,9 @@ inline void outputFooterGen(QzSess_T *qz_sess,
 
     unsigned char *ptr = qz_sess->next_dest;
     switch (data_fmt) {
+    case QZ_DEFLATE_4B:
     case QZ_DEFLATE_RAW:
+    case QZ_DEFLATE_ZLIB:
         break;
     case QZ_DEFLATE_GZIP_EXT:
     default:
@@ -267,23 +645,297 @@ void qzGzipFooterExt(const unsigned char *const ptr, StdGzF_T *ftr)
     QZ_MEMCPY(ftr, ptr, sizeof(*ftr), sizeof(*ftr));
 }
 
+/* Header, an empty deflate stream (2 bytes) and footer */
+#define STD_GZIP_MIN_MEMBER_SZ  (sizeof(StdGzH_T) + 2 + sizeof(StdGzF_T))
+/* Deflate never expands data by more than this ratio */
+#define DEFLATE_MAX_RATIO       1032
+/* Output a candidate member is trial inflated for before it is accepted */
+#define BOUNDARY_TRIAL_SZ       4096
+
+/* Returns the first p in [p, end) where id1 id2 cm flag = 1f 8b 08 00 */
+typedef const unsigned char *(*GzipSigScan_T)(const unsigned char *p,
+                                              const unsigned char *end);
+
+static pthread_once_t g_gzip_sig_scan_once = PTHREAD_ONCE_INIT;
+static GzipSigScan_T g_gzip_sig_scan = NULL;
+
+static const unsigned char *gzipSigScanScalar(const unsigned char *p,
+                                              const unsigned char *end)
+{
+    for (; p < end; p++) {
+        if (p[0] == 0x1f && p[1] == 0x8b && p[2] == QZ_DEFLATE && p[3] == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+#if defined(__x86_64__)
+/* The four signature bytes are compared at four shifted loads */
+static const unsigned char *gzipSigScanSse2(const unsigned char *p,
+                                            const unsigned char *end)
+{
+    const __m128i id1 = _mm_set1_epi8(0x1f);
+    const __m128i id2 = _mm_set1_epi8((char)0x8b);
+    const __m128i cm = _mm_set1_epi8(QZ_DEFLATE);
+    const __m128i flag = _mm_setzero_si128();
+    __m128i m;
+    unsigned int mask;
+
+    while (p + 16 <= end) {
+        m = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), id1),
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), id2)),
+                _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 2)), cm),
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 3)), flag)));
+        mask = (unsigned int)_mm_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return gzipSigScanScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *gzipSigScanAvx2(const unsigned char *p,
+                                            const unsigned char *end)
+{
+    const __m256i id1 = _mm256_set1_epi8(0x1f);
+    const __m256i id2 = _mm256_set1_epi8((char)0x8b);
+    const __m256i cm = _mm256_set1_epi8(QZ_DEFLATE);
+    const __m256i flag = _mm256_setzero_si256();
+    __m256i m;
+    unsigned int mask;
+
+    while (p + 32 <= end) {
+        m = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), id1),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 1)), id2)),
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 2)), cm),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 3)), flag)));
+        mask = (unsigned int)_mm256_movemask_epi8(m);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return gzipSigScanSse2(p, end);
+}
+#endif
+
+static void gzipSigScanSelect(void)
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    g_gzip_sig_scan = __builtin_cpu_supports("avx2") ? gzipSigScanAvx2 :
+                      gzipSigScanSse2;
+#else
+    g_gzip_sig_scan = gzipSigScanScalar;
+#endif
+}
+
+/* inflate state set up once per scan and reset for every trial */
+typedef struct GzipTrial_S {
+    z_stream strm;
+    int inited;
+    unsigned char out[BOUNDARY_TRIAL_SZ];
+} GzipTrial_T;
+
+/*
+ * Trial inflate the start of a candidate member. A real member begins a
+ * new deflate stream, so its block headers decode and no match reaches
+ * in front of it; payload bytes that only look like a header fail both.
+ */
+static int isDeflateStart(GzipTrial_T *trial, const unsigned char *blk,
+                          const unsigned char *end)
+{
+    z_stream *strm = &trial->strm;
+    int ret;
+
+    if (0 == trial->inited) {
+        memset(strm, 0, sizeof(*strm));
+        if (Z_OK != inflateInit2(strm, -MAX_WBITS)) {
+            return 1;
+        }
+        trial->inited = 1;
+    } else if (Z_OK != inflateReset(strm)) {
+        return 1;
+    }
+    strm->next_in = (z_const Bytef *)blk;
+    strm->avail_in = (end - blk > UINT_MAX) ? UINT_MAX : (uInt)(end - blk);
+    strm->next_out = trial->out;
+    strm->avail_out = sizeof(trial->out);
+    ret = inflate(strm, Z_NO_FLUSH);
+
+    return Z_DATA_ERROR != ret && Z_NEED_DICT != ret;
+}
+
+/*
+ * A signature found inside a member's payload is only taken as the start
+ * of the next member if the footer in front of it is plausible and, with
+ * a trial state given, the deflate stream behind it really inflates.
+ */
+static int isStdGzipBoundary(const unsigned char *start,
+                             const unsigned char *hdr,
+                             const unsigned char *end,
+                             GzipTrial_T *trial)
+{
+    const StdGzH_T *h = (const StdGzH_T *)hdr;
+    const StdGzF_T *f = (const StdGzF_T *)(hdr - stdGzipFooterSz());
+    const unsigned char *blk = hdr + stdGzipHeaderSz();
+    unsigned long long comp_len = hdr - start - stdGzipHeaderSz() -
+                                  stdGzipFooterSz();
+
+    if ((h->xfl != 0 && h->xfl != 2 && h->xfl != 4) ||
+        (h->os > 13 && h->os != 255)) {
+        return 0;
+    }
+
+    /* previous footer: ISIZE bounded by the deflate ratio, empty has crc 0 */
+    if (f->i_size > comp_len * DEFLATE_MAX_RATIO ||
+        (0 == f->i_size && 0 != f->crc32)) {
+        return 0;
+    }
+
+    /* nothing of the candidate is in the buffer yet to check */
+    if (NULL == trial || blk >= end) {
+        return 1;
+    }
+    return isDeflateStart(trial, blk, end);
+}
+
+/*
+ * Walk the std gzip members starting at src_ptr and store the footer of
+ * each in footers, at most max_cnt of them. The member that has no next
+ * header in the buffer is taken to end with the buffer. Above GzipScanSig,
+ * candidates are checked by isStdGzipBoundary. Returns the footer count.
+ */
+int findStdGzipMembers(const unsigned char *src_ptr, long src_avail_len,
+                       unsigned char **footers, int max_cnt, GzipScan_T level)
+{
+    const unsigned char *start = src_ptr;
+    const unsigned char *end = src_ptr + src_avail_len;
+    const unsigned char *p, *hdr;
+    GzipTrial_T trial;
+    GzipSigScan_T scan;
+    int cnt = 0;
+
+    trial.inited = 0;
+
+    pthread_once(&g_gzip_sig_scan_once, gzipSigScanSelect);
+    scan = g_gzip_sig_scan;
+
+    while (cnt < max_cnt) {
+        hdr = NULL;
+        p = start + STD_GZIP_MIN_MEMBER_SZ;
+        while (p + stdGzipHeaderSz() <= end) {
+            hdr = scan(p, end - stdGzipHeaderSz() + 1);
+            if (NULL == hdr || GzipScanSig == level ||
+                isStdGzipBoundary(start, hdr, end,
+                                  GzipScanInflate == level ? &trial : NULL)) {
+                break;
+            }
+            p = hdr + 1;
+            hdr = NULL;
+        }
+
+        if (NULL == hdr) {
+            footers[cnt++] = (unsigned char *)end - stdGzipFooterSz();
+            break;
+        }
+        footers[cnt++] = (unsigned char *)hdr - stdGzipFooterSz();
+        start = hdr;
+    }
+
+    if (trial.inited) {
+        inflateEnd(&trial.strm);
+    }
+    return cnt;
+}
+
 unsigned char *findStdGzipFooter(const unsigned char *src_ptr,
-                                 long src_avail_len)
-{
-    StdGzH_T *gzHeader = NULL;
-    unsigned int offset = stdGzipHeaderSz() + stdGzipFooterSz();
-
-    while (src_avail_len >= offset + stdGzipHeaderSz()) {
-        gzHeader = (StdGzH_T *)(src_ptr + offset);
-        if (gzHeader->id1 == 0x1f       && \
-            gzHeader->id2 == 0x8b       && \
-            gzHeader->cm  == QZ_DEFLATE && \
-            gzHeader->flag == 0x00) {
-            return (void *)((unsigned char *)gzHeader - stdGzipFooterSz());
+                                 long src_avail_len, GzipScan_T level)
+{
+    unsigned char *footer = NULL;
+
+    findStdGzipMembers(src_ptr, src_avail_len, &footer, 1, level);
+    return footer;
+}
+
+/*
+ * Sums the ISIZE of every member without inflating: gzip-ext and BGZF
+ * members give their length in the header, a std gzip member ends where
+ * the next header accepted at level starts. A trailing member index has both
+ * totals already. Index members and empty members are not counted.
+ */
+int qzGzipMembersSz(const unsigned char *src, unsigned long src_len,
+                    unsigned long *orig_sz, unsigned long *mbr_cnt,
+                    GzipScan_T level)
+{
+    const unsigned char *p = src;
+    const unsigned char *end = src + src_len;
+    const StdGzH_T *h;
+    unsigned char *footer;
+    QzMemberIndex_T idx;
+    QzGzH_T hdr;
+    StdGzF_T ftr;
+    uint16_t x_len;
+    uint32_t dict_id;
+    long sz;
+
+    if (QZ_OK == qzMemberIndexExt(src, src_len, &idx)) {
+        *orig_sz = idx.orig_total;
+        *mbr_cnt = idx.cnt;
+        return QZ_OK;
+    }
+
+    *orig_sz = 0;
+    *mbr_cnt = 0;
+    while (p < end) {
+        h = (const StdGzH_T *)p;
+        if (end - p < STD_GZIP_MIN_MEMBER_SZ ||
+            h->id1 != 0x1f || h->id2 != 0x8b || h->cm != QZ_DEFLATE) {
+            return QZ_DATA_ERROR;
+        }
+
+        if ((sz = bgzfBlockSz(p, end - p)) > 0) {
+            if (sz < STD_GZIP_MIN_MEMBER_SZ) {
+                return QZ_DATA_ERROR;
+            }
+        } else if (QZ_OK == qzGzipHeaderExt(p, &hdr)) {
+            /* a SW member spanning several calls has no sizes */
+            if (0 == hdr.extra.qz_e.dest_sz) {
+                return QZ_FAIL;
+            }
+            sz = qzGzipHeaderSz() + hdr.extra.qz_e.dest_sz + stdGzipFooterSz();
+        } else if (QZ_OK == qzGzipDictHeaderExt(p, end - p, &hdr, &dict_id)) {
+            sz = sizeof(QzGzDictH_T) + hdr.extra.qz_e.dest_sz +
+                 stdGzipFooterSz();
+        } else if (isMemberIndex(p, end - p)) {
+            QZ_MEMCPY(&x_len, p + sizeof(StdGzH_T), sizeof(x_len),
+                      sizeof(x_len));
+            sz = sizeof(StdGzH_T) + sizeof(x_len) + x_len + MBR_IDX_TAIL_SZ;
+        } else {
+            findStdGzipMembers(p, end - p, &footer, 1, level);
+            sz = footer + stdGzipFooterSz() - p;
+        }
+        if (sz > end - p) {
+            return QZ_DATA_ERROR;
         }
-        offset++;
+
+        qzGzipFooterExt(p + sz - stdGzipFooterSz(), &ftr);
+        if (ftr.i_size && !isMemberIndex(p, sz)) {
+            *orig_sz += ftr.i_size;
+            (*mbr_cnt)++;
+        }
+        p += sz;
     }
-    return (void *)((unsigned char *)src_ptr + src_avail_len - stdGzipFooterSz());
+    return QZ_OK;
 }
 
 #pragma pack(pop)
@@ -45,7 +45,7 @@ extern"C" {
 /**
  *  define lib version
  */
-#define QATZIP_VERSION "1.0.5"
+#define QATZIP_VERSION "2.0.0"
 
 #define SUCCESS              1
 #define FAILURE              0
@@ -70,6 +70,15 @@ extern"C" {
 #define QAT_MAX_DEVICES     32
 #define STORED_BLK_MAX_LEN  65535
 #define STORED_BLK_HDR_SZ   5
+/* entropy sampling of a chunk, see sampleChunk */
+#define QZ_SAMPLE_CNT       8
+#define QZ_SAMPLE_SZ        512
+/* QZ_AUTO_HDR picks static trees below this size or from this entropy */
+#define QZ_AUTO_HDR_MIN_SZ  (1024)
+#define QZ_AUTO_HDR_ENTROPY 700
+/* chunks of one byte value, see qzUniformChunk */
+#define QZ_RUN_MIN_SZ       (4 * 1024)
+#define QZ_RUN_CACHE_CNT    4
 
 #define QZ_SETUP_SESSION_FAIL(rc) (QZ_FAIL == rc       || \
                                    QZ_PARAMS == rc     || \
@@ -79,6 +88,34 @@ extern"C" {
 #define likely(x)   __builtin_expect (!!(x), 1)
 #define unlikely(x) __builtin_expect (!!(x), 0)
 #define DEST_SZ(src_sz)           (((9 * (src_sz)) / 8) + 1024)
+#define QZ_GZIP_MEMBER_BATCH      64
+/* entries per index member, keeps its extra field below 64K */
+#define QZ_MEMBER_INDEX_PER_MBR   4080
+#define IS_MEMBER_INDEXED(qz_sess) \
+        ((QZ_DEFLATE_GZIP_EXT == (qz_sess)->sess_params.data_fmt || \
+          QZ_DEFLATE_BGZF == (qz_sess)->sess_params.data_fmt) && \
+         1 == (qz_sess)->sess_params.member_index)
+/* BGZF blocks hold at most 64K, uncompressible data included */
+#define QZ_BGZF_BLK_MAX_SZ        (64 * 1024)
+#define QZ_BGZF_DATA_MAX_SZ       0xff00
+#define CHUNK_SZ(qz_sess) \
+        ((QZ_DEFLATE_BGZF == (qz_sess)->sess_params.data_fmt) ? \
+         MIN((qz_sess)->sess_params.hw_buff_sz, QZ_BGZF_DATA_MAX_SZ) : \
+         (qz_sess)->sess_params.hw_buff_sz)
+#define GZIP_SCAN_LEVEL(qz_sess) \
+        ((qz_sess)->sess_params.member_verify ? GzipScanInflate : \
+         GzipScanCheap)
+
+/* deflate encoding of a run of one byte value and its checksums */
+typedef struct QzRunEnc_S {
+    unsigned int len;
+    unsigned char byte;
+    unsigned char final;
+    unsigned int enc_len;
+    unsigned long crc32;
+    unsigned long adler;
+    unsigned char *enc;
+} QzRunEnc_T;
 
 typedef struct QzCpaStream_S {
     signed long seq;
@@ -94,6 +131,10 @@ typedef struct QzCpaStream_S {
     int dest_pinned;
     unsigned int gzip_footer_checksum;
     unsigned int gzip_footer_orgdatalen;
+    /* Adler-32 of the request's source, hardware only returns CRC32 */
+    unsigned long adler;
+    /* not submitted, doCompressOut writes it as stored blocks */
+    int stored;
 } QzCpaStream_T;
 
 typedef struct QzInstance_S {
@@ -117,6 +158,8 @@ typedef struct QzInstance_S {
     CpaStatus inst_start_status;
     unsigned int num_retries;
     CpaDcSessionHandle cpaSess;
+    /* static Huffman twin of cpaSess for QZ_AUTO_HDR sessions */
+    CpaDcSessionHandle cpaSessStatic;
 } QzInstance_T;
 
 typedef struct QzInstanceList_S {
@@ -153,6 +196,27 @@ typedef enum {
     DeflateInited
 } DeflateState_T;
 
+/* what findStdGzipMembers checks before splitting at a member signature */
+typedef enum {
+    GzipScanSig = 0,    /* nothing more */
+    GzipScanCheap,      /* header fields and the ISIZE of the footer before */
+    GzipScanInflate     /* also a trial inflate of the first deflate block */
+} GzipScan_T;
+
+/* where a gzip-ext member starts, in compressed and original bytes */
+typedef struct QzMemberIdx_S {
+    uint64_t comp_off;
+    uint64_t orig_off;
+} QzMemberIdx_T;
+
+/* a member index found at the end of an archive */
+typedef struct QzMemberIndex_S {
+    const unsigned char *region;
+    unsigned long cnt;
+    uint64_t comp_total;
+    uint64_t orig_total;
+} QzMemberIndex_T;
+
 typedef struct QzSess_S {
     int inst_hint;   /*which instance we last used*/
     QzSessionParams_T sess_params;
@@ -183,12 +247,45 @@ typedef struct QzSess_S {
     unsigned long qz_in_len;
     unsigned long qz_out_len;
     unsigned long *crc32;
+    QzCrcType_T crc_type;   /* what *crc32 accumulates */
     unsigned int last;
     unsigned int single_thread;
     unsigned int polling_idx;
 
     z_stream *deflate_strm;
     DeflateState_T deflate_stat;
+
+    /* QZ_DEFLATE_ZLIB stream spanning calls until last */
+    unsigned int zlib_started;
+    unsigned long zlib_adler;
+
+    /* see sess_params.entropy_thrshold */
+    unsigned long chunks_sampled;
+    unsigned long chunks_stored;
+    unsigned long chunks_static_hdr;
+    unsigned long chunks_dynamic_hdr;
+    unsigned long chunks_uniform;
+    QzRunEnc_T run_enc[QZ_RUN_CACHE_CNT];
+    unsigned int run_enc_next;
+
+    /* preset dictionary, see qzSetDictionary */
+    unsigned char *dict;
+    unsigned int dict_len;
+    uint32_t dict_id;
+
+    /* members written so far, see sess_params.member_index */
+    QzMemberIdx_T *mbr_idx;
+    unsigned long mbr_idx_cnt;
+    unsigned long mbr_idx_cap;
+    uint64_t mbr_comp_off;
+    uint64_t mbr_orig_off;
+    unsigned int mbr_idx_closed;
+
+    /* std gzip member footers found ahead of doDecompressIn */
+    unsigned char *gz_footer[QZ_GZIP_MEMBER_BATCH];
+    unsigned char *gz_first;
+    int gz_footer_cnt;
+    int gz_footer_idx;
 } QzSess_T;
 
 typedef struct QzStreamBuf_S {
@@ -196,6 +293,14 @@ typedef struct QzStreamBuf_S {
     unsigned char *in_buf;
     unsigned char *out_buf;
     unsigned int out_offset;
+    unsigned int in_offset;
+    /* in_buf is a mirrored ring of ring_len bytes, 0 if linear */
+    size_t ring_len;
+    /* pinned for the engine or no ring could be mapped, stay linear */
+    unsigned int keep_linear;
+    struct timespec pending_since;
+    /* stream checksum taken while staging, set when compressing in sw */
+    unsigned int sw_csum;
 } QzStreamBuf_T;
 
 typedef struct ThreadData_S {
@@ -232,11 +337,39 @@ typedef struct QzGzH_S {
     QzExtraField_T extra;
 } QzGzH_T;
 
+/* a 'QD' subfield after 'QZ' names the dictionary a member needs */
+typedef struct QzDictField_S {
+    unsigned char st1;
+    unsigned char st2;
+    uint16_t x2_len;
+    uint32_t dict_id;
+} QzDictField_T;
+
+typedef struct QzGzDictH_S {
+    StdGzH_T std_hdr;
+    uint16_t x_len;
+    QzExtraField_T extra;
+    QzDictField_T dict;
+} QzGzDictH_T;
+
 typedef struct StdGzF_S {
     uint32_t crc32;
     uint32_t i_size;
 } StdGzF_T;
 
+typedef struct QzDeflate4BH_S {
+    uint32_t blk_size;
+} QzDeflate4BH_T;
+
+typedef struct BgzfH_S {
+    StdGzH_T std_hdr;
+    uint16_t x_len;
+    unsigned char si1;
+    unsigned char si2;
+    uint16_t s_len;
+    uint16_t bsize;   /* block size - 1 */
+} BgzfH_T;
+
 typedef struct QzMem_S {
     int flag;
     unsigned char *addr;
@@ -262,6 +395,30 @@ void outputFooterGen(QzSess_T *qz_sess,
                      CpaDcRqResults *res,
                      QzDataFormat_T data_fmt);
 void qzGzipFooterExt(const unsigned char *const ptr, StdGzF_T *ftr);
+void qz4BHeaderGen(unsigned char *ptr, CpaDcRqResults *res);
+unsigned int qz4BHeaderExt(const unsigned char *const ptr);
+unsigned long zlibHeaderSz(const QzSess_T *qz_sess);
+unsigned long zlibFooterSz(void);
+void zlibHeaderGen(unsigned char *ptr, const QzSess_T *qz_sess);
+void zlibFooterGen(unsigned char *ptr, unsigned long adler);
+int qzMemberIndexReserve(QzSess_T *qz_sess, unsigned long cnt);
+void qzMemberIndexAdd(QzSess_T *qz_sess, unsigned long comp_sz,
+                      unsigned long orig_sz);
+unsigned long qzMemberIndexSz(unsigned long cnt);
+unsigned long qzMemberIndexGen(QzSess_T *qz_sess, unsigned char *ptr);
+int qzMemberIndexExt(const unsigned char *src, unsigned long src_len,
+                     QzMemberIndex_T *idx);
+void qzMemberIndexEntry(const QzMemberIndex_T *idx, unsigned long k,
+                        QzMemberIdx_T *ent);
+int isMemberIndex(const unsigned char *src, long src_len);
+void qzGzipDictHeaderGen(unsigned char *ptr, CpaDcRqResults *res,
+                         uint32_t dict_id);
+int qzGzipDictHeaderExt(const unsigned char *const ptr, long src_len,
+                        QzGzH_T *hdr, uint32_t *dict_id);
+void bgzfHeaderGen(unsigned char *ptr, CpaDcRqResults *res);
+long bgzfBlockSz(const unsigned char *const ptr, long src_len);
+unsigned long bgzfEofSz(void);
+void bgzfEofGen(unsigned char *ptr);
 
 int isQATProcessable(const unsigned char *ptr,
                      const unsigned int *const src_len,
@@ -281,6 +438,19 @@ int qzSWDecompressMultiGzip(QzSession_T *sess, const unsigned char *src,
 
 int qz_sessParamsCheck(QzSessionParams_T *params);
 
+unsigned int sampleChunk(QzSess_T *qz_sess, const unsigned char *src,
+                         unsigned int len);
+
+int isIncompressible(QzSess_T *qz_sess, unsigned int entropy);
+
+QzHuffmanHdr_T chooseHuffmanHdr(QzSess_T *qz_sess, unsigned int entropy,
+                                unsigned int len);
+
+const QzRunEnc_T *qzUniformChunk(QzSess_T *qz_sess, const unsigned char *src,
+                                 unsigned int len, int final);
+
+void qzRunCacheFree(QzSess_T *qz_sess);
+
 unsigned char getSwBackup(QzSession_T *sess);
 
 #ifdef ADF_PCI_API
@@ -291,8 +461,33 @@ int initStream(QzSession_T *sess, QzStream_T *strm);
 
 void *qzMemSet(void *ptr, unsigned char filler, unsigned int count);
 
+unsigned char *qzRingAlloc(size_t *sz);
+
+void qzRingFree(unsigned char *ring, size_t sz);
+
+unsigned long qzCrc32(unsigned long crc, const unsigned char *buf,
+                      size_t len);
+
+unsigned long qzCrc32Combine(unsigned long crc1, unsigned long crc2,
+                             size_t len2);
+
+unsigned long qzCopyCrc32(unsigned char *dst, const unsigned char *src,
+                          size_t len, unsigned long crc);
+
+unsigned long qzCopyAdler32(unsigned char *dst, const unsigned char *src,
+                            size_t len, unsigned long adler);
+
+unsigned long qzAdler32(unsigned long adler, const unsigned char *buf,
+                        size_t len);
+
 unsigned char *findStdGzipFooter(const unsigned char *src_ptr,
-                                 long src_avail_len);
+                                 long src_avail_len, GzipScan_T level);
+
+int findStdGzipMembers(const unsigned char *src_ptr, long src_avail_len,
+                       unsigned char **footers, int max_cnt, GzipScan_T level);
+int qzGzipMembersSz(const unsigned char *src, unsigned long src_len,
+                    unsigned long *orig_sz, unsigned long *mbr_cnt,
+                    GzipScan_T level);
 
 void streamBufferCleanup();
 #endif //_QATZIPP_H
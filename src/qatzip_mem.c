@@ -32,7 +32,13 @@
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  ***************************************************************************/
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -211,3 +217,53 @@ void qzFree(void *m)
 
     m = NULL;
 }
+
+/*
+ * Allocate a ring of *sz bytes, rounded up to the page size, that is mapped
+ * twice back to back. Any window of up to *sz bytes starting inside the
+ * ring is then contiguous, so the ring never has to be linearized.
+ */
+unsigned char *qzRingAlloc(size_t *sz)
+{
+    int fd;
+    size_t page_sz = (size_t)sysconf(_SC_PAGESIZE);
+    size_t ring_sz = (*sz + page_sz - 1) & ~(page_sz - 1);
+    unsigned char *base = NULL;
+
+    fd = memfd_create("qz_ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (0 != ftruncate(fd, ring_sz)) {
+        goto done;
+    }
+
+    base = mmap(NULL, 2 * ring_sz, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == base) {
+        base = NULL;
+        goto done;
+    }
+
+    if (MAP_FAILED == mmap(base, ring_sz, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_FIXED, fd, 0) ||
+        MAP_FAILED == mmap(base + ring_sz, ring_sz, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_FIXED, fd, 0)) {
+        munmap(base, 2 * ring_sz);
+        base = NULL;
+        goto done;
+    }
+    *sz = ring_sz;
+
+done:
+    close(fd);
+    return base;
+}
+
+void qzRingFree(unsigned char *ring, size_t sz)
+{
+    if (NULL != ring) {
+        munmap(ring, 2 * sz);
+    }
+}
@@ -0,0 +1,246 @@
+/***************************************************************************
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2007-2021 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cpa.h"
+#include "cpa_dc.h"
+#include "qatzip.h"
+#include "qatzip_internal.h"
+#include "qz_utils.h"
+
+/* RFC 1951 fixed Huffman codes */
+#define FIXED_EOB               256
+#define FIXED_MAX_MATCH         258
+#define FIXED_MIN_MATCH         3
+
+/* Base length and extra bits of length symbols 257..285 */
+static const unsigned short g_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char g_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+typedef struct BitWriter_S {
+    unsigned char *out;
+    unsigned int pos;
+    uint64_t bits;
+    unsigned int cnt;
+} BitWriter_T;
+
+static void putBits(BitWriter_T *bw, unsigned int val, unsigned int n)
+{
+    bw->bits |= (uint64_t)val << bw->cnt;
+    bw->cnt += n;
+    while (bw->cnt >= 8) {
+        bw->out[bw->pos++] = (unsigned char)bw->bits;
+        bw->bits >>= 8;
+        bw->cnt -= 8;
+    }
+}
+
+static void alignBits(BitWriter_T *bw)
+{
+    if (bw->cnt) {
+        putBits(bw, 0, 8 - bw->cnt);
+    }
+}
+
+/* Huffman codes go out from their most significant bit */
+static void putCode(BitWriter_T *bw, unsigned int code, unsigned int n)
+{
+    unsigned int rev = 0, k;
+
+    for (k = 0; k < n; k++) {
+        rev = (rev << 1) | ((code >> k) & 1);
+    }
+    putBits(bw, rev, n);
+}
+
+static void putSymbol(BitWriter_T *bw, unsigned int sym)
+{
+    if (sym < 144) {
+        putCode(bw, 0x30 + sym, 8);
+    } else if (sym < 256) {
+        putCode(bw, 0x190 + sym - 144, 9);
+    } else if (sym < 280) {
+        putCode(bw, sym - 256, 7);
+    } else {
+        putCode(bw, 0xc0 + sym - 280, 8);
+    }
+}
+
+/* A match of len at distance 1, distance code 0 has no extra bits */
+static void putMatch(BitWriter_T *bw, unsigned int len)
+{
+    int k = 28;
+
+    while (g_len_base[k] > len) {
+        k--;
+    }
+    putSymbol(bw, 257 + k);
+    putBits(bw, len - g_len_base[k], g_len_extra[k]);
+    putCode(bw, 0, 5);
+}
+
+/*
+ * One fixed Huffman block: the byte, then matches of the byte before.
+ * Unless final, an empty stored block ends it on a byte boundary as a
+ * full flush would, so the next chunk's blocks can follow.
+ */
+static unsigned int runEncode(unsigned char *out, unsigned char byte,
+                              unsigned int len, int final)
+{
+    BitWriter_T bw = {out, 0, 0, 0};
+    unsigned int left = len - 1;
+
+    putBits(&bw, final ? 1 : 0, 1);
+    putBits(&bw, 1, 2);
+    putSymbol(&bw, byte);
+    while (left >= FIXED_MAX_MATCH) {
+        putMatch(&bw, FIXED_MAX_MATCH);
+        left -= FIXED_MAX_MATCH;
+    }
+    if (left >= FIXED_MIN_MATCH) {
+        putMatch(&bw, left);
+    } else {
+        while (left--) {
+            putSymbol(&bw, byte);
+        }
+    }
+    putSymbol(&bw, FIXED_EOB);
+
+    if (!final) {
+        putBits(&bw, 0, 3);
+        alignBits(&bw);
+        putBits(&bw, 0, 16);
+        putBits(&bw, 0xffff, 16);
+    }
+    alignBits(&bw);
+    return bw.pos;
+}
+
+static int isUniform(const unsigned char *buf, unsigned int len)
+{
+#if defined(__x86_64__)
+    /* SSE2 is part of x86-64, 64 bytes per step */
+    __m128i v = _mm_set1_epi8((char)buf[0]);
+    __m128i a, b, c, d;
+    unsigned int i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + i)), v);
+        b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + i + 16)), v);
+        c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + i + 32)), v);
+        d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + i + 48)), v);
+        a = _mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d));
+        if (0xffff != _mm_movemask_epi8(a)) {
+            return 0;
+        }
+    }
+    for (; i < len; i++) {
+        if (buf[i] != buf[0]) {
+            return 0;
+        }
+    }
+    return 1;
+#else
+    return 0 == memcmp(buf, buf + 1, len - 1);
+#endif
+}
+
+/*
+ * Returns the cached encoding of src when it is a run of one byte value,
+ * NULL otherwise. The encoding is built on first use along with the
+ * checksums of the run.
+ */
+const QzRunEnc_T *qzUniformChunk(QzSess_T *qz_sess, const unsigned char *src,
+                                 unsigned int len, int final)
+{
+    QzRunEnc_T *run;
+    unsigned char *enc;
+    unsigned int k;
+
+    if (len < QZ_RUN_MIN_SZ || !isUniform(src, len)) {
+        return NULL;
+    }
+
+    for (k = 0; k < QZ_RUN_CACHE_CNT; k++) {
+        run = &qz_sess->run_enc[k];
+        if (NULL != run->enc && run->len == len && run->byte == src[0] &&
+            run->final == !!final) {
+            qz_sess->chunks_uniform++;
+            return run;
+        }
+    }
+
+    /* 13 bits per longest match, header, EOB and flush marker */
+    enc = malloc(len / FIXED_MAX_MATCH * 2 + 16);
+    if (NULL == enc) {
+        return NULL;
+    }
+    run = &qz_sess->run_enc[qz_sess->run_enc_next];
+    qz_sess->run_enc_next = (qz_sess->run_enc_next + 1) % QZ_RUN_CACHE_CNT;
+    free(run->enc);
+    run->enc = enc;
+    run->len = len;
+    run->byte = src[0];
+    run->final = !!final;
+    run->enc_len = runEncode(enc, src[0], len, final);
+    run->crc32 = qzCrc32(0, src, len);
+    run->adler = qzAdler32(1, src, len);
+
+    qz_sess->chunks_uniform++;
+    return run;
+}
+
+void qzRunCacheFree(QzSess_T *qz_sess)
+{
+    unsigned int k;
+
+    for (k = 0; k < QZ_RUN_CACHE_CNT; k++) {
+        free(qz_sess->run_enc[k].enc);
+        qz_sess->run_enc[k].enc = NULL;
+    }
+}
@@ -40,10 +40,13 @@
 #include "qae_mem.h"
 
 #include <stdlib.h>
+#include <time.h>
 #include <qatzip.h>
 #include <qz_utils.h>
 #include <qatzip_internal.h>
 
+extern processData_T g_process;
+
 #define STREAM_BUFF_LIST_SZ 8
 
 typedef struct StreamBuffNode_S {
@@ -264,6 +267,14 @@ int initStream(QzSession_T *sess, QzStream_T *strm)
     }
 
     stream_buf->out_offset = 0;
+    stream_buf->in_offset = 0;
+    stream_buf->ring_len = 0;
+    stream_buf->keep_linear = 0;
+    stream_buf->pending_since.tv_sec = 0;
+    stream_buf->pending_since.tv_nsec = 0;
+    /* with hardware the engine produces the checksum, keep it there */
+    stream_buf->sw_csum = (QZ_NO_HW == g_process.qz_init_status ||
+                           QZ_NO_HW == sess->hw_session_stat);
     stream_buf->buf_len = qz_sess->sess_params.strm_buff_sz;
     stream_buf->in_buf =
         streamBufferAlloc(stream_buf->buf_len, NODE_0, PINNED_MEM);
@@ -289,7 +300,7 @@ int initStream(QzSession_T *sess, QzStream_T *strm)
 
     strm->pending_in = 0;
     strm->pending_out = 0;
-    strm->crc_32 = 0;
+    strm->crc_32 = (QZ_ADLER == strm->crc_type) ? 1 : 0;
     return QZ_OK;
 
 clear:
@@ -310,17 +321,90 @@ clear:
     return QZ_FAIL;
 }
 
-static unsigned int copyStreamInput(QzStream_T *strm, unsigned char *in)
+/* Contiguous room left behind the pending input */
+static unsigned int streamInputSpace(QzStream_T *strm)
+{
+    QzStreamBuf_T *stream_buf = strm->opaque;
+
+    if (0 != stream_buf->ring_len) {
+        return stream_buf->buf_len - strm->pending_in;
+    }
+    return stream_buf->buf_len - stream_buf->in_offset - strm->pending_in;
+}
+
+/* Drop cnt bytes from the head of the pending input, nothing is moved */
+static void consumeStreamInput(QzStream_T *strm, unsigned int cnt)
+{
+    QzStreamBuf_T *stream_buf = strm->opaque;
+
+    strm->pending_in -= cnt;
+    stream_buf->in_offset += cnt;
+    if (0 != stream_buf->ring_len &&
+        stream_buf->in_offset >= stream_buf->ring_len) {
+        stream_buf->in_offset -= stream_buf->ring_len;
+    }
+    if (0 == strm->pending_in) {
+        stream_buf->in_offset = 0;
+    }
+}
+
+/*
+ * Decompression consumes the input member by member and usually leaves
+ * a partial member behind, so its input is kept in a mirrored ring where
+ * the leftover and the next input are always contiguous. The engine reads
+ * pinned input in place and the ring is not pinned, so with hardware the
+ * pinned linear buffer stays and is only compacted once its tail is full.
+ */
+static void useStreamInputRing(QzStreamBuf_T *stream_buf)
+{
+    size_t ring_len = stream_buf->buf_len;
+    unsigned char *ring;
+
+    /* sw_csum is set exactly when no engine serves the stream */
+    if (!stream_buf->sw_csum && qzMemFindAddr(stream_buf->in_buf)) {
+        stream_buf->keep_linear = 1;
+        return;
+    }
+
+    ring = qzRingAlloc(&ring_len);
+    if (NULL == ring) {
+        QZ_DEBUG("stream_buf->in_buf : ring failed, keep linear buffer\n");
+        stream_buf->keep_linear = 1;
+        return;
+    }
+
+    streamBufferFree(stream_buf->in_buf);
+    stream_buf->in_buf = ring;
+    stream_buf->ring_len = ring_len;
+    stream_buf->in_offset = 0;
+}
+
+/*
+ * Stage user input behind the pending input. With csum set, the stream
+ * checksum is updated by the same pass that copies the bytes.
+ */
+static unsigned int copyStreamInput(QzStream_T *strm, unsigned char *in,
+                                    unsigned int csum)
 {
     unsigned int cpy_cnt = 0;
     unsigned int avail_in = 0;
     QzStreamBuf_T *stream_buf = strm->opaque;
+    unsigned char *tail = stream_buf->in_buf + stream_buf->in_offset +
+                          strm->pending_in;
 
-    avail_in = stream_buf->buf_len - strm->pending_in;
+    avail_in = streamInputSpace(strm);
     cpy_cnt = (strm->in_sz > avail_in) ? avail_in : strm->in_sz;
-    QZ_MEMCPY(stream_buf->in_buf + strm->pending_in, in, cpy_cnt, cpy_cnt);
-    QZ_DEBUG("Copy to input from %p, to %p, count %u\n",
-             in, stream_buf->in_buf + strm->pending_in, cpy_cnt);
+    if (0 == strm->pending_in && cpy_cnt > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &stream_buf->pending_since);
+    }
+    if (csum && QZ_CRC32 == strm->crc_type) {
+        strm->crc_32 = qzCopyCrc32(tail, in, cpy_cnt, strm->crc_32);
+    } else if (csum && QZ_ADLER == strm->crc_type) {
+        strm->crc_32 = qzCopyAdler32(tail, in, cpy_cnt, strm->crc_32);
+    } else {
+        QZ_MEMCPY(tail, in, cpy_cnt, cpy_cnt);
+    }
+    QZ_DEBUG("Copy to input from %p, to %p, count %u\n", in, tail, cpy_cnt);
 
     strm->pending_in += cpy_cnt;
     strm->in_sz -= cpy_cnt;
@@ -349,26 +433,45 @@ static unsigned int copyStreamOutput(QzStream_T *strm, unsigned char *out)
     return cpy_cnt;
 }
 
+/* Check if the oldest pending input has waited longer than timeout (us) */
+static int isFlushDeadlineReached(QzStream_T *strm, unsigned int timeout)
+{
+    struct timespec now;
+    long long waited;
+    QzStreamBuf_T *stream_buf = strm->opaque;
+
+    if (0 == timeout || 0 == strm->pending_in) {
+        return 0;
+    }
+
+    /* monotonic, a wall clock step must not flush early or never */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    waited = (now.tv_sec - stream_buf->pending_since.tv_sec) * 1000000LL +
+             (now.tv_nsec - stream_buf->pending_since.tv_nsec) / 1000;
+    return (waited >= (long long)timeout) ? 1 : 0;
+}
+
 
 int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
 {
     int rc = QZ_FAIL;
-    unsigned long *strm_crc = NULL;
+    unsigned long strm_crc = 0;
+    unsigned long *crc = NULL;
     unsigned int input_len = 0;
     unsigned int output_len = 0;
     unsigned int copied_output = 0;
     unsigned int copied_input = 0;
     unsigned int copied_input_last = 0;
-    unsigned int consumed = 0;
     unsigned int produced = 0;
     unsigned int strm_last = 0;
+    unsigned int flush = 0;
     QzStreamBuf_T *stream_buf = NULL;
     QzSess_T *qz_sess = NULL;
     QzDataFormat_T data_fmt = QZ_DEFLATE_GZIP_EXT;
 
     if (NULL == sess     || \
         NULL == strm     || \
-        (last != 0 && last != 1)) {
+        (last != QZ_NO_FLUSH && last != QZ_FINISH && last != QZ_SYNC_FLUSH)) {
         rc = QZ_PARAMS;
         if (NULL != strm) {
             strm->in_sz = 0;
@@ -405,14 +508,6 @@ int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
         strm->out_sz = 0;
         goto end;
     }
-    switch (strm->crc_type) {
-    case QZ_CRC32:
-    case QZ_ADLER:
-    default:
-        strm_crc = (unsigned long *)&strm->crc_32;
-        break;
-    }
-
     /*check if setupSession called*/
     if (NULL == sess->internal || QZ_NONE == sess->hw_session_stat) {
         rc = qzSetupSession(sess, NULL);
@@ -425,6 +520,9 @@ int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
     qz_sess = (QzSess_T *)(sess->internal);
     data_fmt = qz_sess->sess_params.data_fmt;
     if (data_fmt != QZ_DEFLATE_RAW &&
+        data_fmt != QZ_DEFLATE_4B &&
+        data_fmt != QZ_DEFLATE_ZLIB &&
+        data_fmt != QZ_DEFLATE_BGZF &&
         data_fmt != QZ_DEFLATE_GZIP_EXT) {
         QZ_ERROR("Invalid data format: %d\n", data_fmt);
         strm->in_sz = 0;
@@ -433,6 +531,9 @@ int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
     }
 
     stream_buf = (QzStreamBuf_T *) strm->opaque;
+    flush = (QZ_SYNC_FLUSH == last ||
+             isFlushDeadlineReached(strm,
+                                    qz_sess->sess_params.strm_flush_timeout));
     while (strm->pending_out > 0) {
         copied_output = copyStreamOutput(strm, strm->out + produced);
         produced += copied_output;
@@ -447,10 +548,12 @@ int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
 
     while (0 == strm->pending_out) {
         copied_input_last = copied_input;
-        copied_input += copyStreamInput(strm, strm->in + consumed);
+        copied_input += copyStreamInput(strm, strm->in + copied_input,
+                                        stream_buf->sw_csum);
 
-        if (strm->pending_in < stream_buf->buf_len &&
-            last != 1) {
+        if (streamInputSpace(strm) > 0 &&
+            last != QZ_FINISH &&
+            (0 == flush || 0 == strm->pending_in)) {
             rc = QZ_OK;
             goto done;
         }
@@ -458,20 +561,32 @@ int qzCompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
         input_len = strm->pending_in;
         output_len = stream_buf->buf_len;
 
-        strm_last = (0 == strm->in_sz && last) ? 1 : 0;
+        strm_last = (0 == strm->in_sz && QZ_FINISH == last) ? 1 : 0;
         QZ_DEBUG("Before Call qzCompressCrc input_len %u output_len %u "
                  "stream->pending_in %u stream->pending_out %u "
                  "stream->in_sz %d stream->out_sz %d\n",
                  input_len, output_len, strm->pending_in, strm->pending_out,
                  strm->in_sz, strm->out_sz);
 
-        rc = qzCompressCrc(sess, stream_buf->in_buf, &input_len,
-                           stream_buf->out_buf, &output_len, strm_last, strm_crc);
+        /* in sw the checksum was taken while the input was staged */
+        strm_crc = strm->crc_32;
+        crc = stream_buf->sw_csum ? NULL : &strm_crc;
+        if (QZ_ADLER == strm->crc_type) {
+            rc = qzCompressAdler(sess, stream_buf->in_buf +
+                                 stream_buf->in_offset, &input_len,
+                                 stream_buf->out_buf, &output_len,
+                                 strm_last, crc);
+        } else {
+            rc = qzCompressCrc(sess, stream_buf->in_buf + stream_buf->in_offset,
+                               &input_len, stream_buf->out_buf, &output_len,
+                               strm_last, crc);
+        }
+        strm->crc_32 = (unsigned int)strm_crc;
 
-        strm->pending_in = 0;
+        consumeStreamInput(strm, (QZ_OK == rc || QZ_BUF_ERROR == rc) ?
+                           input_len : strm->pending_in);
         strm->pending_out = output_len;
         copied_output = copyStreamOutput(strm, strm->out + produced);
-        consumed += input_len;
         produced += copied_output;
 
         QZ_DEBUG("After Call qzCompressCrc input_len %u output_len %u "
@@ -518,6 +633,57 @@ end:
 }
 
 
+/*
+ * Whether a QZ_DATA_ERROR of qzDecompress only means the input ends inside
+ * the member at src, judged from the sizes in its header. A header written
+ * before the sizes were known can not tell, so such a member is waited for.
+ */
+static int isMemberTruncated(QzSess_T *qz_sess, const unsigned char *src,
+                             long len)
+{
+    QzGzH_T hdr;
+    uint32_t dict_id;
+    long mbr_sz;
+    QzDataFormat_T data_fmt = qz_sess->sess_params.data_fmt;
+
+    if (len < (long)outputHeaderSz(data_fmt)) {
+        return 1;
+    }
+
+    switch (data_fmt) {
+    case QZ_DEFLATE_4B:
+        mbr_sz = sizeof(QzDeflate4BH_T) + (long)qz4BHeaderExt(src);
+        break;
+    case QZ_DEFLATE_BGZF:
+        mbr_sz = bgzfBlockSz(src, len);
+        if (mbr_sz < (long)(sizeof(BgzfH_T) + stdGzipFooterSz())) {
+            return 0;
+        }
+        break;
+    case QZ_DEFLATE_GZIP_EXT:
+        if (QZ_OK == qzGzipDictHeaderExt(src, len, &hdr, &dict_id)) {
+            mbr_sz = sizeof(QzGzDictH_T) + (long)hdr.extra.qz_e.dest_sz +
+                     stdGzipFooterSz();
+        } else if (QZ_OK == qzGzipHeaderExt(src, &hdr)) {
+            if (0 == hdr.extra.qz_e.dest_sz) {
+                return 1;
+            }
+            mbr_sz = qzGzipHeaderSz() + (long)hdr.extra.qz_e.dest_sz +
+                     stdGzipFooterSz();
+        } else {
+            /* a plain gzip member or a member index carries no sizes */
+            return (0x1f == src[0] && 0x8b == src[1]);
+        }
+        break;
+    default:
+        /* raw, zlib and gzip streams carry no sizes in their header */
+        return 1;
+    }
+
+    return mbr_sz > len;
+}
+
+
 int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
 {
     int rc = QZ_FAIL;
@@ -526,10 +692,9 @@ int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
     unsigned int copied_output = 0;
     unsigned int copied_input = 0;
     unsigned int copied_input_last = 0;
-    unsigned int consumed = 0;
     unsigned int produced = 0;
     unsigned int copy_more = 1;
-    unsigned int inbuf_offset = 0;
+    unsigned int need_more = 0;
     QzStreamBuf_T *stream_buf = NULL;
 
     if (NULL == sess     || \
@@ -567,6 +732,10 @@ int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
     }
 
     stream_buf = (QzStreamBuf_T *) strm->opaque;
+    if (0 == stream_buf->ring_len && 0 == stream_buf->keep_linear &&
+        0 == strm->pending_in) {
+        useStreamInputRing(stream_buf);
+    }
     QZ_DEBUG("Decompress Stream Start...\n");
 
     while (strm->pending_out > 0) {
@@ -584,9 +753,17 @@ int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
 
         if (1 == copy_more) {
             copied_input_last = copied_input;
-            copied_input += copyStreamInput(strm, strm->in + consumed);
+            if (0 == stream_buf->ring_len && 0 == streamInputSpace(strm) &&
+                0 != stream_buf->in_offset) {
+                /* linear fallback only, a ring never needs this */
+                memmove(stream_buf->in_buf,
+                        stream_buf->in_buf + stream_buf->in_offset,
+                        strm->pending_in);
+                stream_buf->in_offset = 0;
+            }
+            copied_input += copyStreamInput(strm, strm->in + copied_input, 0);
 
-            if (strm->pending_in < stream_buf->buf_len &&
+            if (streamInputSpace(strm) > 0 &&
                 last != 1) {
                 rc = QZ_OK;
                 QZ_DEBUG("Batch more input data...\n");
@@ -604,18 +781,25 @@ int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
                  "stream->in_sz %d stream->out_sz %d\n",
                  input_len, output_len, strm->pending_in, strm->pending_out,
                  strm->in_sz, strm->out_sz);
-        rc = qzDecompress(sess, stream_buf->in_buf + inbuf_offset, &input_len,
-                          stream_buf->out_buf, &output_len);
+        rc = qzDecompress(sess, stream_buf->in_buf + stream_buf->in_offset,
+                          &input_len, stream_buf->out_buf, &output_len);
 
         QZ_DEBUG("Return code = %d\n", rc);
+        need_more = 0;
+        if (QZ_DATA_ERROR == rc && (0 != strm->in_sz || 1 != last) &&
+            isMemberTruncated((QzSess_T *)sess->internal,
+                              stream_buf->in_buf + stream_buf->in_offset +
+                              input_len, strm->pending_in - input_len)) {
+            /* The last member is incomplete, wait for the rest of it */
+            need_more = 1;
+            rc = QZ_OK;
+        }
         if (QZ_OK != rc && QZ_BUF_ERROR != rc) {
             copied_input = copied_input_last;
             goto done;
         }
 
-        inbuf_offset += input_len;
-        consumed += input_len;
-        strm->pending_in -= input_len;
+        consumeStreamInput(strm, input_len);
         strm->pending_out = output_len;
         copied_output = copyStreamOutput(strm, strm->out + produced);
         produced += copied_output;
@@ -639,9 +823,17 @@ int qzDecompressStream(QzSession_T *sess, QzStream_T *strm, unsigned int last)
             }
         }
 
+        if (1 == need_more) {
+            if (0 == input_len && strm->pending_in == stream_buf->buf_len) {
+                QZ_ERROR("Error in qzDecompressStream, member is larger "
+                         "than stream buf size = %u\n", stream_buf->buf_len);
+                rc = QZ_FAIL;
+                goto done;
+            }
+            copy_more = 1;
+        }
         if (0 == strm->pending_in) {
             copy_more = 1;
-            inbuf_offset = 0;
         }
         if (0 == strm->pending_in && 0 == strm->in_sz) {
             rc = QZ_OK;
@@ -681,7 +873,11 @@ int qzEndStream(QzSession_T *sess, QzStream_T *strm)
 
     stream_buf = (QzStreamBuf_T *)strm->opaque;
     streamBufferFree(stream_buf->out_buf);
-    streamBufferFree(stream_buf->in_buf);
+    if (0 != stream_buf->ring_len) {
+        qzRingFree(stream_buf->in_buf, stream_buf->ring_len);
+    } else {
+        streamBufferFree(stream_buf->in_buf);
+    }
     free(stream_buf);
     strm->opaque = NULL;
     rc = QZ_OK;
@@ -89,6 +89,17 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
     int comp_level = Z_DEFAULT_COMPRESSION;
     QzDataFormat_T data_fmt = QZ_DATA_FORMAT_DEFAULT;
     unsigned int chunk_sz = QZ_HW_BUFF_SZ;
+    unsigned int hdr_sz = 0;
+    unsigned int ftr_sz = 0;
+    int per_chunk;
+    int mbr_started;
+    int gz_wrap;
+    unsigned long mbr_crc = 0;
+    int dict_mbr;
+    int stored, fixed;
+    unsigned int entropy;
+    const QzRunEnc_T *run;
+    CpaDcRqResults res = {0};
 
     *src_len = 0;
     *dest_len = 0;
@@ -106,8 +117,17 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
     comp_level = (qz_sess->sess_params.comp_lvl == Z_BEST_COMPRESSION) ? \
                  Z_BEST_COMPRESSION : Z_DEFAULT_COMPRESSION;
     data_fmt = qz_sess->sess_params.data_fmt;
-    chunk_sz = qz_sess->sess_params.hw_buff_sz;
+    chunk_sz = CHUNK_SZ(qz_sess);
+    /* zlib has no dictionary with its gzip wrapper, such members are
+     * framed here one per chunk, with sizes and dictionary ID known */
+    dict_mbr = (QZ_DEFLATE_GZIP_EXT == data_fmt && NULL != qz_sess->dict);
+    per_chunk = (QZ_DEFLATE_4B == data_fmt || QZ_DEFLATE_BGZF == data_fmt ||
+                 dict_mbr);
     stream = qz_sess->deflate_strm;
+    mbr_started = (DeflateNull == qz_sess->deflate_stat);
+    /* zlib's gzip wrapper keeps the crc32 of the member in stream->adler */
+    gz_wrap = ((QZ_DEFLATE_GZIP == data_fmt ||
+                QZ_DEFLATE_GZIP_EXT == data_fmt) && !dict_mbr);
 
     if (DeflateNull == qz_sess->deflate_stat) {
         if (NULL == stream) {
@@ -125,14 +145,18 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
         stream->total_in = 0;
         stream->total_out = 0;
 
+        /* zlib framing is added by the caller around the whole stream */
         switch (data_fmt) {
+        case QZ_DEFLATE_4B:
         case QZ_DEFLATE_RAW:
+        case QZ_DEFLATE_ZLIB:
+        case QZ_DEFLATE_BGZF:
             windows_bits = -MAX_WBITS;
             break;
         case QZ_DEFLATE_GZIP:
         case QZ_DEFLATE_GZIP_EXT:
         default:
-            windows_bits = MAX_WBITS + GZIP_WRAPPER;
+            windows_bits = dict_mbr ? -MAX_WBITS : MAX_WBITS + GZIP_WRAPPER;
             break;
         }
 
@@ -148,7 +172,15 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
         }
         qz_sess->deflate_stat = DeflateInited;
 
-        if (QZ_DEFLATE_GZIP_EXT == data_fmt) {
+        if (NULL != qz_sess->dict &&
+            Z_OK != deflateSetDictionary(stream, qz_sess->dict,
+                                         qz_sess->dict_len)) {
+            deflateEnd(stream);
+            qz_sess->deflate_stat = DeflateNull;
+            return QZ_FAIL;
+        }
+
+        if (QZ_DEFLATE_GZIP_EXT == data_fmt && !dict_mbr) {
             gen_qatzip_hdr(&hdr);
             if (Z_OK != deflateSetHeader(stream, &hdr)) {
                 qz_sess->deflate_stat = DeflateNull;
@@ -167,34 +199,116 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
         send_sz = left_input_sz > chunk_sz ? chunk_sz : left_input_sz;
         left_input_sz -= send_sz;
 
-        if (0 == left_input_sz && 1 == last) {
+        /* 4B and BGZF blocks are complete deflate streams in their frame */
+        if ((0 == left_input_sz && 1 == last) || per_chunk) {
             flush_flag = Z_FINISH;
         } else {
             flush_flag = Z_FULL_FLUSH;
         }
 
-        stream->next_in   = (z_const Bytef *)src + total_in;
-        stream->avail_in  = send_sz;
-        stream->next_out  = (Bytef *)dest + total_out;
-        stream->avail_out = left_output_sz;
-
-        last_loop_in = GET_LOWER_32BITS(stream->total_in);
-        last_loop_out = GET_LOWER_32BITS(stream->total_out);
+        hdr_sz = dict_mbr ? sizeof(QzGzDictH_T) :
+                 per_chunk ? outputHeaderSz(data_fmt) : 0;
+        ftr_sz = (QZ_DEFLATE_BGZF == data_fmt || dict_mbr) ?
+                 outputFooterSz(data_fmt) : 0;
+        if (left_output_sz < hdr_sz + ftr_sz) {
+            QZ_ERROR("ERR: no room for the block header\n");
+            return QZ_BUF_ERROR;
+        }
 
+        stream->next_out  = (Bytef *)dest + total_out + hdr_sz;
+        stream->avail_out = left_output_sz - hdr_sz - ftr_sz;
+        if (QZ_DEFLATE_BGZF == data_fmt) {
+            stream->avail_out = MIN(stream->avail_out,
+                                    QZ_BGZF_BLK_MAX_SZ - hdr_sz - ftr_sz);
+        }
 
-        ret = deflate(stream, flush_flag);
-        if ((Z_STREAM_END != ret && Z_FINISH == flush_flag) ||
-            (Z_OK != ret  && Z_FULL_FLUSH == flush_flag)) {
-            QZ_ERROR("ERR: deflate failed with return code: %d flush_flag: %d\n", ret,
-                     flush_flag);
-            stream->total_in = 0;
-            stream->total_out = 0;
-            qz_sess->deflate_stat = DeflateNull;
-            return QZ_FAIL;
+        /* a run of one byte value is copied from its cached encoding
+         * where the chunk ends one of our deflate streams or a full
+         * flush of a raw one, zlib's gzip wrapper can not take it */
+        run = NULL;
+        if (per_chunk ||
+            (Z_FULL_FLUSH == flush_flag && (QZ_DEFLATE_RAW == data_fmt ||
+                                            QZ_DEFLATE_ZLIB == data_fmt))) {
+            run = qzUniformChunk(qz_sess, src + total_in, send_sz,
+                                 Z_FINISH == flush_flag);
         }
+        stored = 0;
+        fixed = 0;
+        if (NULL != run && run->enc_len <= stream->avail_out) {
+            memcpy(stream->next_out, run->enc, run->enc_len);
+            current_loop_in = send_sz;
+            current_loop_out = run->enc_len;
+        } else {
+            run = NULL;
+            /* level 0 writes a chunk sampled as incompressible as stored
+             * blocks and Z_FIXED stands for static trees of QZ_AUTO_HDR,
+             * set before next_in so nothing is deflated the old way */
+            entropy = sampleChunk(qz_sess, src + total_in, send_sz);
+            stored = isIncompressible(qz_sess, entropy);
+            fixed = !stored &&
+                    QZ_AUTO_HDR == qz_sess->sess_params.huffman_hdr &&
+                    QZ_STATIC_HDR == chooseHuffmanHdr(qz_sess, entropy,
+                                                      send_sz);
+            if (stored || fixed) {
+                (void)deflateParams(stream, stored ? 0 : comp_level,
+                                    fixed ? Z_FIXED : Z_DEFAULT_STRATEGY);
+            }
+
+            stream->next_in   = (z_const Bytef *)src + total_in;
+            stream->avail_in  = send_sz;
+
+            last_loop_in = GET_LOWER_32BITS(stream->total_in);
+            last_loop_out = GET_LOWER_32BITS(stream->total_out);
+            mbr_crc = stream->adler;
+
+            ret = deflate(stream, flush_flag);
+            if ((Z_STREAM_END != ret && Z_FINISH == flush_flag) ||
+                (Z_OK != ret  && Z_FULL_FLUSH == flush_flag)) {
+                QZ_ERROR("ERR: deflate failed with return code: %d "
+                         "flush_flag: %d\n", ret, flush_flag);
+                stream->total_in = 0;
+                stream->total_out = 0;
+                qz_sess->deflate_stat = DeflateNull;
+                return QZ_FAIL;
+            }
 
-        current_loop_in = GET_LOWER_32BITS(stream->total_in) - last_loop_in;
-        current_loop_out = GET_LOWER_32BITS(stream->total_out) - last_loop_out;
+            current_loop_in = GET_LOWER_32BITS(stream->total_in) -
+                              last_loop_in;
+            current_loop_out = GET_LOWER_32BITS(stream->total_out) -
+                               last_loop_out;
+        }
+        if (per_chunk) {
+            res.produced = current_loop_out;
+            res.consumed = current_loop_in;
+            if (dict_mbr) {
+                qzGzipDictHeaderGen(dest + total_out, &res, qz_sess->dict_id);
+            } else {
+                outputHeaderGen(dest + total_out, &res, data_fmt);
+            }
+            if (ftr_sz) {
+                res.checksum = (NULL != run) ? run->crc32 :
+                               qzCrc32(0, src + total_in, current_loop_in);
+                qzGzipFooterGen(dest + total_out + hdr_sz + current_loop_out,
+                                &res);
+            }
+            current_loop_out += hdr_sz + ftr_sz;
+            if (NULL == run) {
+                deflateReset(stream);
+            }
+            if (NULL == run && NULL != qz_sess->dict &&
+                Z_OK != deflateSetDictionary(stream, qz_sess->dict,
+                                             qz_sess->dict_len)) {
+                deflateEnd(stream);
+                qz_sess->deflate_stat = DeflateNull;
+                return QZ_FAIL;
+            }
+            if (IS_MEMBER_INDEXED(qz_sess)) {
+                qzMemberIndexAdd(qz_sess, current_loop_out, current_loop_in);
+            }
+        }
+        if ((stored || fixed) && (per_chunk || Z_FULL_FLUSH == flush_flag)) {
+            (void)deflateParams(stream, comp_level, Z_DEFAULT_STRATEGY);
+        }
         left_output_sz -= current_loop_out;
 
         total_out += current_loop_out;
@@ -202,21 +316,49 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
         *src_len = total_in;
         *dest_len = total_out;
 
-        if (NULL != qz_sess->crc32) {
-            if (QZ_DEFLATE_RAW == data_fmt) {
-                *qz_sess->crc32 = crc32(*qz_sess->crc32, src, *src_len);
-            } else {
-                if (0 == *qz_sess->crc32) {
-                    *qz_sess->crc32 = stream->adler;
-                } else {
-                    *qz_sess->crc32 =
-                        crc32_combine(*qz_sess->crc32, stream->adler, *src_len);
-                }
-            }
+        /* Only this loop's slice: stream->adler and *src_len are cumulative */
+        if (NULL != qz_sess->crc32 && NULL != run) {
+            *qz_sess->crc32 = (QZ_ADLER == qz_sess->crc_type) ?
+                              adler32_combine(*qz_sess->crc32, run->adler,
+                                              current_loop_in) :
+                              qzCrc32Combine(*qz_sess->crc32, run->crc32,
+                                             current_loop_in);
+        } else if (NULL != qz_sess->crc32 && QZ_ADLER == qz_sess->crc_type) {
+            *qz_sess->crc32 = qzAdler32(*qz_sess->crc32,
+                                        src + total_in - current_loop_in,
+                                        current_loop_in);
+        } else if (NULL != qz_sess->crc32 && gz_wrap) {
+            /* split the slice off the member crc zlib already took,
+             * crc(AB) = crc(A) * x^8|B| + crc(B), instead of reading it */
+            mbr_crc = (stream->adler ^
+                       qzCrc32Combine(mbr_crc, 0, current_loop_in)) &
+                      0xffffffff;
+            *qz_sess->crc32 = qzCrc32Combine(*qz_sess->crc32, mbr_crc,
+                                             current_loop_in);
+        } else if (NULL != qz_sess->crc32 && ftr_sz) {
+            /* the footer already has the crc32 of this chunk */
+            *qz_sess->crc32 = qzCrc32Combine(*qz_sess->crc32, res.checksum,
+                                             current_loop_in);
+        } else if (NULL != qz_sess->crc32) {
+            *qz_sess->crc32 = qzCrc32(*qz_sess->crc32,
+                                      src + total_in - current_loop_in,
+                                      current_loop_in);
         }
     } while (left_input_sz);
 
     if (NULL != qz_sess->deflate_strm && 1 == last) {
+        /* one gzip member spans every call up to the last */
+        if (IS_MEMBER_INDEXED(qz_sess) && !per_chunk) {
+            qzMemberIndexAdd(qz_sess, stream->total_out, stream->total_in);
+        }
+        /* the header went out before the sizes were known, fill them in
+         * when the whole member is still in dest */
+        if (QZ_DEFLATE_GZIP_EXT == data_fmt && !per_chunk && mbr_started) {
+            res.consumed = GET_LOWER_32BITS(stream->total_in);
+            res.produced = GET_LOWER_32BITS(stream->total_out) -
+                           qzGzipHeaderSz() - stdGzipFooterSz();
+            qzGzipHeaderGen(dest, &res);
+        }
         ret = deflateEnd(stream);
         stream->total_in = 0;
         stream->total_out = 0;
@@ -229,6 +371,65 @@ int qzSWCompress(QzSession_T *sess, const unsigned char *src,
     return QZ_OK;
 }
 
+/*
+ * Inflates a whole gzip-ext member compressed with a dictionary, its
+ * header has the sizes. Its trailer is checked here, zlib only checks
+ * the ones of its gzip wrapper.
+ */
+static int decompressDictMember(QzSess_T *qz_sess, z_stream *stream,
+                                const QzGzH_T *hdr, uint32_t dict_id,
+                                const unsigned char *src,
+                                unsigned int *src_len, unsigned char *dest,
+                                unsigned int *dest_len)
+{
+    int ret = QZ_OK;
+    unsigned long comp_sz = hdr->extra.qz_e.dest_sz;
+    unsigned long orig_sz = hdr->extra.qz_e.src_sz;
+    unsigned long mbr_sz = sizeof(QzGzDictH_T) + comp_sz + stdGzipFooterSz();
+    StdGzF_T ftr;
+
+    if (NULL == qz_sess->dict || dict_id != qz_sess->dict_id) {
+        QZ_DEBUG("ERR: member needs dictionary 0x%x\n", dict_id);
+        ret = QZ_DATA_ERROR;
+    } else if (*src_len < mbr_sz) {
+        QZ_DEBUG("decompressDictMember: incomplete source buffer\n");
+        ret = QZ_DATA_ERROR;
+    } else if (*dest_len < orig_sz) {
+        ret = QZ_BUF_ERROR;
+    }
+    *src_len = 0;
+    *dest_len = 0;
+    if (QZ_OK != ret) {
+        return ret;
+    }
+
+    if (Z_OK != inflateInit2(stream, -MAX_WBITS)) {
+        return QZ_FAIL;
+    }
+    if (Z_OK != inflateSetDictionary(stream, qz_sess->dict,
+                                     qz_sess->dict_len)) {
+        ret = QZ_FAIL;
+        goto done;
+    }
+    stream->next_in = (z_const Bytef *)src + sizeof(QzGzDictH_T);
+    stream->avail_in = comp_sz;
+    stream->next_out = dest;
+    stream->avail_out = orig_sz;
+    qzGzipFooterExt(src + mbr_sz - stdGzipFooterSz(), &ftr);
+    if (Z_STREAM_END != inflate(stream, Z_FINISH) ||
+        stream->total_out != orig_sz || ftr.i_size != orig_sz ||
+        ftr.crc32 != qzCrc32(0, dest, orig_sz)) {
+        ret = QZ_DATA_ERROR;
+        goto done;
+    }
+    *src_len = mbr_sz;
+    *dest_len = orig_sz;
+
+done:
+    inflateEnd(stream);
+    return ret;
+}
+
 /* The software failover function for decompression request */
 int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
                    unsigned int *src_len, unsigned char *dest,
@@ -241,6 +442,9 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
     int windows_bits = 0;
     unsigned int total_in;
     unsigned int total_out;
+    unsigned int hdr_sz = 0;
+    uint32_t dict_id;
+    QzGzH_T dict_hdr;
 
     QzSess_T *qz_sess = (QzSess_T *) sess->internal;
     qz_sess->force_sw = 1;
@@ -263,6 +467,13 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
         qz_sess->inflate_strm = stream;
     }
 
+    if (QZ_DEFLATE_GZIP_EXT == data_fmt &&
+        InflateNull == qz_sess->inflate_stat &&
+        QZ_OK == qzGzipDictHeaderExt(src, *src_len, &dict_hdr, &dict_id)) {
+        return decompressDictMember(qz_sess, stream, &dict_hdr, dict_id, src,
+                                    src_len, dest, dest_len);
+    }
+
     stream->next_in   = (z_const Bytef *)src;
     stream->avail_in  = *src_len;
     stream->next_out  = (Bytef *)dest;
@@ -272,16 +483,32 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
 
     QZ_DEBUG("decomp_sw data_fmt: %d\n", data_fmt);
     switch (data_fmt) {
+    case QZ_DEFLATE_4B:
     case QZ_DEFLATE_RAW:
         windows_bits = -MAX_WBITS;
         break;
+    case QZ_DEFLATE_ZLIB:
+        windows_bits = MAX_WBITS;
+        break;
     case QZ_DEFLATE_GZIP:
     case QZ_DEFLATE_GZIP_EXT:
+    case QZ_DEFLATE_BGZF:
     default:
         windows_bits = MAX_WBITS + GZIP_WRAPPER;
         break;
     }
 
+    /* a new 4B block: skip its length, inflate stops at its final block */
+    if (QZ_DEFLATE_4B == data_fmt && InflateNull == qz_sess->inflate_stat) {
+        hdr_sz = outputHeaderSz(data_fmt);
+        if (stream->avail_in <= hdr_sz) {
+            ret = QZ_DATA_ERROR;
+            goto done;
+        }
+        stream->next_in += hdr_sz;
+        stream->avail_in -= hdr_sz;
+    }
+
     if (InflateNull == qz_sess->inflate_stat) {
         ret = inflateInit2(stream, windows_bits);
         if (Z_OK != ret) {
@@ -290,6 +517,14 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
         }
         QZ_DEBUG("\n****** inflate init done with win_bits: %d *****\n", windows_bits);
         qz_sess->inflate_stat = InflateInited;
+        /* a raw stream can not ask for it, zlib asks with Z_NEED_DICT */
+        if (windows_bits < 0 && NULL != qz_sess->dict &&
+            Z_OK != inflateSetDictionary(stream, qz_sess->dict,
+                                         qz_sess->dict_len)) {
+            ret = QZ_FAIL;
+            qz_sess->inflate_stat = InflateError;
+            goto done;
+        }
         stream->total_in = 0;
         total_in = 0;
         stream->total_out = 0;
@@ -300,6 +535,17 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
     }
 
     zlib_ret = inflate(stream, Z_SYNC_FLUSH);
+    if (Z_NEED_DICT == zlib_ret) {
+        if (NULL == qz_sess->dict || stream->adler != qz_sess->dict_id ||
+            Z_OK != inflateSetDictionary(stream, qz_sess->dict,
+                                         qz_sess->dict_len)) {
+            zlib_ret = Z_DATA_ERROR;
+        } else {
+            /* zlib does not count the header it stopped after */
+            stream->total_in += stream->next_in - (src + hdr_sz);
+            zlib_ret = inflate(stream, Z_SYNC_FLUSH);
+        }
+    }
     switch (zlib_ret) {
     case Z_OK:
         if (QZ_LOW_DEST_MEM == sess->thd_sess_stat) {
@@ -328,7 +574,7 @@ int qzSWDecompress(QzSession_T *sess, const unsigned char *src,
     }
 
     *dest_len = GET_LOWER_32BITS(stream->total_out - total_out);
-    *src_len = GET_LOWER_32BITS(stream->total_in - total_in);
+    *src_len = GET_LOWER_32BITS(stream->total_in - total_in) + hdr_sz;
 
 done:
     QZ_DEBUG("Exit qzSWDecompress total_in: %u total_out: %u "
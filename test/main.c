@@ -883,7 +883,7 @@ void *qzSetupParamFuncTest(void *arg)
     test_dest_sz = dest_sz;
 
     // Negative Test
-    cus_params.huffman_hdr = QZ_STATIC_HDR + 1;
+    cus_params.huffman_hdr = QZ_AUTO_HDR + 1;
     if (qzSetDefaults(&cus_params) != QZ_PARAMS) {
         QZ_ERROR("FAILED: set params should fail with incorrect huffman: %d.\n",
                  cus_params.huffman_hdr);
@@ -3194,6 +3194,71 @@ done:
     return rc;
 }
 
+int doQzCompressAdlerCheck(size_t orig_sz)
+{
+    int rc = QZ_BUF_ERROR;
+    QzSession_T sess = {0};
+    QzStream_T strm = {0};
+    uint8_t *src, *comp;
+    unsigned int src_sz, comp_sz, first_sz;
+    size_t buf_sz = orig_sz + orig_sz / 2 + 1024;
+    unsigned long adler_sw, adler_qz = 1;
+
+    src = calloc(1, orig_sz);
+    comp = calloc(1, buf_sz);
+
+    if (NULL == src || NULL == comp) {
+        goto done;
+    }
+
+    genRandomData(src, orig_sz);
+    adler_sw = adler32(1, src, GET_LOWER_32BITS(orig_sz));
+
+    /* two calls, the second merges into the checksum of the first */
+    first_sz = src_sz = GET_LOWER_32BITS(orig_sz / 3);
+    comp_sz = GET_LOWER_32BITS(buf_sz);
+    rc = qzCompressAdler(&sess, src, &src_sz, comp, &comp_sz, 0, &adler_qz);
+    if (rc != QZ_OK || src_sz != first_sz) {
+        QZ_ERROR("ERROR: qzCompressAdler failed: rc = %d\n", rc);
+        rc = QZ_FAIL;
+        goto done;
+    }
+    src_sz = GET_LOWER_32BITS(orig_sz) - first_sz;
+    comp_sz = GET_LOWER_32BITS(buf_sz);
+    rc = qzCompressAdler(&sess, src + first_sz, &src_sz, comp, &comp_sz, 1,
+                         &adler_qz);
+    if (rc != QZ_OK) {
+        QZ_ERROR("ERROR: qzCompressAdler failed: rc = %d\n", rc);
+        goto done;
+    }
+    if (adler_sw != adler_qz) {
+        QZ_ERROR("ERROR: Compression fail on Adler check: SW %lu, QATzip %lu\n",
+                 adler_sw, adler_qz);
+        rc = QZ_FAIL;
+        goto done;
+    }
+
+    strm.crc_type = QZ_ADLER;
+    strm.in = src;
+    strm.in_sz = GET_LOWER_32BITS(orig_sz);
+    strm.out = comp;
+    strm.out_sz = GET_LOWER_32BITS(buf_sz);
+    rc = qzCompressStream(&sess, &strm, 1);
+    if (rc != QZ_OK || strm.crc_32 != adler_sw) {
+        QZ_ERROR("ERROR: stream Adler check: rc = %d, SW %lu, QATzip %u\n",
+                 rc, adler_sw, strm.crc_32);
+        rc = QZ_FAIL;
+    }
+    (void)qzEndStream(&sess, &strm);
+
+done:
+    free(src);
+    free(comp);
+    (void)qzTeardownSession(&sess);
+    qzClose(&sess);
+    return rc;
+}
+
 int qzCompressCrcCheck(void)
 {
     size_t test_sz_qz = (64 * KB), test_sz_sw = (QZ_COMP_THRESHOLD_DEFAULT - 1);
@@ -3205,6 +3270,10 @@ int qzCompressCrcCheck(void)
         if (QZ_OK != rc) {
             goto done;
         }
+        rc = doQzCompressAdlerCheck(test_sz[i]);
+        if (QZ_OK != rc) {
+            goto done;
+        }
     }
 
 done:
@@ -3614,146 +3683,1727 @@ done:
     pthread_exit((void *)NULL);
 }
 
-#define STR_INTER(N)    #N
-#define STR(N) STR_INTER(N)
+void *qzCompressStreamWithSyncFlush(void *thd_arg)
+{
+    int rc;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz;
+    unsigned int step, offset = 0, produced = 0;
+    QzStream_T comp_strm = {0};
+    QzSessionParams_T params;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
 
-#define USAGE_STRING(MAX_LVL)                                                   \
-    "Usage: %s [options]\n"                                                     \
-    "\n"                                                                        \
-    "Required options:\n"                                                       \
-    "\n"                                                                        \
-    "    -m testMode           1 test memcpy feature\n"                         \
-    "                          2 test Memory\n"                                 \
-    "                          3 test comp/decomp by default parameters\n"      \
-    "                          4 test comp/decomp by configurable parameters\n" \
-    "                          5 test comp/decomp by format parameters\n"       \
-    "                          6 test set default configurable parameters\n"    \
-    "\n"                                                                        \
-    "Optional options can be:\n"                                                \
-    "\n"                                                                        \
-    "    -i inputfile          input source file\n"                             \
-    "                          default by random generate data \n"              \
-    "    -t thread_count       maximum forks permitted in the current thread\n" \
-    "                          0 means no forking permitted. \n"                \
-    "    -l loop count         default is 2\n"                                  \
-    "    -v                    verify, disabled by default\n"                   \
-    "    -e init engine        enable | disable. enabled by default\n"          \
-    "    -s init session       enable | disable. enabled by default\n"          \
-    "    -A comp_algorithm     deflate\n"                                       \
-    "    -B swBack             0 means disable sw\n"                            \
-    "                          1 means enable sw\n"                             \
-    "    -C hw_buff_sz         default 64K\n"                                   \
-    "    -D direction          comp | decomp | both\n"                          \
-    "    -F format             [comp format]:[orig data size]/...\n"            \
-    "    -L comp_lvl           1 - " STR(MAX_LVL) "\n"                          \
-    "    -O data_fmt           deflate | gzip | gzipext\n"                      \
-    "    -T huffmanType        static | dynamic\n"                              \
-    "    -r req_cnt_thrshold   max inflight request num, default is 16\n"       \
-    "    -S thread_sleep       the unit is milliseconds, default is a random time\n"       \
-    "    -P polling            set polling mode, default is periodical polling\n" \
-    "    -h                    Print this help message\n"
+    QZ_DEBUG("Hello from qzCompressStreamWithSyncFlush id %ld\n", tid);
 
-void qzPrintUsageAndExit(char *progName)
-{
-    QZ_ERROR(USAGE_STRING(QZ_DEFLATE_COMP_LVL_MAXIMUM), progName);
-    exit(-1);
-}
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
 
-static int qz_do_g_process_Check(void)
-{
-    if (g_process.qz_init_status == QZ_OK &&
-        g_process.sw_backup == 1 &&
-        (g_process.num_instances == 12 || g_process.num_instances == 4 ||
-        g_process.num_instances == 32) &&
-        g_process.qat_available == CPA_TRUE) {
-        return QZ_OK;
-    } else {
-        return QZ_FAIL;
+    rc = qzSetupSession(&g_session_th[tid], NULL);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    src_sz = 64 * KB;
+    comp_sz = 2 * src_sz;
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    /* every flushed message must come out before the next one is fed */
+    for (step = 4 * KB; offset < src_sz; offset += step) {
+        comp_strm.in = src + offset;
+        comp_strm.in_sz = step;
+        comp_strm.out = comp + produced;
+        comp_strm.out_sz = comp_sz - produced;
+        rc = qzCompressStream(&g_session_th[tid], &comp_strm, QZ_SYNC_FLUSH);
+        if (rc != QZ_OK || comp_strm.in_sz != step ||
+            0 == comp_strm.out_sz || 0 != comp_strm.pending_in) {
+            QZ_ERROR("qzCompressStream sync flush FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+        }
+        produced += comp_strm.out_sz;
+    }
+
+    comp_strm.in = src;
+    comp_strm.in_sz = 0;
+    comp_strm.out = comp + produced;
+    comp_strm.out_sz = comp_sz - produced;
+    rc = qzCompressStream(&g_session_th[tid], &comp_strm, QZ_FINISH);
+    if (rc != QZ_OK) {
+        QZ_ERROR("qzCompressStream FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+    }
+    produced += comp_strm.out_sz;
+    qzEndStream(&g_session_th[tid], &comp_strm);
+
+    rc = qzDecompress(&g_session_th[tid], comp, &produced, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("qzDecompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+    }
+
+    /* strm_flush_timeout: pending input is flushed once it is old enough */
+    (void)qzTeardownSession(&g_session_th[tid]);
+    qzGetDefaults(&params);
+    params.strm_flush_timeout = 200 * 1000;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+    produced = 0;
+    comp_strm.in = src;
+    comp_strm.in_sz = 4 * KB;
+    comp_strm.out = comp;
+    comp_strm.out_sz = comp_sz;
+    rc = qzCompressStream(&g_session_th[tid], &comp_strm, QZ_NO_FLUSH);
+    if (rc != QZ_OK || 4 * KB != comp_strm.pending_in) {
+        QZ_ERROR("qzCompressStream rc %d, pending_in %u before the timeout\n",
+                 rc, comp_strm.pending_in);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+    }
+    produced += comp_strm.out_sz;
+
+    usleep(300 * 1000);
+    comp_strm.in_sz = 0;
+    comp_strm.out = comp + produced;
+    comp_strm.out_sz = comp_sz - produced;
+    rc = qzCompressStream(&g_session_th[tid], &comp_strm, QZ_NO_FLUSH);
+    if (rc != QZ_OK || 0 != comp_strm.pending_in || 0 == comp_strm.out_sz) {
+        QZ_ERROR("qzCompressStream rc %d, pending_in %u after the timeout\n",
+                 rc, comp_strm.pending_in);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+    }
+    produced += comp_strm.out_sz;
+
+    comp_strm.out = comp + produced;
+    comp_strm.out_sz = comp_sz - produced;
+    rc = qzCompressStream(&g_session_th[tid], &comp_strm, QZ_FINISH);
+    if (rc != QZ_OK) {
+        QZ_ERROR("qzCompressStream FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
+    }
+    produced += comp_strm.out_sz;
+    qzEndStream(&g_session_th[tid], &comp_strm);
+
+    decomp_sz = src_sz;
+    rc = qzDecompress(&g_session_th[tid], comp, &produced, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != 4 * KB || memcmp(src, decomp, 4 * KB)) {
+        QZ_ERROR("qzDecompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzCompressStreamWithSyncFlush failed");
     }
+    QZ_PRINT("qzCompressStreamWithSyncFlush : PASS\n");
 
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
 }
 
-int main(int argc, char *argv[])
+/* in_sz/out_sz steps chosen to never line up with member boundaries */
+static const unsigned int g_small_in_steps[] = {1, 3, 7, 13, 61, 509, 4093};
+static const unsigned int g_small_out_steps[] = {1, 5, 11, 127, 1021, 8191};
+
+void *qzStreamSmallStepBenchmark(void *thd_arg)
 {
-    int rc = 0, ret = 0, rc_check = 0;
-    int i = 0;
-    void *p_rc;
-    int thread_count = 1, test = 0;
-    ServiceType_T service = COMP;
-    pthread_t threads[100];
-    TestArg_T test_arg[100];
-    struct sigaction s1;
+    int rc;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz;
+    unsigned int in_off, out_off, in_idx = 0, out_idx = 0, last;
+    unsigned long calls = 0;
+    QzStream_T strm = {0};
+    struct timeval ts, te;
+    double us;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
 
-    unsigned char *input_buf = NULL;
-    unsigned int input_buf_len = QATZIP_MAX_HW_SZ;
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
 
-    int thread_sleep = 0;
+    rc = qzSetupSession(&g_session_th[tid], NULL);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
 
-    s1.sa_handler = sigInt;
-    sigemptyset(&s1.sa_mask);
-    s1.sa_flags = 0;
-    sigaction(SIGINT, &s1, NULL);
+    src_sz = QATZIP_MAX_HW_SZ;
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
 
-    const char *optstring = "m:t:A:C:D:F:L:T:i:l:e:s:r:B:O:S:P:vh";
-    int opt = 0, loop_cnt = 2, verify = 0;
-    int disable_init_engine = 0, disable_init_session = 0;
-    char *stop = NULL;
-    QzThdOps *qzThdOps = NULL;
-    QzBlock_T  *qzBlocks = NULL;
-    errno = 0;
+    /* compress with small steps */
+    gettimeofday(&ts, NULL);
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = src + in_off;
+        strm.in_sz = g_small_in_steps[in_idx++ % ARRAY_LEN(g_small_in_steps)];
+        if (strm.in_sz > src_sz - in_off) {
+            strm.in_sz = src_sz - in_off;
+        }
+        strm.out = comp + out_off;
+        strm.out_sz = g_small_out_steps[out_idx++ % ARRAY_LEN(g_small_out_steps)];
+        if (strm.out_sz > comp_sz - out_off) {
+            strm.out_sz = comp_sz - out_off;
+        }
+        last = (in_off + strm.in_sz == src_sz) ? 1 : 0;
+        rc = qzCompressStream(&g_session_th[tid], &strm, last);
+        calls++;
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzCompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzStreamSmallStepBenchmark failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    gettimeofday(&te, NULL);
+    us = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+    QZ_PRINT("[thread %ld] compress   %u -> %u bytes, %lu calls, %.3f Mbps\n",
+             tid, src_sz, out_off, calls, src_sz * 8.0 / us);
+    if (strm.crc_32 != crc32(0, src, src_sz)) {
+        QZ_ERROR("ERROR: stream crc 0x%x mismatch\n", strm.crc_32);
+        pthread_exit((void *)"qzStreamSmallStepBenchmark failed");
+    }
+    qzEndStream(&g_session_th[tid], &strm);
+    comp_sz = out_off;
+
+    /* decompress with small steps, partial members stay in the ring */
+    calls = 0;
+    gettimeofday(&ts, NULL);
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = comp + in_off;
+        strm.in_sz = g_small_in_steps[in_idx++ % ARRAY_LEN(g_small_in_steps)];
+        if (strm.in_sz > comp_sz - in_off) {
+            strm.in_sz = comp_sz - in_off;
+        }
+        strm.out = decomp + out_off;
+        strm.out_sz = g_small_out_steps[out_idx++ % ARRAY_LEN(g_small_out_steps)];
+        if (strm.out_sz > decomp_sz - out_off) {
+            strm.out_sz = decomp_sz - out_off;
+        }
+        last = (in_off + strm.in_sz == comp_sz) ? 1 : 0;
+        rc = qzDecompressStream(&g_session_th[tid], &strm, last);
+        calls++;
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzDecompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzStreamSmallStepBenchmark failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    gettimeofday(&te, NULL);
+    us = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+    QZ_PRINT("[thread %ld] decompress %u -> %u bytes, %lu calls, %.3f Mbps\n",
+             tid, comp_sz, out_off, calls, out_off * 8.0 / us);
+    qzEndStream(&g_session_th[tid], &strm);
 
-    if (qzGetDefaults(&g_params_th) != QZ_OK) {
-        return -1;
+    if (out_off != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: small step stream data mismatch\n");
+        pthread_exit((void *)"qzStreamSmallStepBenchmark failed");
     }
+    QZ_PRINT("qzStreamSmallStepBenchmark : PASS\n");
 
-    while ((opt = getopt(argc, argv, optstring)) != -1) {
-        switch (opt) {
-        case 'm': // test case
-            test = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
-            if (*stop != '\0' || errno) {
-                QZ_ERROR("Error input: %s\n", optarg);
-                return -1;
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+static const unsigned int g_crc_bench_sizes[] = {
+    1, 15, 16, 63, 64, 255, 256, 4095, 65536, 65537, 1024 * 1024
+};
+
+void *qzCrc32Benchmark(void *thd_arg)
+{
+    unsigned char *src = NULL, *dst = NULL;
+    unsigned int i, off, len, loop, half;
+    unsigned long crc_zlib, crc_qz, crc_a, crc_b;
+    struct timeval ts, te;
+    double us_zlib, us_qz;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+    const unsigned int src_sz = 1024 * 1024 + 64;
+    const unsigned int loops = 64;
+
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    dst = qzMalloc(src_sz, 0, COMMON_MEM);
+    if (NULL == src || NULL == dst) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    /* verify every size at every alignment of a 16 byte block */
+    for (i = 0; i < ARRAY_LEN(g_crc_bench_sizes); i++) {
+        len = g_crc_bench_sizes[i];
+        for (off = 0; off < 16; off++) {
+            crc_zlib = crc32(0x12345678, src + off, len);
+            crc_qz = qzCrc32(0x12345678, src + off, len);
+            if (crc_zlib != crc_qz) {
+                QZ_ERROR("ERROR: crc mismatch len %u off %u: 0x%lx vs 0x%lx\n",
+                         len, off, crc_qz, crc_zlib);
+                pthread_exit((void *)"qzCrc32Benchmark failed");
             }
-            break;
-        case 't':
-            thread_count = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
-            g_params_th.max_forks = thread_count;
-            if (*stop != '\0' || errno || g_params_th.max_forks > 100) {
-                QZ_ERROR("Error thread count arg: %s\n", optarg);
-                return -1;
+
+            memset(dst, 0, len + 32);
+            crc_qz = qzCopyCrc32(dst + 15 - off, src + off, len, 0x12345678);
+            if (crc_zlib != crc_qz || memcmp(dst + 15 - off, src + off, len) ||
+                0 != dst[15 - off + len] ||
+                adler32(1, src + off, len) !=
+                qzCopyAdler32(dst + off, src + off, len, 1) ||
+                memcmp(dst + off, src + off, len)) {
+                QZ_ERROR("ERROR: fused copy mismatch len %u off %u\n", len, off);
+                pthread_exit((void *)"qzCrc32Benchmark failed");
             }
-            break;
-        case 'A':
-            if (strcmp(optarg, "deflate") == 0) {
-                g_params_th.comp_algorithm = QZ_DEFLATE;
-            } else {
-                QZ_ERROR("Error service arg: %s\n", optarg);
-                return -1;
+
+            if (adler32(7, src + off, len) != qzAdler32(7, src + off, len)) {
+                QZ_ERROR("ERROR: adler mismatch len %u off %u\n", len, off);
+                pthread_exit((void *)"qzCrc32Benchmark failed");
             }
-            break;
-        case 'O':
-            if (strcmp(optarg, "deflate") == 0) {
-                g_params_th.data_fmt = QZ_DEFLATE_RAW;
-            } else if (strcmp(optarg, "gzip") == 0) {
-                g_params_th.data_fmt = QZ_DEFLATE_GZIP;
-            } else if (strcmp(optarg, "gzipext") == 0) {
-                g_params_th.data_fmt = QZ_DEFLATE_GZIP_EXT;
-            } else {
-                QZ_ERROR("Error service arg: %s\n", optarg);
-                return -1;
+
+            half = len / 3;
+            crc_a = qzCrc32(0, src + off, half);
+            crc_b = qzCrc32(0, src + off + half, len - half);
+            crc_qz = qzCrc32Combine(crc_a, crc_b, len - half);
+            if (crc32_combine(crc_a, crc_b, len - half) != crc_qz ||
+                crc32(0, src + off, len) != crc_qz) {
+                QZ_ERROR("ERROR: crc combine mismatch len %u off %u\n", len, off);
+                pthread_exit((void *)"qzCrc32Benchmark failed");
             }
-            break;
-        case 'B':
-            g_params_th.sw_backup = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
-            if (*stop != '\0' || errno || (g_params_th.sw_backup != 0 &&
-                                           g_params_th.sw_backup != 1)) {
-                QZ_ERROR("Error input: %s\n", optarg);
-                return -1;
+            crc_a = qzAdler32(1, src + off, half);
+            crc_b = qzAdler32(1, src + off + half, len - half);
+            if (adler32(1, src + off, len) !=
+                adler32_combine(crc_a, crc_b, len - half)) {
+                QZ_ERROR("ERROR: adler combine mismatch len %u off %u\n", len, off);
+                pthread_exit((void *)"qzCrc32Benchmark failed");
             }
-            break;
-        case 'C':
-            g_params_th.hw_buff_sz = GET_LOWER_32BITS(strtoul(optarg, &stop, 0));
-            if (*stop != '\0' || errno || g_params_th.hw_buff_sz > USDM_ALLOC_MAX_SZ / 2) {
+        }
+    }
+
+    len = src_sz - 64;
+    crc_zlib = 0;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        crc_zlib = crc32(crc_zlib, src, len);
+    }
+    gettimeofday(&te, NULL);
+    us_zlib = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    crc_qz = 0;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        crc_qz = qzCrc32(crc_qz, src, len);
+    }
+    gettimeofday(&te, NULL);
+    us_qz = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    if (crc_zlib != crc_qz) {
+        QZ_ERROR("ERROR: crc mismatch after %u loops\n", loops);
+        pthread_exit((void *)"qzCrc32Benchmark failed");
+    }
+    QZ_PRINT("[thread %ld] crc32 zlib %.3f GB/s, qzCrc32 %.3f GB/s\n", tid,
+             (double)len * loops / (us_zlib * 1000.0),
+             (double)len * loops / (us_qz * 1000.0));
+
+    /* staged copy then checksum against the fused kernel */
+    crc_zlib = 0;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        memcpy(dst, src, len);
+        crc_zlib = qzCrc32(crc_zlib, dst, len);
+    }
+    gettimeofday(&te, NULL);
+    us_zlib = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    crc_qz = 0;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        crc_qz = qzCopyCrc32(dst, src, len, crc_qz);
+    }
+    gettimeofday(&te, NULL);
+    us_qz = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    if (crc_zlib != crc_qz) {
+        QZ_ERROR("ERROR: fused crc mismatch after %u loops\n", loops);
+        pthread_exit((void *)"qzCrc32Benchmark failed");
+    }
+    QZ_PRINT("[thread %ld] memcpy+crc32 %.3f GB/s, qzCopyCrc32 %.3f GB/s\n", tid,
+             (double)len * loops / (us_zlib * 1000.0),
+             (double)len * loops / (us_qz * 1000.0));
+
+    crc_zlib = 1;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        crc_zlib = adler32(crc_zlib, src, len);
+    }
+    gettimeofday(&te, NULL);
+    us_zlib = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    crc_qz = 1;
+    gettimeofday(&ts, NULL);
+    for (loop = 0; loop < loops; loop++) {
+        crc_qz = qzAdler32(crc_qz, src, len);
+    }
+    gettimeofday(&te, NULL);
+    us_qz = (te.tv_sec - ts.tv_sec) * 1000000.0 + (te.tv_usec - ts.tv_usec);
+
+    if (crc_zlib != crc_qz) {
+        QZ_ERROR("ERROR: adler mismatch after %u loops\n", loops);
+        pthread_exit((void *)"qzCrc32Benchmark failed");
+    }
+    QZ_PRINT("[thread %ld] adler32 zlib %.3f GB/s, qzAdler32 %.3f GB/s\n", tid,
+             (double)len * loops / (us_zlib * 1000.0),
+             (double)len * loops / (us_qz * 1000.0));
+    QZ_PRINT("qzCrc32Benchmark : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(dst);
+    pthread_exit((void *)NULL);
+}
+
+/* Deflate src as one std gzip member with zlib, returns its size */
+static unsigned int genStdGzipMember(unsigned char *src, unsigned int src_sz,
+                                     unsigned char *dest, unsigned int dest_sz,
+                                     int level)
+{
+    z_stream zs = {0};
+    unsigned int out_sz = 0;
+
+    if (Z_OK != deflateInit2(&zs, level, Z_DEFLATED, MAX_WBITS + 16, 8,
+                             Z_DEFAULT_STRATEGY)) {
+        return 0;
+    }
+    zs.next_in = src;
+    zs.avail_in = src_sz;
+    zs.next_out = dest;
+    zs.avail_out = dest_sz;
+    if (Z_STREAM_END == deflate(&zs, Z_FINISH)) {
+        out_sz = (unsigned int)zs.total_out;
+    }
+    deflateEnd(&zs);
+    return out_sz;
+}
+
+void *qzGzipMemberScanTest(void *thd_arg)
+{
+    int rc, i, cnt, sig_cnt;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned char *footers[QZ_GZIP_MEMBER_BATCH];
+    unsigned int member_end[8];
+    unsigned int member_sz, comp_sz = 0, decomp_sz;
+    const unsigned int src_sz = 64 * KB;
+    const unsigned int members = ARRAY_LEN(member_end);
+    /* a footer with an impossible ISIZE followed by a member signature */
+    const unsigned char fake[] = {0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+                                  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                  0x00, 0x03, 0x05, 0x00
+                                 };
+    /* a plausible footer, then a fixed block whose first match is at
+     * distance 1, which no real member can start with */
+    const unsigned char fake_blk[] = {0x78, 0x56, 0x34, 0x12, 0x64, 0x00, 0x00, 0x00,
+                                      0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                      0x00, 0x03, 0x03, 0x02
+                                     };
+    QzSessionParams_T params;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(2 * src_sz * members, 0, COMMON_MEM);
+    decomp = qzMalloc(src_sz * members, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+    for (i = 0; i < src_sz - sizeof(fake); i += 4 * KB) {
+        memcpy(src + i, (i & 4 * KB) ? fake_blk : fake, sizeof(fake));
+    }
+
+    /* stored members keep the fake signatures in the payload */
+    for (i = 0; i < members; i++) {
+        member_sz = genStdGzipMember(src, src_sz, comp + comp_sz,
+                                     2 * src_sz, (i & 1) ? 0 : 1);
+        if (0 == member_sz) {
+            pthread_exit((void *)"qzGzipMemberScanTest failed");
+        }
+        comp_sz += member_sz;
+        member_end[i] = comp_sz;
+    }
+
+    sig_cnt = findStdGzipMembers(comp, comp_sz, footers, QZ_GZIP_MEMBER_BATCH,
+                                 GzipScanSig);
+    if (sig_cnt <= members) {
+        QZ_ERROR("ERROR: unverified scan found %d members\n", sig_cnt);
+        pthread_exit((void *)"qzGzipMemberScanTest failed");
+    }
+
+    /* the cheap checks drop fake, only the trial inflate drops fake_blk */
+    cnt = findStdGzipMembers(comp, comp_sz, footers, QZ_GZIP_MEMBER_BATCH,
+                             GzipScanCheap);
+    if (cnt <= members || cnt >= sig_cnt) {
+        QZ_ERROR("ERROR: cheap scan found %d members\n", cnt);
+        pthread_exit((void *)"qzGzipMemberScanTest failed");
+    }
+
+    cnt = findStdGzipMembers(comp, comp_sz, footers, QZ_GZIP_MEMBER_BATCH,
+                             GzipScanInflate);
+    if (cnt != members) {
+        QZ_ERROR("ERROR: verified scan found %d of %u members\n", cnt, members);
+        pthread_exit((void *)"qzGzipMemberScanTest failed");
+    }
+    for (i = 0; i < cnt; i++) {
+        if (footers[i] + 8 != comp + member_end[i]) {
+            QZ_ERROR("ERROR: member %d ends at %ld, expected %u\n", i,
+                     (long)(footers[i] + 8 - comp), member_end[i]);
+            pthread_exit((void *)"qzGzipMemberScanTest failed");
+        }
+    }
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_GZIP;
+    /* the payload holds fake_blk, which only the trial inflate rejects */
+    params.member_verify = 1;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    decomp_sz = src_sz * members;
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz * members) {
+        QZ_ERROR("ERROR: qzDecompress rc %d, produced %u\n", rc, decomp_sz);
+        pthread_exit((void *)"qzGzipMemberScanTest failed");
+    }
+    for (i = 0; i < members; i++) {
+        if (memcmp(src, decomp + i * src_sz, src_sz)) {
+            QZ_ERROR("ERROR: member %d data mismatch\n", i);
+            pthread_exit((void *)"qzGzipMemberScanTest failed");
+        }
+    }
+    QZ_PRINT("qzGzipMemberScanTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzDeflate4BTest(void *thd_arg)
+{
+    int rc, ret;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, blk_sz, off, blocks = 0;
+    unsigned int in_off, out_off, last;
+    QzStream_T strm = {0};
+    QzSessionParams_T params;
+    z_stream zs = {0};
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_4B;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    src_sz = 3 * params.hw_buff_sz + 1234;
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    rc = qzCompress(&g_session_th[tid], src, &src_sz, comp, &comp_sz, 1);
+    if (rc != QZ_OK) {
+        QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+
+    /* every block is a length followed by a complete raw deflate stream */
+    for (off = 0; off < comp_sz; off += 4 + blk_sz, blocks++) {
+        blk_sz = comp[off] | (comp[off + 1] << 8) | (comp[off + 2] << 16) |
+                 ((unsigned int)comp[off + 3] << 24);
+        if (Z_OK != inflateInit2(&zs, -MAX_WBITS)) {
+            pthread_exit((void *)"qzDeflate4BTest failed");
+        }
+        zs.next_in = comp + off + 4;
+        zs.avail_in = blk_sz;
+        zs.next_out = decomp;
+        zs.avail_out = decomp_sz;
+        ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (Z_STREAM_END != ret || 0 != zs.avail_in) {
+            QZ_ERROR("ERROR: 4B block %u at %u is not a deflate stream\n",
+                     blocks, off);
+            pthread_exit((void *)"qzDeflate4BTest failed");
+        }
+    }
+    if (off != comp_sz || blocks < 4) {
+        QZ_ERROR("ERROR: 4B framing covers %u of %u bytes in %u blocks\n",
+                 off, comp_sz, blocks);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: qzDecompress rc %d, produced %u\n", rc, decomp_sz);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+
+    /* a block from a larger hw_buff_sz inflates past the engine output */
+    (void)qzTeardownSession(&g_session_th[tid]);
+    params.hw_buff_sz = QZ_HW_BUFF_MAX_SZ;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    rc = qzCompress(&g_session_th[tid], src, &src_sz, comp, &comp_sz, 1);
+    blk_sz = comp[0] | (comp[1] << 8) | (comp[2] << 16) |
+             ((unsigned int)comp[3] << 24);
+    if (rc != QZ_OK || 4 + blk_sz != comp_sz) {
+        QZ_ERROR("qzCompress rc %d, %u bytes not one 4B block\n", rc, comp_sz);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+    (void)qzTeardownSession(&g_session_th[tid]);
+    params.hw_buff_sz = QZ_HW_BUFF_SZ;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+    decomp_sz = src_sz;
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: oversized 4B block rc %d, produced %u\n", rc,
+                 decomp_sz);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+
+    /* stream round trip, blocks are split across calls */
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = src + in_off;
+        strm.in_sz = (src_sz - in_off < 3000) ? src_sz - in_off : 3000;
+        strm.out = comp + out_off;
+        strm.out_sz = 5000;
+        last = (in_off + strm.in_sz == src_sz) ? 1 : 0;
+        rc = qzCompressStream(&g_session_th[tid], &strm, last);
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzCompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzDeflate4BTest failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    qzEndStream(&g_session_th[tid], &strm);
+    comp_sz = out_off;
+
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = comp + in_off;
+        strm.in_sz = (comp_sz - in_off < 3000) ? comp_sz - in_off : 3000;
+        strm.out = decomp + out_off;
+        strm.out_sz = (decomp_sz - out_off < 5000) ? decomp_sz - out_off : 5000;
+        last = (in_off + strm.in_sz == comp_sz) ? 1 : 0;
+        rc = qzDecompressStream(&g_session_th[tid], &strm, last);
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzDecompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzDeflate4BTest failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    qzEndStream(&g_session_th[tid], &strm);
+    if (out_off != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: 4B stream data mismatch, produced %u\n", out_off);
+        pthread_exit((void *)"qzDeflate4BTest failed");
+    }
+    QZ_PRINT("qzDeflate4BTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzZlibFormatTest(void *thd_arg)
+{
+    int rc;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, part_sz, out_sz;
+    unsigned int in_off, out_off, last;
+    unsigned long adler = 1;
+    uLongf zlib_sz;
+    QzStream_T strm = {0};
+    QzSessionParams_T params;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_ZLIB;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    src_sz = 3 * params.hw_buff_sz + 1234;
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    /* a call that fails without output must not use up the header */
+    part_sz = params.hw_buff_sz + 100;
+    out_sz = 4;
+    rc = qzCompressAdler(&g_session_th[tid], src, &part_sz, comp, &out_sz, 0,
+                         &adler);
+    if (rc == QZ_OK || 0 != part_sz || 0 != out_sz || 1 != adler) {
+        QZ_ERROR("qzCompressAdler rc %d, consumed %u, produced %u\n", rc,
+                 part_sz, out_sz);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+
+    /* one zlib stream over two calls */
+    part_sz = params.hw_buff_sz + 100;
+    out_sz = comp_sz;
+    rc = qzCompressAdler(&g_session_th[tid], src, &part_sz, comp, &out_sz, 0,
+                         &adler);
+    if (rc != QZ_OK || part_sz != params.hw_buff_sz + 100) {
+        QZ_ERROR("qzCompressAdler FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+    comp_sz -= out_sz;
+    in_off = src_sz - part_sz;
+    rc = qzCompressAdler(&g_session_th[tid], src + part_sz, &in_off,
+                         comp + out_sz, &comp_sz, 1, &adler);
+    if (rc != QZ_OK || part_sz + in_off != src_sz) {
+        QZ_ERROR("qzCompressAdler FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+    comp_sz += out_sz;
+    if (adler != adler32(1, src, src_sz) ||
+        adler != ((unsigned long)comp[comp_sz - 4] << 24 |
+                  comp[comp_sz - 3] << 16 | comp[comp_sz - 2] << 8 |
+                  comp[comp_sz - 1])) {
+        QZ_ERROR("ERROR: zlib trailer or adler 0x%lx mismatch\n", adler);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+
+    zlib_sz = decomp_sz;
+    if (Z_OK != uncompress(decomp, &zlib_sz, comp, comp_sz) ||
+        zlib_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: zlib rejects the zlib stream\n");
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: qzDecompress rc %d, produced %u\n", rc, decomp_sz);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+
+    /* stream round trip */
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = src + in_off;
+        strm.in_sz = (src_sz - in_off < 3000) ? src_sz - in_off : 3000;
+        strm.out = comp + out_off;
+        strm.out_sz = 5000;
+        last = (in_off + strm.in_sz == src_sz) ? 1 : 0;
+        rc = qzCompressStream(&g_session_th[tid], &strm, last);
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzCompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzZlibFormatTest failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    qzEndStream(&g_session_th[tid], &strm);
+    comp_sz = out_off;
+
+    zlib_sz = decomp_sz;
+    if (Z_OK != uncompress(decomp, &zlib_sz, comp, comp_sz) ||
+        zlib_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: zlib rejects the stream output\n");
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+
+    for (in_off = 0, out_off = 0; ;) {
+        strm.in = comp + in_off;
+        strm.in_sz = (comp_sz - in_off < 3000) ? comp_sz - in_off : 3000;
+        strm.out = decomp + out_off;
+        strm.out_sz = (decomp_sz - out_off < 5000) ? decomp_sz - out_off : 5000;
+        last = (in_off + strm.in_sz == comp_sz) ? 1 : 0;
+        rc = qzDecompressStream(&g_session_th[tid], &strm, last);
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzDecompressStream FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzZlibFormatTest failed");
+        }
+        in_off += strm.in_sz;
+        out_off += strm.out_sz;
+        if (1 == last && 0 == strm.pending_in && 0 == strm.pending_out) {
+            break;
+        }
+    }
+    qzEndStream(&g_session_th[tid], &strm);
+    if (out_off != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: zlib stream data mismatch, produced %u\n", out_off);
+        pthread_exit((void *)"qzZlibFormatTest failed");
+    }
+    QZ_PRINT("qzZlibFormatTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+static int checkRanges(QzSession_T *sess, unsigned char *comp,
+                       unsigned long comp_sz, unsigned char *src,
+                       unsigned int src_sz, unsigned char *out)
+{
+    int i, rc;
+    unsigned long offset;
+    unsigned int len, want;
+
+    for (i = 0; i < 64; i++) {
+        offset = (i < 2) ? i * (src_sz - 1) : rand() % src_sz;
+        want = (i & 1) ? 1 : rand() % (3 * QZ_HW_BUFF_SZ);
+        len = want;
+        rc = qzDecompressRange(sess, comp, comp_sz, offset, out, &len);
+        if (rc != QZ_OK || len != MIN(want, src_sz - offset) ||
+            memcmp(src + offset, out, len)) {
+            QZ_ERROR("ERROR: range %lu+%u rc %d returned %u\n", offset, want,
+                     rc, len);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void *qzMemberIndexTest(void *thd_arg)
+{
+    int rc, i;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, member_sz;
+    unsigned long off = 0;
+    const unsigned int members = QZ_MEMBER_INDEX_PER_MBR + 100;
+    QzSessionParams_T params;
+    QzSess_T idx_sess = {0};
+    z_stream zs = {0};
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_GZIP_EXT;
+    params.member_index = 1;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    src_sz = 5 * params.hw_buff_sz + 777;
+    comp_sz = 2 * members * 128;
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    /* the index is a gzip member any reader skips */
+    rc = qzCompress(&g_session_th[tid], src, &src_sz, comp, &comp_sz, 1);
+    if (rc != QZ_OK) {
+        QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    member_sz = comp_sz;
+    rc = qzDecompress(&g_session_th[tid], comp, &member_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: qzDecompress rc %d, produced %u\n", rc, decomp_sz);
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    if (Z_OK != inflateInit2(&zs, MAX_WBITS + 16)) {
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    zs.next_in = comp;
+    zs.avail_in = comp_sz;
+    zs.next_out = decomp;
+    zs.avail_out = decomp_sz;
+    while (zs.avail_in && Z_STREAM_END == inflate(&zs, Z_NO_FLUSH)) {
+        inflateReset(&zs);
+    }
+    inflateEnd(&zs);
+    if (0 != zs.avail_in || zs.next_out - decomp != src_sz) {
+        QZ_ERROR("ERROR: zlib stopped with %u bytes left\n", zs.avail_in);
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    if (checkRanges(&g_session_th[tid], comp, comp_sz, src, src_sz, decomp)) {
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+
+    /* small members, so the index spans several gzip members */
+    if (QZ_OK != qzMemberIndexReserve(&idx_sess, members)) {
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    src_sz = members * 64;
+    for (i = 0; i < members; i++) {
+        member_sz = genStdGzipMember(src + i * 64, 64, comp + off, 256, 1);
+        if (0 == member_sz) {
+            pthread_exit((void *)"qzMemberIndexTest failed");
+        }
+        qzMemberIndexAdd(&idx_sess, member_sz, 64);
+        off += member_sz;
+    }
+    off += qzMemberIndexGen(&idx_sess, comp + off);
+    free(idx_sess.mbr_idx);
+    if (checkRanges(&g_session_th[tid], comp, off, src, src_sz, decomp)) {
+        pthread_exit((void *)"qzMemberIndexTest failed");
+    }
+    QZ_PRINT("qzMemberIndexTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzBgzfTest(void *thd_arg)
+{
+    int rc;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned char *gzi = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, part_sz, out_sz;
+    unsigned long gzi_len = 0, off, orig_off, blk_sz, blks;
+    uint64_t ent[2];
+    static const unsigned char eof_blk[28] = {
+        0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 0x06, 0, 'B', 'C',
+        0x02, 0, 0x1b, 0, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    QzSessionParams_T params;
+    z_stream zs = {0};
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_BGZF;
+    params.member_index = 1;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+
+    src_sz = 4 * params.hw_buff_sz + 4321;
+    comp_sz = qzMaxCompressedLength(src_sz, &g_session_th[tid]);
+    decomp_sz = src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(decomp_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    /* random data, so blocks must stay within 64K stored or not */
+    genRandomData(src, src_sz);
+
+    /* one BGZF file over two calls */
+    part_sz = params.hw_buff_sz + 100;
+    out_sz = comp_sz;
+    rc = qzCompress(&g_session_th[tid], src, &part_sz, comp, &out_sz, 0);
+    if (rc != QZ_OK || part_sz != params.hw_buff_sz + 100) {
+        QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+    comp_sz -= out_sz;
+    part_sz = src_sz - part_sz;
+    rc = qzCompress(&g_session_th[tid], src + src_sz - part_sz, &part_sz,
+                    comp + out_sz, &comp_sz, 1);
+    if (rc != QZ_OK) {
+        QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+    comp_sz += out_sz;
+    if (comp_sz < sizeof(eof_blk) ||
+        memcmp(comp + comp_sz - sizeof(eof_blk), eof_blk, sizeof(eof_blk))) {
+        QZ_ERROR("ERROR: no BGZF EOF block\n");
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+
+    /* walk the blocks by BSIZE, the .gzi must list all but the first */
+    if (QZ_OK != qzGetGziIndex(&g_session_th[tid], NULL, &gzi_len) ||
+        NULL == (gzi = malloc(gzi_len)) ||
+        QZ_OK != qzGetGziIndex(&g_session_th[tid], gzi, &gzi_len)) {
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+    for (off = 0, orig_off = 0, blks = 0;
+         off < comp_sz - sizeof(eof_blk); blks++) {
+        if (comp[off + 12] != 'B' || comp[off + 13] != 'C') {
+            QZ_ERROR("ERROR: no BC subfield at %lu\n", off);
+            pthread_exit((void *)"qzBgzfTest failed");
+        }
+        blk_sz = (comp[off + 16] | comp[off + 17] << 8) + 1;
+        if (blks > 0) {
+            memcpy(ent, gzi + 8 + (blks - 1) * sizeof(ent), sizeof(ent));
+            if (8 + blks * sizeof(ent) > gzi_len ||
+                ent[0] != off || ent[1] != orig_off) {
+                QZ_ERROR("ERROR: gzi entry %lu mismatch\n", blks);
+                pthread_exit((void *)"qzBgzfTest failed");
+            }
+        }
+        orig_off += comp[off + blk_sz - 4] | comp[off + blk_sz - 3] << 8 |
+                    comp[off + blk_sz - 2] << 16 |
+                    (unsigned long)comp[off + blk_sz - 1] << 24;
+        off += blk_sz;
+    }
+    memcpy(ent, gzi, sizeof(ent[0]));
+    if (off != comp_sz - sizeof(eof_blk) || orig_off != src_sz ||
+        ent[0] != blks - 1 || gzi_len != 8 + (blks - 1) * sizeof(ent)) {
+        QZ_ERROR("ERROR: %lu blocks, %lu bytes\n", blks, orig_off);
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+
+    /* plain gzip readers see concatenated members */
+    if (Z_OK != inflateInit2(&zs, MAX_WBITS + 16)) {
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+    zs.next_in = comp;
+    zs.avail_in = comp_sz;
+    zs.next_out = decomp;
+    zs.avail_out = decomp_sz;
+    while (zs.avail_in && Z_STREAM_END == inflate(&zs, Z_NO_FLUSH)) {
+        inflateReset(&zs);
+    }
+    inflateEnd(&zs);
+    if (0 != zs.avail_in || zs.next_out - decomp != src_sz ||
+        memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: zlib stopped with %u bytes left\n", zs.avail_in);
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: qzDecompress rc %d, produced %u\n", rc, decomp_sz);
+        pthread_exit((void *)"qzBgzfTest failed");
+    }
+    QZ_PRINT("qzBgzfTest : PASS\n");
+
+done:
+    free(gzi);
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzDecompressedSizeTest(void *thd_arg)
+{
+    int rc, i;
+    unsigned char *src = NULL, *comp = NULL;
+    unsigned int src_sz, comp_sz, member_sz;
+    unsigned long orig_sz, cnt;
+    const struct {
+        QzDataFormat_T data_fmt;
+        unsigned char member_index;
+    } cases[] = {
+        {QZ_DEFLATE_GZIP_EXT, 0},
+        {QZ_DEFLATE_GZIP_EXT, 1},
+        {QZ_DEFLATE_BGZF, 0},
+        {QZ_DEFLATE_RAW, 0},
+    };
+    QzSessionParams_T params;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+
+    src_sz = 3 * QZ_HW_BUFF_SZ + 555;
+    comp_sz = 2 * src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    if (!src || !comp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, src_sz);
+
+    for (i = 0; i < ARRAY_LEN(cases); i++) {
+        qzGetDefaults(&params);
+        params.data_fmt = cases[i].data_fmt;
+        params.member_index = cases[i].member_index;
+        rc = qzSetupSession(&g_session_th[tid], &params);
+        if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+            pthread_exit((void *)"qzSetupSession failed");
+        }
+        member_sz = comp_sz;
+        rc = qzCompress(&g_session_th[tid], src, &src_sz, comp, &member_sz, 1);
+        if (rc != QZ_OK) {
+            QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzDecompressedSizeTest failed");
+        }
+        rc = qzGetDecompressedSizeExt(&g_session_th[tid], comp, member_sz,
+                                      &orig_sz, &cnt);
+        if (QZ_DEFLATE_RAW == cases[i].data_fmt) {
+            if (rc != QZ_FAIL) {
+                QZ_ERROR("ERROR: raw deflate was sized, rc %d\n", rc);
+                pthread_exit((void *)"qzDecompressedSizeTest failed");
+            }
+        } else if (rc != QZ_OK || orig_sz != src_sz || 0 == cnt ||
+                   (QZ_DEFLATE_BGZF == cases[i].data_fmt &&
+                    cnt != (src_sz + QZ_BGZF_DATA_MAX_SZ - 1) /
+                    QZ_BGZF_DATA_MAX_SZ)) {
+            QZ_ERROR("ERROR: case %d rc %d, size %lu, %lu members\n", i, rc,
+                     orig_sz, cnt);
+            pthread_exit((void *)"qzDecompressedSizeTest failed");
+        }
+        /* a member cut short is not sized */
+        if (QZ_DEFLATE_RAW != cases[i].data_fmt &&
+            QZ_DATA_ERROR != qzGetDecompressedSize(NULL, comp, member_sz / 2,
+                                                   &orig_sz)) {
+            QZ_ERROR("ERROR: case %d sized truncated data\n", i);
+            pthread_exit((void *)"qzDecompressedSizeTest failed");
+        }
+        (void)qzTeardownSession(&g_session_th[tid]);
+    }
+
+    /* std gzip members, as gzip or pigz write them */
+    comp_sz = 0;
+    for (i = 0; i < 3; i++) {
+        member_sz = genStdGzipMember(src + i * KB, (i + 1) * KB, comp + comp_sz,
+                                     4 * KB, 1);
+        if (0 == member_sz) {
+            pthread_exit((void *)"qzDecompressedSizeTest failed");
+        }
+        comp_sz += member_sz;
+    }
+    rc = qzGetDecompressedSizeExt(NULL, comp, comp_sz, &orig_sz, &cnt);
+    if (rc != QZ_OK || orig_sz != 6 * KB || cnt != 3) {
+        QZ_ERROR("ERROR: std gzip rc %d, size %lu, %lu members\n", rc,
+                 orig_sz, cnt);
+        pthread_exit((void *)"qzDecompressedSizeTest failed");
+    }
+    QZ_PRINT("qzDecompressedSizeTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+static unsigned int genRecords(unsigned char *buf, unsigned int first,
+                               unsigned int cnt, unsigned int *lens)
+{
+    unsigned int i, len = 0;
+    int n;
+
+    for (i = 0; i < cnt; i++) {
+        n = sprintf((char *)buf + len,
+                    "{\"id\":%u,\"user\":\"user%05u\",\"status\":\"active\","
+                    "\"region\":\"eu-west-1\",\"tags\":[\"alpha\",\"beta\"],"
+                    "\"score\":%u}\n", first + i, (first + i) * 7, i % 97);
+        if (NULL != lens) {
+            lens[i] = n;
+        }
+        len += n;
+    }
+    return len;
+}
+
+static int dictRoundTrip(QzSession_T *sess, QzDataFormat_T data_fmt,
+                         const unsigned char *dict, unsigned int dict_len,
+                         const unsigned char *src, unsigned int src_sz,
+                         unsigned char *comp, unsigned int *comp_sz,
+                         unsigned char *decomp, unsigned int *decomp_sz)
+{
+    int rc;
+    unsigned int len = src_sz;
+    QzSessionParams_T params;
+
+    qzGetDefaults(&params);
+    params.data_fmt = data_fmt;
+    rc = qzSetupSession(sess, &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        return rc;
+    }
+    rc = qzSetDictionary(sess, dict, dict_len);
+    if (rc != QZ_OK) {
+        return rc;
+    }
+    rc = qzCompress(sess, src, &len, comp, comp_sz, 1);
+    if (rc != QZ_OK) {
+        return rc;
+    }
+    len = *comp_sz;
+    rc = qzDecompress(sess, comp, &len, decomp, decomp_sz);
+    (void)qzTeardownSession(sess);
+    return rc;
+}
+
+void *qzDictionaryTest(void *thd_arg)
+{
+    int rc, i;
+    unsigned char *samples = NULL, *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned char dict[QZ_DICT_MAX_SZ];
+    unsigned int sample_lens[256];
+    unsigned int samples_sz, src_sz, dict_len, comp_sz, plain_sz, decomp_sz;
+    const QzDataFormat_T fmts[] = {
+        QZ_DEFLATE_GZIP_EXT, QZ_DEFLATE_ZLIB, QZ_DEFLATE_RAW, QZ_DEFLATE_4B
+    };
+    QzSessionParams_T params;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+
+    samples = qzMalloc(256 * KB, 0, COMMON_MEM);
+    src = qzMalloc(KB, 0, COMMON_MEM);
+    comp = qzMalloc(4 * KB, 0, COMMON_MEM);
+    decomp = qzMalloc(4 * KB, 0, COMMON_MEM);
+    if (!samples || !src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+
+    samples_sz = genRecords(samples, 0, ARRAY_LEN(sample_lens), sample_lens);
+    dict_len = sizeof(dict);
+    rc = qzTrainDictionary(samples, sample_lens, ARRAY_LEN(sample_lens), dict,
+                           &dict_len);
+    if (rc != QZ_OK || 0 == dict_len || dict_len > samples_sz) {
+        QZ_ERROR("ERROR: qzTrainDictionary rc %d, dict_len %u\n", rc, dict_len);
+        pthread_exit((void *)"qzDictionaryTest failed");
+    }
+
+    /* a few new records, too short to compress well on their own */
+    src_sz = genRecords(src, 1000, 4, NULL);
+    for (i = 0; i < ARRAY_LEN(fmts); i++) {
+        plain_sz = 4 * KB;
+        decomp_sz = 4 * KB;
+        rc = dictRoundTrip(&g_session_th[tid], fmts[i], NULL, 0, src, src_sz,
+                           comp, &plain_sz, decomp, &decomp_sz);
+        if (rc != QZ_OK) {
+            QZ_ERROR("ERROR: fmt %d without dictionary rc %d\n", fmts[i], rc);
+            pthread_exit((void *)"qzDictionaryTest failed");
+        }
+
+        comp_sz = 4 * KB;
+        decomp_sz = 4 * KB;
+        rc = dictRoundTrip(&g_session_th[tid], fmts[i], dict, dict_len, src,
+                           src_sz, comp, &comp_sz, decomp, &decomp_sz);
+        if (rc != QZ_OK || decomp_sz != src_sz ||
+            memcmp(src, decomp, src_sz) || comp_sz >= plain_sz) {
+            QZ_ERROR("ERROR: fmt %d rc %d, %u -> %u bytes, %u without "
+                     "dictionary\n", fmts[i], rc, src_sz, comp_sz, plain_sz);
+            pthread_exit((void *)"qzDictionaryTest failed");
+        }
+
+        /* the data can not be restored without it */
+        qzGetDefaults(&params);
+        params.data_fmt = fmts[i];
+        rc = qzSetupSession(&g_session_th[tid], &params);
+        if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+            pthread_exit((void *)"qzSetupSession failed");
+        }
+        decomp_sz = 4 * KB;
+        rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp,
+                          &decomp_sz);
+        if (rc == QZ_OK && decomp_sz == src_sz &&
+            0 == memcmp(src, decomp, src_sz)) {
+            QZ_ERROR("ERROR: fmt %d restored without dictionary\n", fmts[i]);
+            pthread_exit((void *)"qzDictionaryTest failed");
+        }
+        (void)qzTeardownSession(&g_session_th[tid]);
+    }
+
+    /* formats whose members must stand alone refuse it */
+    qzGetDefaults(&params);
+    params.data_fmt = QZ_DEFLATE_BGZF;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+    if (QZ_PARAMS != qzSetDictionary(&g_session_th[tid], dict, dict_len)) {
+        QZ_ERROR("ERROR: bgzf session took a dictionary\n");
+        pthread_exit((void *)"qzDictionaryTest failed");
+    }
+    QZ_PRINT("qzDictionaryTest : PASS\n");
+
+done:
+    qzFree(samples);
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzEntropyStoreTest(void *thd_arg)
+{
+    int rc, i, k;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, len;
+    const QzDataFormat_T fmts[] = {
+        QZ_DEFLATE_GZIP_EXT, QZ_DEFLATE_ZLIB, QZ_DEFLATE_RAW
+    };
+    QzSessionParams_T params;
+    QzStatus_T status;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+
+    /* three chunks of random bytes, then a compressible one */
+    src_sz = 4 * QZ_HW_BUFF_SZ;
+    comp_sz = 2 * src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(src_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    for (i = 0; i < 3 * QZ_HW_BUFF_SZ; i++) {
+        src[i] = GET_LOWER_8BITS(rand());
+    }
+    genRandomData(src + 3 * QZ_HW_BUFF_SZ, QZ_HW_BUFF_SZ);
+
+    for (i = 0; i < 2 * ARRAY_LEN(fmts); i++) {
+        qzGetDefaults(&params);
+        params.data_fmt = fmts[i % ARRAY_LEN(fmts)];
+        /* the first round samples, the second keeps the default, off */
+        if (i < ARRAY_LEN(fmts)) {
+            params.entropy_thrshold = 790;
+        }
+        rc = qzSetupSession(&g_session_th[tid], &params);
+        if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+            pthread_exit((void *)"qzSetupSession failed");
+        }
+        len = src_sz;
+        comp_sz = 2 * src_sz;
+        rc = qzCompress(&g_session_th[tid], src, &len, comp, &comp_sz, 1);
+        if (rc != QZ_OK || len != src_sz) {
+            QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzEntropyStoreTest failed");
+        }
+        (void)qzGetStatus(&g_session_th[tid], &status);
+        k = (i >= ARRAY_LEN(fmts)) ? 0 : 4;
+        if (status.chunks_sampled != k ||
+            status.chunks_stored != (k ? 3 : 0) ||
+            (k && comp_sz < 3 * QZ_HW_BUFF_SZ)) {
+            QZ_ERROR("ERROR: fmt %d, %lu of %lu chunks stored, %u bytes\n",
+                     params.data_fmt, status.chunks_stored,
+                     status.chunks_sampled, comp_sz);
+            pthread_exit((void *)"qzEntropyStoreTest failed");
+        }
+
+        decomp_sz = src_sz;
+        rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp,
+                          &decomp_sz);
+        if (rc != QZ_OK || decomp_sz != src_sz ||
+            memcmp(src, decomp, src_sz)) {
+            QZ_ERROR("ERROR: fmt %d decompress rc %d, %u bytes\n",
+                     params.data_fmt, rc, decomp_sz);
+            pthread_exit((void *)"qzEntropyStoreTest failed");
+        }
+        (void)qzTeardownSession(&g_session_th[tid]);
+    }
+
+    qzGetDefaults(&params);
+    params.entropy_thrshold = QZ_ENTROPY_THRESHOLD_MAXIMUM + 1;
+    if (QZ_PARAMS != qzSetupSession(&g_session_th[tid], &params)) {
+        QZ_ERROR("ERROR: entropy_thrshold %u accepted\n",
+                 params.entropy_thrshold);
+        pthread_exit((void *)"qzEntropyStoreTest failed");
+    }
+    QZ_PRINT("qzEntropyStoreTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzAutoHuffmanTest(void *thd_arg)
+{
+    int rc, i;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, len;
+    QzSessionParams_T params;
+    QzStatus_T status;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+
+    /* a compressible chunk, a near uniform one and a tiny tail */
+    src_sz = 2 * QZ_HW_BUFF_SZ + 512;
+    comp_sz = 2 * src_sz;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(comp_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(src_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    genRandomData(src, QZ_HW_BUFF_SZ);
+    for (i = QZ_HW_BUFF_SZ; i < src_sz; i++) {
+        src[i] = GET_LOWER_8BITS(rand() % 200);
+    }
+
+    qzGetDefaults(&params);
+    params.huffman_hdr = QZ_AUTO_HDR;
+    rc = qzSetupSession(&g_session_th[tid], &params);
+    if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzSetupSession failed");
+    }
+    len = src_sz;
+    rc = qzCompress(&g_session_th[tid], src, &len, comp, &comp_sz, 1);
+    if (rc != QZ_OK || len != src_sz) {
+        QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+        pthread_exit((void *)"qzAutoHuffmanTest failed");
+    }
+    (void)qzGetStatus(&g_session_th[tid], &status);
+    if (status.chunks_dynamic_hdr != 1 || status.chunks_static_hdr != 2 ||
+        status.chunks_stored != 0) {
+        QZ_ERROR("ERROR: %lu static, %lu dynamic, %lu stored chunks\n",
+                 status.chunks_static_hdr, status.chunks_dynamic_hdr,
+                 status.chunks_stored);
+        pthread_exit((void *)"qzAutoHuffmanTest failed");
+    }
+
+    decomp_sz = src_sz;
+    rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp, &decomp_sz);
+    if (rc != QZ_OK || decomp_sz != src_sz || memcmp(src, decomp, src_sz)) {
+        QZ_ERROR("ERROR: decompress rc %d, %u bytes\n", rc, decomp_sz);
+        pthread_exit((void *)"qzAutoHuffmanTest failed");
+    }
+    QZ_PRINT("qzAutoHuffmanTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+void *qzUniformChunkTest(void *thd_arg)
+{
+    int rc, i;
+    unsigned char *src = NULL, *comp = NULL, *decomp = NULL;
+    unsigned int src_sz, comp_sz, decomp_sz, len;
+    const struct {
+        QzDataFormat_T data_fmt;
+        unsigned long uniform_cnt;
+    } cases[] = {
+        /* BGZF chunks are 0xff00, two of them stay in the zero run */
+        {QZ_DEFLATE_RAW, 3},
+        {QZ_DEFLATE_ZLIB, 3},
+        {QZ_DEFLATE_4B, 3},
+        {QZ_DEFLATE_BGZF, 2},
+    };
+    QzSessionParams_T params;
+    QzStatus_T status;
+    TestArg_T *test_arg = (TestArg_T *)thd_arg;
+    const long tid = test_arg->thd_id;
+
+    rc = qzInit(&g_session_th[tid], test_arg->params->sw_backup);
+    if (rc != QZ_OK && rc != QZ_DUPLICATE && rc != QZ_NO_HW) {
+        pthread_exit((void *)"qzInit failed");
+    }
+
+    /* two chunks of zeros, one of 0xab, then compressible data */
+    src_sz = 4 * QZ_HW_BUFF_SZ;
+    src = qzMalloc(src_sz, 0, COMMON_MEM);
+    comp = qzMalloc(src_sz, 0, COMMON_MEM);
+    decomp = qzMalloc(src_sz, 0, COMMON_MEM);
+    if (!src || !comp || !decomp) {
+        QZ_ERROR("Malloc failed\n");
+        goto done;
+    }
+    memset(src, 0, 2 * QZ_HW_BUFF_SZ);
+    memset(src + 2 * QZ_HW_BUFF_SZ, 0xab, QZ_HW_BUFF_SZ);
+    genRandomData(src + 3 * QZ_HW_BUFF_SZ, QZ_HW_BUFF_SZ);
+
+    for (i = 0; i < ARRAY_LEN(cases); i++) {
+        qzGetDefaults(&params);
+        params.data_fmt = cases[i].data_fmt;
+        rc = qzSetupSession(&g_session_th[tid], &params);
+        if (rc != QZ_OK && rc != QZ_NO_INST_ATTACH && rc != QZ_NO_HW) {
+            pthread_exit((void *)"qzSetupSession failed");
+        }
+        len = src_sz;
+        comp_sz = src_sz;
+        rc = qzCompress(&g_session_th[tid], src, &len, comp, &comp_sz, 1);
+        if (rc != QZ_OK || len != src_sz) {
+            QZ_ERROR("qzCompress FAILED, return: %d\n", rc);
+            pthread_exit((void *)"qzUniformChunkTest failed");
+        }
+        (void)qzGetStatus(&g_session_th[tid], &status);
+        if (status.chunks_uniform != cases[i].uniform_cnt) {
+            QZ_ERROR("ERROR: fmt %d, %lu uniform chunks\n", cases[i].data_fmt,
+                     status.chunks_uniform);
+            pthread_exit((void *)"qzUniformChunkTest failed");
+        }
+
+        decomp_sz = src_sz;
+        rc = qzDecompress(&g_session_th[tid], comp, &comp_sz, decomp,
+                          &decomp_sz);
+        if (rc != QZ_OK || decomp_sz != src_sz ||
+            memcmp(src, decomp, src_sz)) {
+            QZ_ERROR("ERROR: fmt %d decompress rc %d, %u bytes\n",
+                     cases[i].data_fmt, rc, decomp_sz);
+            pthread_exit((void *)"qzUniformChunkTest failed");
+        }
+        (void)qzTeardownSession(&g_session_th[tid]);
+    }
+    QZ_PRINT("qzUniformChunkTest : PASS\n");
+
+done:
+    qzFree(src);
+    qzFree(comp);
+    qzFree(decomp);
+    (void)qzTeardownSession(&g_session_th[tid]);
+    pthread_exit((void *)NULL);
+}
+
+#define STR_INTER(N)    #N
+#define STR(N) STR_INTER(N)
+
+#define USAGE_STRING(MAX_LVL)                                                   \
+    "Usage: %s [options]\n"                                                     \
+    "\n"                                                                        \
+    "Required options:\n"                                                       \
+    "\n"                                                                        \
+    "    -m testMode           1 test memcpy feature\n"                         \
+    "                          2 test Memory\n"                                 \
+    "                          3 test comp/decomp by default parameters\n"      \
+    "                          4 test comp/decomp by configurable parameters\n" \
+    "                          5 test comp/decomp by format parameters\n"       \
+    "                          6 test set default configurable parameters\n"    \
+    "\n"                                                                        \
+    "Optional options can be:\n"                                                \
+    "\n"                                                                        \
+    "    -i inputfile          input source file\n"                             \
+    "                          default by random generate data \n"              \
+    "    -t thread_count       maximum forks permitted in the current thread\n" \
+    "                          0 means no forking permitted. \n"                \
+    "    -l loop count         default is 2\n"                                  \
+    "    -v                    verify, disabled by default\n"                   \
+    "    -e init engine        enable | disable. enabled by default\n"          \
+    "    -s init session       enable | disable. enabled by default\n"          \
+    "    -A comp_algorithm     deflate\n"                                       \
+    "    -B swBack             0 means disable sw\n"                            \
+    "                          1 means enable sw\n"                             \
+    "    -C hw_buff_sz         default 64K\n"                                   \
+    "    -D direction          comp | decomp | both\n"                          \
+    "    -F format             [comp format]:[orig data size]/...\n"            \
+    "    -L comp_lvl           1 - " STR(MAX_LVL) "\n"                          \
+    "    -O data_fmt           deflate | gzip | gzipext | deflate_4B |\n"       \
+    "                          zlib | bgzf\n"                                   \
+    "    -T huffmanType        static | dynamic | auto\n"                       \
+    "    -r req_cnt_thrshold   max inflight request num, default is 16\n"       \
+    "    -S thread_sleep       the unit is milliseconds, default is a random time\n"       \
+    "    -P polling            set polling mode, default is periodical polling\n" \
+    "    -h                    Print this help message\n"
+
+void qzPrintUsageAndExit(char *progName)
+{
+    QZ_ERROR(USAGE_STRING(QZ_DEFLATE_COMP_LVL_MAXIMUM), progName);
+    exit(-1);
+}
+
+static int qz_do_g_process_Check(void)
+{
+    if (g_process.qz_init_status == QZ_OK &&
+        g_process.sw_backup == 1 &&
+        (g_process.num_instances == 12 || g_process.num_instances == 4 ||
+        g_process.num_instances == 32) &&
+        g_process.qat_available == CPA_TRUE) {
+        return QZ_OK;
+    } else {
+        return QZ_FAIL;
+    }
+
+}
+
+int main(int argc, char *argv[])
+{
+    int rc = 0, ret = 0, rc_check = 0;
+    int i = 0;
+    void *p_rc;
+    int thread_count = 1, test = 0;
+    ServiceType_T service = COMP;
+    pthread_t threads[100];
+    TestArg_T test_arg[100];
+    struct sigaction s1;
+
+    unsigned char *input_buf = NULL;
+    unsigned int input_buf_len = QATZIP_MAX_HW_SZ;
+
+    int thread_sleep = 0;
+
+    s1.sa_handler = sigInt;
+    sigemptyset(&s1.sa_mask);
+    s1.sa_flags = 0;
+    sigaction(SIGINT, &s1, NULL);
+
+    const char *optstring = "m:t:A:C:D:F:L:T:i:l:e:s:r:B:O:S:P:vh";
+    int opt = 0, loop_cnt = 2, verify = 0;
+    int disable_init_engine = 0, disable_init_session = 0;
+    char *stop = NULL;
+    QzThdOps *qzThdOps = NULL;
+    QzBlock_T  *qzBlocks = NULL;
+    errno = 0;
+
+    if (qzGetDefaults(&g_params_th) != QZ_OK) {
+        return -1;
+    }
+
+    while ((opt = getopt(argc, argv, optstring)) != -1) {
+        switch (opt) {
+        case 'm': // test case
+            test = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
+            if (*stop != '\0' || errno) {
+                QZ_ERROR("Error input: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 't':
+            thread_count = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
+            g_params_th.max_forks = thread_count;
+            if (*stop != '\0' || errno || g_params_th.max_forks > 100) {
+                QZ_ERROR("Error thread count arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'A':
+            if (strcmp(optarg, "deflate") == 0) {
+                g_params_th.comp_algorithm = QZ_DEFLATE;
+            } else {
+                QZ_ERROR("Error service arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'O':
+            if (strcmp(optarg, "deflate") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_RAW;
+            } else if (strcmp(optarg, "gzip") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_GZIP;
+            } else if (strcmp(optarg, "gzipext") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_GZIP_EXT;
+            } else if (strcmp(optarg, "deflate_4B") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_4B;
+            } else if (strcmp(optarg, "zlib") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_ZLIB;
+            } else if (strcmp(optarg, "bgzf") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_BGZF;
+            } else {
+                QZ_ERROR("Error service arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'B':
+            g_params_th.sw_backup = GET_LOWER_32BITS(strtol(optarg, &stop, 0));
+            if (*stop != '\0' || errno || (g_params_th.sw_backup != 0 &&
+                                           g_params_th.sw_backup != 1)) {
+                QZ_ERROR("Error input: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'C':
+            g_params_th.hw_buff_sz = GET_LOWER_32BITS(strtoul(optarg, &stop, 0));
+            if (*stop != '\0' || errno || g_params_th.hw_buff_sz > USDM_ALLOC_MAX_SZ / 2) {
                 QZ_ERROR("Error chunkSize arg: %s\n", optarg);
                 return -1;
             }
@@ -3791,6 +5441,8 @@ int main(int argc, char *argv[])
                 g_params_th.huffman_hdr = QZ_STATIC_HDR;
             } else if (strcmp(optarg, "dynamic") == 0) {
                 g_params_th.huffman_hdr = QZ_DYNAMIC_HDR;
+            } else if (strcmp(optarg, "auto") == 0) {
+                g_params_th.huffman_hdr = QZ_AUTO_HDR;
             } else {
                 QZ_ERROR("Error huffman arg: %s\n", optarg);
                 return -1;
@@ -3971,6 +5623,45 @@ int main(int argc, char *argv[])
     case 22:
         qzThdOps = qzDecompressStreamWithBufferError;
         break;
+    case 23:
+        qzThdOps = qzCompressStreamWithSyncFlush;
+        break;
+    case 24:
+        qzThdOps = qzStreamSmallStepBenchmark;
+        break;
+    case 25:
+        qzThdOps = qzCrc32Benchmark;
+        break;
+    case 26:
+        qzThdOps = qzGzipMemberScanTest;
+        break;
+    case 27:
+        qzThdOps = qzDeflate4BTest;
+        break;
+    case 28:
+        qzThdOps = qzZlibFormatTest;
+        break;
+    case 29:
+        qzThdOps = qzMemberIndexTest;
+        break;
+    case 30:
+        qzThdOps = qzBgzfTest;
+        break;
+    case 31:
+        qzThdOps = qzDecompressedSizeTest;
+        break;
+    case 32:
+        qzThdOps = qzDictionaryTest;
+        break;
+    case 33:
+        qzThdOps = qzEntropyStoreTest;
+        break;
+    case 34:
+        qzThdOps = qzAutoHuffmanTest;
+        break;
+    case 35:
+        qzThdOps = qzUniformChunkTest;
+        break;
     default:
         goto done;
     }
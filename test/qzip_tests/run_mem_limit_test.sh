@@ -0,0 +1,97 @@
+#! /bin/bash
+#***************************************************************************
+#
+#   BSD LICENSE
+#
+#   Copyright(c) 2007-2021 Intel Corporation. All rights reserved.
+#   All rights reserved.
+#
+#   Redistribution and use in source and binary forms, with or without
+#   modification, are permitted provided that the following conditions
+#   are met:
+#
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#       notice, this list of conditions and the following disclaimer in
+#       the documentation and/or other materials provided with the
+#       distribution.
+#     * Neither the name of Intel Corporation nor the names of its
+#       contributors may be used to endorse or promote products derived
+#       from this software without specific prior written permission.
+#
+#   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+#   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+#   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+#   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+#   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+#   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+#   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+#   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+#   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+#   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+#   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# qzip has to write the same bytes whatever its buffers are, so compress one
+# file with the default buffers, with --mem-limit, on the io_uring backend
+# and split over -T workers and compare the outputs.
+
+set -e
+echo "***QZ_ROOT run_mem_limit_test.sh start"
+
+QZIP=$QZ_ROOT/utils/qzip
+if [ ! -f "$QZIP" ]; then
+    echo "$QZIP: No such file. Compile first!"
+    exit 1
+fi
+
+WORK_DIR=`mktemp -d`
+trap 'rm -rf $WORK_DIR' EXIT
+
+#text and random data, 40MB
+seq 1 4000000 > $WORK_DIR/mix
+head -c 8000000 /dev/urandom >> $WORK_DIR/mix
+seq 1 1000000 >> $WORK_DIR/mix
+
+for fmt in gzip gzipext
+do
+    ref=""
+    for opts in "" "--mem-limit 4M" "--io uring" "--io uring --mem-limit 4M" \
+                "-T 3" "-T 3 --mem-limit 4M"
+    do
+        $QZIP -k -O $fmt $opts -o $WORK_DIR/out $WORK_DIR/mix > /dev/null
+        sum=`md5sum < $WORK_DIR/out.gz`
+        if [ -z "$ref" ]
+        then
+            ref=$sum
+        elif [ "$sum" != "$ref" ]
+        then
+            echo "-O $fmt $opts: output differs from the default"
+            exit 1
+        fi
+        $QZIP -d -k -o $WORK_DIR/plain $WORK_DIR/out.gz > /dev/null
+        cmp $WORK_DIR/plain $WORK_DIR/mix
+        rm -f $WORK_DIR/out.gz $WORK_DIR/plain
+    done
+    echo "-O $fmt: same output with all buffer sizes"
+done
+
+ref=""
+for opts in "" "--mem-limit 4M" "--io uring" "--io uring --mem-limit 4M"
+do
+    $QZIP -k -O 7z $opts -o $WORK_DIR/out.7z $WORK_DIR/mix > /dev/null
+    sum=`md5sum < $WORK_DIR/out.7z`
+    if [ -z "$ref" ]
+    then
+        ref=$sum
+    elif [ "$sum" != "$ref" ]
+    then
+        echo "-O 7z $opts: output differs from the default"
+        exit 1
+    fi
+    rm -f $WORK_DIR/out.7z
+done
+echo "-O 7z: same output with all buffer sizes"
+
+echo "***QZ_ROOT run_mem_limit_test.sh end"
@@ -44,13 +44,23 @@ int g_decompress = 0;        /* g_decompress (-d) */
 int g_keep = 0;                     /* keep (don't delete) input files */
 QzSession_T g_sess;
 QzSessionParams_T g_params_th = {(QzHuffmanHdr_T)0,};
-struct io_uring ring;
+__thread struct io_uring ring;      /* one ring per -T worker */
+int g_io_uring = -1;                /* file I/O through io_uring (--io),
+                                       -1: stdio for gz, io_uring for 7z */
+int g_direct = 0;                   /* O_DIRECT file I/O (--direct) */
+QzUringConf_T g_uring_conf = {0, 0, -1};
+int g_bench = 0;                    /* compare io_uring setups (--bench) */
+unsigned int g_threads = 1;         /* file workers (-T) */
+unsigned long g_mem_limit = 0;      /* buffer bytes per process (--mem-limit) */
+static QzipPool_T g_pool;
+/* -T workers print the statistics of a file as one block */
+static pthread_mutex_t g_print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Estimate maximum data expansion after decompression */
 const unsigned int g_bufsz_expansion_ratio[] = {5, 20, 50, 100};
 
 /* Command line options*/
-char const g_short_opts[] = "A:H:L:C:r:o:O:P:dfhkVR";
+char const g_short_opts[] = "A:H:L:C:r:o:O:P:T:dfhkVR";
 const struct option g_long_opts[] = {
     /* { name  has_arg  *flag  val } */
     {"decompress", 0, 0, 'd'}, /* decompress */
@@ -63,11 +73,22 @@ const struct option g_long_opts[] = {
     {"huffmanhdr", 1, 0, 'H'}, /* set huffman header type */
     {"level",      1, 0, 'L'}, /* set compression level */
     {"chunksz",    1, 0, 'C'}, /* set chunk size */
-    {"output",     1, 0, 'O'}, /* set output header format(gzip, gzipext, 7z)*/
+    {"output",     1, 0, 'O'}, /* set output header format(gzip, gzipext,
+                                  bgzf, 7z)*/
+    {"gzi",        0, 0, 'G'}, /* write a .gzi index next to bgzf output */
     {"recursive",  0, 0, 'R'}, /* set recursive mode when compressing a
                                   directory */
     {"polling",    1, 0, 'P'}, /* set polling mode when compressing and
                                   decompressing */
+    {"io",         1, 0, 'I'}, /* set file I/O backend(stdio, uring) */
+    {"direct",     0, 0, 'D'}, /* bypass the page cache with O_DIRECT */
+    {"ring-size",  1, 0, 'S'}, /* set io_uring SQ entries */
+    {"sqpoll",     2, 0, 'Q'}, /* IORING_SETUP_SQPOLL, optional CPU */
+    {"coop-taskrun", 0, 0, 'U'}, /* IORING_SETUP_COOP_TASKRUN and
+                                    SINGLE_ISSUER */
+    {"bench",      0, 0, 'B'}, /* report syscalls/GB per io_uring setup */
+    {"threads",    1, 0, 'T'}, /* set number of file workers */
+    {"mem-limit",  1, 0, 'M'}, /* bound the data buffers */
     { 0, 0, 0, 0 }
 };
 
@@ -92,16 +113,28 @@ void help(void)
         "  -d, --decompress  decompress",
         "  -f, --force       force overwrite of output file and compress links",
         "  -h, --help        give this help",
-        "  -H, --huffmanhdr  set huffman header type",
+        "  -H, --huffmanhdr  set huffman header type(static|dynamic|auto)",
         "  -k, --keep        keep (don't delete) input files",
         "  -V, --version     display version number",
         "  -L, --level       set compression level",
         "  -C, --chunksz     set chunk size",
-        "  -O, --output      set output header format(gzip|gzipext|7z)",
+        "  -O, --output      set output header format(gzip|gzipext|bgzf|7z)",
+        "      --gzi         write FILE.gz.gzi index, bgzf output only",
         "  -r,               set max inflight request number",
         "  -R,               set Recursive mode for a directory",
+        "  -T, --threads     set number of files processed in parallel",
         "  -o,               set output file name",
         "  -P, --polling     set polling mode, only supports busy polling settings",
+        "      --io          set file I/O backend(stdio|uring), default stdio,",
+        "                    uring for 7z compression",
+        "      --direct      use O_DIRECT for file I/O, io_uring only",
+        "      --ring-size   set io_uring SQ entries, default sized from the",
+        "                    pipeline depth",
+        "      --sqpoll[=CPU] submit from a kernel thread, bound to CPU if given",
+        "      --coop-taskrun set io_uring COOP_TASKRUN and SINGLE_ISSUER",
+        "      --bench       compress FILEs once per io_uring setup and report",
+        "                    io_uring_enter calls per GB",
+        "      --mem-limit   bound the data buffers to SIZE[K|M|G] bytes",
         "",
         "With no FILE, read standard input.",
         0
@@ -159,11 +192,63 @@ void displayStats(RunTimeList_T *time_list,
     }
 }
 
+/* Buffers hold whole members, all of these are powers of 2 */
+static unsigned long qzipBuffUnit(void)
+{
+    unsigned long unit = QZIP_MEMBER_SZ;
+
+    if (g_params_th.hw_buff_sz > unit) {
+        unit = g_params_th.hw_buff_sz;
+    }
+    if (g_direct && QZ_DIRECT_ALIGN > unit) {
+        unit = QZ_DIRECT_ALIGN;
+    }
+    return unit;
+}
+
+/*
+ * Size of the buffers a file is read into when n_bufs of that size are held
+ * at once, input and output together. dflt without --mem-limit, otherwise
+ * whole members, see qzipMemberSize.
+ */
+unsigned int qzipBuffSize(unsigned int dflt, unsigned long n_bufs)
+{
+    unsigned long unit = qzipBuffUnit();
+    unsigned long sz;
+
+    if (0 == g_mem_limit) {
+        return dflt;
+    }
+    sz = g_mem_limit / n_bufs;
+    sz -= sz % unit;
+    if (sz < unit) {
+        sz = unit;
+    }
+    return (sz < dflt) ? sz : dflt;
+}
+
+/*
+ * Most input qzCompress may take at once, 0 for no limit. In software a
+ * gzip member ends with every call, so calls are cut at fixed offsets of
+ * the input and neither the buffer sizes, --io nor -T change the output.
+ * QAT ends a member every hw_buff_sz whatever the call, and BGZF and raw
+ * deflate don't end with a call.
+ */
+unsigned int qzipMemberSize(QzSession_T *sess)
+{
+    if (QZ_NO_HW != sess->hw_session_stat ||
+        (QZ_DEFLATE_GZIP != g_params_th.data_fmt &&
+         QZ_DEFLATE_GZIP_EXT != g_params_th.data_fmt)) {
+        return 0;
+    }
+    return qzipBuffUnit();
+}
+
 int doProcessBuffer(QzSession_T *sess,
                     unsigned char *src, unsigned int *src_len,
                     unsigned char *dst, unsigned int dst_len,
                     RunTimeList_T *time_list, FILE *dst_file,
-                    off_t *dst_file_size, int is_compress)
+                    off_t *dst_file_size, int is_compress, unsigned int last)
 {
     int ret = QZ_FAIL;
     unsigned int done = 0;
@@ -171,6 +256,7 @@ int doProcessBuffer(QzSession_T *sess,
     unsigned int buf_remaining = *src_len;
     unsigned int bytes_written = 0;
     unsigned int valid_dst_buf_len = dst_len;
+    unsigned int mbr_sz = is_compress ? qzipMemberSize(sess) : 0;
     RunTimeList_T *time_node = time_list;
 
 
@@ -189,7 +275,10 @@ int doProcessBuffer(QzSession_T *sess,
 
         /* Do actual work */
         if (is_compress) {
-            ret = qzCompress(sess, src, src_len, dst, &dst_len, 1);
+            if (mbr_sz && *src_len > mbr_sz) {
+                *src_len = mbr_sz;
+            }
+            ret = qzCompress(sess, src, src_len, dst, &dst_len, last);
             if (QZ_BUF_ERROR == ret && 0 == *src_len) {
                 done = 1;
             }
@@ -233,6 +322,176 @@ int doProcessBuffer(QzSession_T *sess,
     return ret;
 }
 
+/*
+ * Compress the data of slot. With crc set, the CRC32 of the input is
+ * accumulated in *crc as well.
+ */
+int doCompressSlot(QzSession_T *sess, QzUringSlot_T *slot,
+                   RunTimeList_T **time_node, unsigned long *crc)
+{
+    int ret = QZ_OK;
+    unsigned int consumed = 0;
+    unsigned int produced = 0;
+    unsigned int mbr_sz = qzipMemberSize(sess);
+    RunTimeList_T *run_time = calloc(1, sizeof(RunTimeList_T));
+    assert(NULL != run_time);
+    run_time->next = NULL;
+    (*time_node)->next = run_time;
+    *time_node = run_time;
+
+    gettimeofday(&run_time->time_s, NULL);
+
+    /* an empty slot still gets one call, an empty file is one member */
+    do {
+        unsigned int src_len = slot->src_len - consumed;
+        unsigned int dst_len = slot->dst_sz - produced;
+
+        if (mbr_sz && src_len > mbr_sz) {
+            src_len = mbr_sz;
+        }
+
+        if (crc) {
+            ret = qzCompressCrc(sess, slot->src + slot->head + consumed,
+                                &src_len, slot->dst + slot->dst_head + produced,
+                                &dst_len, slot->last, crc);
+        } else {
+            ret = qzCompress(sess, slot->src + slot->head + consumed,
+                             &src_len, slot->dst + slot->dst_head + produced,
+                             &dst_len, slot->last);
+        }
+        QZ_DEBUG("qzCompress returned: src_len=%u  dst_len=%u\n", src_len,
+                 dst_len);
+        if (ret != QZ_OK && ret != QZ_BUF_ERROR) {
+            QZ_ERROR("doCompressSlot:Compression failed with error: %d\n",
+                     ret);
+            break;
+        }
+        if (0 == src_len && 0 == dst_len && consumed < slot->src_len) {
+            QZ_ERROR("doCompressSlot:Compression made no progress\n");
+            ret = QZ_BUF_ERROR;
+            break;
+        }
+        consumed += src_len;
+        produced += dst_len;
+        ret = QZ_OK;
+    } while (consumed < slot->src_len);
+
+    gettimeofday(&run_time->time_e, NULL);
+    slot->dst_len = produced;
+    return ret;
+}
+
+/*
+ * Decompress in, which is the data of slot behind any tail carried from the
+ * previous chunk. The output is written out whenever it fills the slot,
+ * *left is what is left of in for the next chunk.
+ */
+static int doDecompressSlot(QzSession_T *sess, QzUringPipe_T *pipe,
+                            QzUringSlot_T *slot, unsigned char *in,
+                            unsigned int in_len, int dst_fd,
+                            RunTimeList_T **time_node, unsigned int *left)
+{
+    int ret = QZ_OK;
+    unsigned int consumed = 0;
+    unsigned int produced = 0;
+    RunTimeList_T *run_time = calloc(1, sizeof(RunTimeList_T));
+    assert(NULL != run_time);
+    run_time->next = NULL;
+    (*time_node)->next = run_time;
+    *time_node = run_time;
+
+    gettimeofday(&run_time->time_s, NULL);
+
+    while (consumed < in_len) {
+        unsigned int src_len = in_len - consumed;
+        unsigned int dst_len = slot->dst_sz - produced;
+
+        ret = qzDecompress(sess, in + consumed, &src_len,
+                           slot->dst + slot->dst_head + produced, &dst_len);
+        if (ret != QZ_OK &&
+            ret != QZ_BUF_ERROR &&
+            ret != QZ_DATA_ERROR) {
+            QZ_ERROR("doDecompressSlot:Decompression failed with error: "
+                     "%d\n", ret);
+            goto done;
+        }
+
+        consumed += src_len;
+        produced += dst_len;
+        if (src_len || dst_len) {
+            ret = QZ_OK;
+            continue;
+        }
+
+        if (produced) {
+            /* dst is full, the slot keeps its input while dst drains */
+            slot->dst_len = produced;
+            qzUringWrite(pipe, slot, dst_fd);
+            produced = 0;
+            while (QZ_SLOT_FREE != slot->state && !pipe->error) {
+                qzUringReap(pipe, 1);
+            }
+            if (pipe->error) {
+                ret = QZ_FAIL;
+                goto done;
+            }
+            slot->state = QZ_SLOT_READY;
+        } else if (QZ_DATA_ERROR == ret) {
+            QZ_ERROR("doDecompressSlot:corrupt data\n");
+            goto done;
+        } else {
+            /* an incomplete member, it goes on with the next chunk */
+            ret = QZ_OK;
+            break;
+        }
+    }
+
+    gettimeofday(&run_time->time_e, NULL);
+    slot->dst_len = produced;
+    qzUringWrite(pipe, slot, dst_fd);
+
+done:
+    *left = in_len - consumed;
+    return ret;
+}
+
+/* The .gzi of the BGZF file just compressed, as bgzip -i writes it */
+static int writeGziFile(QzSession_T *sess, const char *dst_file_name)
+{
+    int ret = ERROR;
+    unsigned long gzi_len = 0;
+    unsigned char *gzi = NULL;
+    char *gzi_name = NULL;
+    FILE *gzi_file = NULL;
+
+    if (QZ_OK != qzGetGziIndex(sess, NULL, &gzi_len)) {
+        QZ_ERROR("Fail to get the gzi index of %s\n", dst_file_name);
+        return ERROR;
+    }
+    gzi = malloc(gzi_len);
+    gzi_name = malloc(strlen(dst_file_name) + strlen(SUFFIX_GZI) + 1);
+    if (NULL == gzi || NULL == gzi_name ||
+        QZ_OK != qzGetGziIndex(sess, gzi, &gzi_len)) {
+        goto exit;
+    }
+    strcpy(gzi_name, dst_file_name);
+    strcat(gzi_name, SUFFIX_GZI);
+    gzi_file = fopen(gzi_name, "w");
+    if (NULL == gzi_file) {
+        perror(gzi_name);
+        goto exit;
+    }
+    if (fwrite(gzi, 1, gzi_len, gzi_file) == gzi_len) {
+        ret = OK;
+    }
+    fclose(gzi_file);
+
+exit:
+    free(gzi);
+    free(gzi_name);
+    return ret;
+}
+
 void doProcessFile(QzSession_T *sess, const char *src_file_name,
                    const char *dst_file_name, int is_compress)
 {
@@ -251,6 +510,8 @@ void doProcessFile(QzSession_T *sess, const char *src_file_name,
     const unsigned int ratio_limit =
         sizeof(g_bufsz_expansion_ratio) / sizeof(unsigned int);
     unsigned int read_more = 0;
+    unsigned int last = 1;
+    unsigned long orig_sz = 0;
     int src_fd = 0;
     RunTimeList_T *time_list_head = malloc(sizeof(RunTimeList_T));
     assert(NULL != time_list_head);
@@ -281,8 +542,11 @@ void doProcessFile(QzSession_T *sess, const char *src_file_name,
     } else {
         src_file_size = src_file_stat.st_size;
     }
-    src_buffer_size = (src_file_size > SRC_BUFF_LEN) ?
-                      SRC_BUFF_LEN : src_file_size;
+    src_buffer_size = qzipBuffSize(SRC_BUFF_LEN, is_compress ? 2 :
+                                   1 + g_bufsz_expansion_ratio[0]);
+    if (src_file_size < src_buffer_size) {
+        src_buffer_size = src_file_size;
+    }
     if (is_compress) {
         dst_buffer_size = qzMaxCompressedLength(src_buffer_size, sess);
     } else { /* decompress */
@@ -310,15 +574,30 @@ void doProcessFile(QzSession_T *sess, const char *src_file_name,
             bytes_read = fread(src_buffer, 1, src_buffer_size, src_file);
             QZ_PRINT("Reading input file %s (%u Bytes)\n", src_file_name,
                      bytes_read);
+            /* the whole file is in, size the output once instead of
+             * guessing an expansion ratio and retrying */
+            if (!is_compress && bytes_read == src_file_size &&
+                QZ_OK == qzGetDecompressedSize(sess, src_buffer, bytes_read,
+                                               &orig_sz) &&
+                orig_sz > 0 && orig_sz <= UINT_MAX) {
+                free(dst_buffer);
+                dst_buffer_size = orig_sz;
+                dst_buffer = malloc(dst_buffer_size);
+                assert(dst_buffer != NULL);
+            }
         } else {
             bytes_read = file_remaining;
         }
 
         puts((is_compress) ? "Compressing..." : "Decompressing...");
 
+        /* a BGZF file is one stream, its EOF block goes at the very end */
+        if (QZ_DEFLATE_BGZF == g_params_th.data_fmt) {
+            last = (file_remaining <= bytes_read);
+        }
         ret = doProcessBuffer(sess, src_buffer, &bytes_read, dst_buffer,
                               dst_buffer_size, time_list_head, dst_file,
-                              &dst_file_size, is_compress);
+                              &dst_file_size, is_compress, last);
 
         if (QZ_DATA_ERROR == ret || QZ_BUF_ERROR == ret) {
             bytes_processed += bytes_read;
@@ -364,7 +643,20 @@ void doProcessFile(QzSession_T *sess, const char *src_file_name,
         file_remaining -= bytes_read;
     } while (file_remaining > 0);
 
+    if (is_compress && QZ_DEFLATE_BGZF == g_params_th.data_fmt &&
+        1 == g_params_th.member_index) {
+        ret = writeGziFile(sess, dst_file_name);
+        if (OK != ret) {
+            goto exit;
+        }
+    }
+
+    pthread_mutex_lock(&g_print_lock);
+    if (g_threads > 1) {
+        QZ_PRINT("%s:\n", src_file_name);
+    }
     displayStats(time_list_head, src_file_size, dst_file_size, is_compress);
+    pthread_mutex_unlock(&g_print_lock);
 
 exit:
     freeTimeList(time_list_head);
@@ -380,6 +672,287 @@ exit:
     }
 }
 
+/*
+ * doProcessFile on the io_uring pipeline. Reads of the next chunks and
+ * writes of earlier output stay in flight while the current chunk is
+ * compressed or decompressed.
+ */
+void doProcessFileIoUring(QzSession_T *sess, const char *src_file_name,
+                          const char *dst_file_name, int is_compress)
+{
+    int ret = OK;
+    struct stat src_file_stat;
+    off_t src_file_size = 0, dst_file_size = 0;
+    off_t rd_off = 0;
+    unsigned long rd_seq = 0, cp_seq = 0, n_chunks;
+    unsigned int chunk_sz;
+    int src_fd = -1, dst_fd = -1;
+    QzUringPipe_T *pipe = NULL;
+    QzUringSlot_T *slot = NULL;
+    /* tail of the previous chunk, in the head room of the next slot or in
+     * carry when it outgrows that */
+    unsigned int tail = 0;
+    unsigned char *carry = NULL;
+    unsigned int carry_len = 0;
+    RunTimeList_T *time_list_head = malloc(sizeof(RunTimeList_T));
+    RunTimeList_T *time_node = time_list_head;
+    assert(NULL != time_list_head);
+    gettimeofday(&time_list_head->time_s, NULL);
+    time_list_head->time_e = time_list_head->time_s;
+    time_list_head->next = NULL;
+
+    src_fd = qzUringOpen(src_file_name, O_RDONLY, 0);
+    if (src_fd < 0 || fstat(src_fd, &src_file_stat)) {
+        perror(src_file_name);
+        exit(ERROR);
+    }
+
+    if (S_ISBLK(src_file_stat.st_mode)) {
+        if (ioctl(src_fd, BLKGETSIZE, &src_file_size) < 0) {
+            close(src_fd);
+            perror(src_file_name);
+            exit(ERROR);
+        }
+        /* size get via BLKGETSIZE is divided by 512 */
+        src_file_size *= 512;
+    } else {
+        src_file_size = src_file_stat.st_size;
+    }
+
+    dst_fd = qzUringOpen(dst_file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (dst_fd < 0) {
+        perror(dst_file_name);
+        exit(ERROR);
+    }
+
+    /* the pipelines of all -T workers share --mem-limit */
+    chunk_sz = qzipBuffSize(QZ_URING_CHUNK_SZ, QZ_URING_DEPTH_DEFAULT *
+                            (is_compress ? 2 : 2 + g_bufsz_expansion_ratio[0]) *
+                            (g_pool.n_threads ? g_pool.n_threads : 1));
+    if (is_compress) {
+        pipe = qzUringPipeCreate(&ring, QZ_URING_DEPTH_DEFAULT, chunk_sz,
+                                 qzMaxCompressedLength(chunk_sz, sess),
+                                 g_direct ? QZ_DIRECT_ALIGN : 0);
+    } else {
+        /* each slot keeps a chunk of head room for a carried tail */
+        pipe = qzUringPipeCreate(&ring, QZ_URING_DEPTH_DEFAULT,
+                                 2 * chunk_sz, chunk_sz *
+                                 g_bufsz_expansion_ratio[0],
+                                 g_direct ? QZ_DIRECT_ALIGN : 0);
+    }
+    assert(NULL != pipe);
+    for (unsigned int i = 0; !is_compress && i < pipe->depth; i++) {
+        pipe->slots[i].head = chunk_sz;
+    }
+    qzUringRegisterFile(pipe, src_fd);
+    qzUringRegisterFile(pipe, dst_fd);
+
+    n_chunks = (src_file_size + chunk_sz - 1) / chunk_sz;
+    if (0 == n_chunks) {
+        n_chunks = 1;
+    }
+
+    QZ_PRINT("Reading input file %s (%lu Bytes)\n", src_file_name,
+             (unsigned long)src_file_size);
+    puts((is_compress) ? "Compressing..." : "Decompressing...");
+
+    while (cp_seq < n_chunks) {
+        /* keep every free slot reading ahead */
+        while (rd_seq < n_chunks &&
+               QZ_SLOT_FREE == pipe->slots[rd_seq % pipe->depth].state) {
+            unsigned int len = (src_file_size - rd_off > chunk_sz) ?
+                               chunk_sz : src_file_size - rd_off;
+            slot = &pipe->slots[rd_seq % pipe->depth];
+            slot->last = (rd_seq == n_chunks - 1);
+            qzUringRead(pipe, slot, src_fd, rd_off, len);
+            rd_off += len;
+            rd_seq++;
+        }
+
+        qzUringReap(pipe, 0);
+        if (pipe->error) {
+            ret = ERROR;
+            goto exit;
+        }
+
+        slot = &pipe->slots[cp_seq % pipe->depth];
+        if (QZ_SLOT_READY != slot->state) {
+            pipe->n_stall++;
+            qzUringReap(pipe, 1);
+            continue;
+        }
+        if (slot->src_len != slot->io_len) {
+            QZ_ERROR("Io_Uring read errors. short read of %s\n",
+                     src_file_name);
+            ret = ERROR;
+            goto exit;
+        }
+
+        if (is_compress) {
+            /* a BGZF file is one stream, its EOF block goes at the very end */
+            if (QZ_DEFLATE_BGZF != g_params_th.data_fmt) {
+                slot->last = 1;
+            }
+            if (QZ_OK != doCompressSlot(sess, slot, &time_node, NULL)) {
+                ret = ERROR;
+                goto exit;
+            }
+            qzUringWrite(pipe, slot, dst_fd);
+        } else {
+            unsigned char *in = slot->src + slot->head - tail;
+            unsigned int in_len = tail + slot->src_len;
+            unsigned int left = 0;
+            int last = slot->last;
+
+            if (carry_len) {
+                carry = realloc(carry, carry_len + slot->src_len);
+                assert(NULL != carry);
+                memcpy(carry + carry_len, slot->src + slot->head,
+                       slot->src_len);
+                in = carry;
+                in_len = carry_len + slot->src_len;
+            }
+
+            if (QZ_OK != doDecompressSlot(sess, pipe, slot, in, in_len,
+                                          dst_fd, &time_node, &left)) {
+                ret = ERROR;
+                goto exit;
+            }
+
+            tail = 0;
+            carry_len = 0;
+            if (left && last) {
+                QZ_ERROR("%s: unexpected end of file\n", src_file_name);
+                ret = ERROR;
+                goto exit;
+            } else if (left && in != carry && left <= chunk_sz) {
+                QzUringSlot_T *next = &pipe->slots[(cp_seq + 1) % pipe->depth];
+                memmove(next->src + next->head - left, in + in_len - left,
+                        left);
+                tail = left;
+            } else if (left) {
+                if (in != carry) {
+                    carry = realloc(carry, left);
+                    assert(NULL != carry);
+                }
+                memmove(carry, in + in_len - left, left);
+                carry_len = left;
+            }
+        }
+        cp_seq++;
+    }
+
+    if (qzUringFlush(pipe, dst_fd)) {
+        ret = ERROR;
+        goto exit;
+    }
+    dst_file_size = pipe->out_off;
+
+    if (is_compress && QZ_DEFLATE_BGZF == g_params_th.data_fmt &&
+        1 == g_params_th.member_index) {
+        ret = writeGziFile(sess, dst_file_name);
+        if (OK != ret) {
+            goto exit;
+        }
+    }
+
+    pthread_mutex_lock(&g_print_lock);
+    if (g_threads > 1) {
+        QZ_PRINT("%s:\n", src_file_name);
+    }
+    qzUringReport(pipe);
+    displayStats(time_list_head, src_file_size, dst_file_size, is_compress);
+    pthread_mutex_unlock(&g_print_lock);
+
+exit:
+    qzUringPipeDestroy(pipe);
+    freeTimeList(time_list_head);
+    free(carry);
+    close(src_fd);
+    close(dst_fd);
+    if (!g_keep && OK == ret) {
+        unlink(src_file_name);
+    }
+    if (ret) {
+        exit(ret);
+    }
+}
+
+/*
+ * Compress every file once per io_uring setup and report the
+ * io_uring_enter calls per GB of input. The outputs are removed again.
+ */
+int benchIoUring(QzSession_T *sess, int n, char **files)
+{
+    static const struct {
+        const char *name;
+        unsigned int flags;
+    } setups[] = {
+        {"default",      0},
+        {"coop-taskrun", IORING_SETUP_COOP_TASKRUN |
+                         IORING_SETUP_SINGLE_ISSUER},
+        {"sqpoll",       IORING_SETUP_SQPOLL},
+    };
+    const unsigned int n_setups = sizeof(setups) / sizeof(setups[0]);
+    double sec[sizeof(setups) / sizeof(setups[0])];
+    unsigned long enters[sizeof(setups) / sizeof(setups[0])];
+    unsigned int applied[sizeof(setups) / sizeof(setups[0])];
+    char out_name[MAX_PATH_LEN];
+    struct timeval time_s, time_e;
+    struct stat file_stat;
+    double bytes = 0;
+
+    for (int j = 0; j < n; j++) {
+        if (stat(files[j], &file_stat) || !S_ISREG(file_stat.st_mode)) {
+            QZ_ERROR("%s: --bench takes regular files\n", files[j]);
+            return ERROR;
+        }
+        bytes += file_stat.st_size;
+    }
+    if (0 == bytes) {
+        QZ_ERROR("--bench needs some input\n");
+        return ERROR;
+    }
+
+    g_keep = 1;
+    for (unsigned int i = 0; i < n_setups; i++) {
+        QzUringConf_T conf = g_uring_conf;
+        unsigned long enter_start;
+
+        conf.flags = setups[i].flags;
+        if (qzUringSetup(&ring, &conf)) {
+            return ERROR;
+        }
+        applied[i] = conf.flags;
+
+        QZ_PRINT("\n== io_uring setup %s ==\n", setups[i].name);
+        enter_start = qzUringEnterCount();
+        gettimeofday(&time_s, NULL);
+        for (int j = 0; j < n; j++) {
+            snprintf(out_name, sizeof(out_name), "%s.bench%s", files[j],
+                     SUFFIX_GZ);
+            doProcessFileIoUring(sess, files[j], out_name, 1);
+            unlink(out_name);
+        }
+        gettimeofday(&time_e, NULL);
+        io_uring_queue_exit(&ring);
+
+        sec[i] = (time_e.tv_sec - time_s.tv_sec) +
+                 (time_e.tv_usec - time_s.tv_usec) / 1000000.0;
+        enters[i] = qzUringEnterCount() - enter_start;
+    }
+
+    QZ_PRINT("\n%-14s %10s %15s %12s\n", "io_uring setup", "time(s)",
+             "io_uring_enter", "per GB");
+    for (unsigned int i = 0; i < n_setups; i++) {
+        QZ_PRINT("%-14s %10.3f %15lu %12.1f%s\n", setups[i].name, sec[i],
+                 enters[i], enters[i] / (bytes / 1000000000.0),
+                 (applied[i] != setups[i].flags) ? "  (refused, fell back)" :
+                 "");
+    }
+    return OK;
+}
+
 int qatzipSetup(QzSession_T *sess, QzSessionParams_T *params)
 {
     int status;
@@ -502,6 +1075,616 @@ void processDir(QzSession_T *sess, const char *in_name,
     }
 }
 
+/*
+ * Chunk size of -T on one file, whole members. It does not depend on -T,
+ * --mem-limit bounds the chunks in flight instead, at least two of them.
+ */
+static unsigned int splitChunkSize(void)
+{
+    return qzipBuffSize(QZ_URING_CHUNK_SZ, 4);
+}
+
+/*
+ * A single file is compressed by the -T workers if its members are
+ * independent and it has more than one chunk.
+ */
+static int canSplit(const char *in_name)
+{
+    struct stat fstat;
+
+    if (QZ_DEFLATE_GZIP != g_params_th.data_fmt &&
+        QZ_DEFLATE_GZIP_EXT != g_params_th.data_fmt) {
+        return 0;
+    }
+    if (stat(in_name, &fstat) || !S_ISREG(fstat.st_mode)) {
+        return 0;
+    }
+    return fstat.st_size > splitChunkSize();
+}
+
+/* Compress the chunks of split in order until the input ends */
+static void *splitWorker(void *arg)
+{
+    QzipSplit_T *split = (QzipSplit_T *)arg;
+    QzSession_T sess;
+    QzipChunk_T *chunk;
+    unsigned int consumed, src_len, dst_len;
+    unsigned int mbr_sz;
+
+    memset(&sess, 0, sizeof(sess));
+    if (qatzipSetup(&sess, &g_params_th)) {
+        exit(ERROR);
+    }
+    mbr_sz = qzipMemberSize(&sess);
+
+    for (;;) {
+        pthread_mutex_lock(&split->lock);
+        while (split->next == split->n_read && !split->eof) {
+            pthread_cond_wait(&split->read, &split->lock);
+        }
+        if (split->next == split->n_read) {
+            pthread_mutex_unlock(&split->lock);
+            break;
+        }
+        chunk = &split->chunks[split->next++ % split->n_chunks];
+        chunk->state = QZIP_CHUNK_BUSY;
+        pthread_mutex_unlock(&split->lock);
+
+        consumed = 0;
+        chunk->dst_len = 0;
+        do {
+            src_len = chunk->src_len - consumed;
+            if (mbr_sz && src_len > mbr_sz) {
+                src_len = mbr_sz;
+            }
+            dst_len = split->dst_sz - chunk->dst_len;
+            chunk->ret = qzCompress(&sess, chunk->src + consumed, &src_len,
+                                    chunk->dst + chunk->dst_len, &dst_len, 1);
+            if (QZ_OK == chunk->ret && 0 == src_len) {
+                chunk->ret = QZ_FAIL;
+            }
+            consumed += src_len;
+            chunk->dst_len += dst_len;
+        } while (QZ_OK == chunk->ret && consumed < chunk->src_len);
+
+        pthread_mutex_lock(&split->lock);
+        chunk->state = QZIP_CHUNK_DONE;
+        pthread_cond_broadcast(&split->done);
+        pthread_mutex_unlock(&split->lock);
+    }
+
+    /* qzClose would stop QAT for the whole process */
+    qzTeardownSession(&sess);
+    return NULL;
+}
+
+/*
+ * doProcessFile for compressing one file with -T: the calling thread reads
+ * chunks and writes their output in order while the workers compress.
+ */
+void doCompressFileSplit(QzSession_T *sess, const char *src_file_name,
+                         const char *dst_file_name)
+{
+    int ret = OK;
+    struct stat src_file_stat;
+    QzipSplit_T split;
+    QzipChunk_T *chunk;
+    pthread_t *threads = NULL;
+    unsigned int n_threads = 0;
+    unsigned long n_written = 0;
+    off_t dst_file_size = 0;
+    FILE *src_file = NULL;
+    FILE *dst_file = NULL;
+    RunTimeList_T *time_list_head = malloc(sizeof(RunTimeList_T));
+    assert(NULL != time_list_head);
+    gettimeofday(&time_list_head->time_s, NULL);
+    time_list_head->next = NULL;
+
+    ret = stat(src_file_name, &src_file_stat);
+    if (ret) {
+        perror(src_file_name);
+        exit(ERROR);
+    }
+
+    memset(&split, 0, sizeof(split));
+    split.chunk_sz = splitChunkSize();
+    split.dst_sz = qzMaxCompressedLength(split.chunk_sz, sess);
+    /* a chunk per worker, and as many read ahead or waiting to be written */
+    split.n_chunks = 2 * g_threads;
+    if (g_mem_limit &&
+        g_mem_limit / (2UL * split.chunk_sz) < split.n_chunks) {
+        split.n_chunks = g_mem_limit / (2UL * split.chunk_sz);
+        if (split.n_chunks < 2) {
+            split.n_chunks = 2;
+        }
+    }
+    split.chunks = calloc(split.n_chunks, sizeof(QzipChunk_T));
+    assert(NULL != split.chunks);
+    for (unsigned int i = 0; i < split.n_chunks; i++) {
+        split.chunks[i].src = malloc(split.chunk_sz);
+        split.chunks[i].dst = malloc(split.dst_sz);
+        assert(NULL != split.chunks[i].src && NULL != split.chunks[i].dst);
+    }
+    pthread_mutex_init(&split.lock, NULL);
+    pthread_cond_init(&split.read, NULL);
+    pthread_cond_init(&split.done, NULL);
+
+    src_file = fopen(src_file_name, "r");
+    assert(src_file != NULL);
+    dst_file = fopen(dst_file_name, "w");
+    assert(dst_file != NULL);
+
+    QZ_PRINT("Reading input file %s (%lld Bytes)\n", src_file_name,
+             (long long)src_file_stat.st_size);
+    puts("Compressing...");
+
+    threads = calloc(g_threads, sizeof(pthread_t));
+    assert(NULL != threads);
+    for (; n_threads < g_threads; n_threads++) {
+        if (pthread_create(&threads[n_threads], NULL, splitWorker, &split)) {
+            QZ_ERROR("Cannot create worker thread\n");
+            ret = ERROR;
+            goto exit;
+        }
+    }
+
+    while (OK == ret) {
+        pthread_mutex_lock(&split.lock);
+        /* keep the window full */
+        while (!split.eof && split.n_read - n_written < split.n_chunks) {
+            chunk = &split.chunks[split.n_read % split.n_chunks];
+            pthread_mutex_unlock(&split.lock);
+            chunk->src_len = fread(chunk->src, 1, split.chunk_sz, src_file);
+            pthread_mutex_lock(&split.lock);
+            if (chunk->src_len) {
+                chunk->state = QZIP_CHUNK_READ;
+                split.n_read++;
+            }
+            if (chunk->src_len < split.chunk_sz) {
+                split.eof = 1;
+            }
+            pthread_cond_broadcast(&split.read);
+        }
+        if (n_written == split.n_read) {
+            pthread_mutex_unlock(&split.lock);
+            break;
+        }
+        chunk = &split.chunks[n_written % split.n_chunks];
+        while (QZIP_CHUNK_DONE != chunk->state) {
+            pthread_cond_wait(&split.done, &split.lock);
+        }
+        pthread_mutex_unlock(&split.lock);
+
+        if (QZ_OK != chunk->ret) {
+            QZ_ERROR("Process file error: %d\n", chunk->ret);
+            ret = ERROR;
+        } else if (fwrite(chunk->dst, 1, chunk->dst_len, dst_file) !=
+                   chunk->dst_len) {
+            perror(dst_file_name);
+            ret = ERROR;
+        }
+        dst_file_size += chunk->dst_len;
+        chunk->state = QZIP_CHUNK_FREE;
+        n_written++;
+    }
+    if (ferror(src_file)) {
+        perror(src_file_name);
+        ret = ERROR;
+    }
+
+exit:
+    /* on error the workers finish the chunks already read */
+    pthread_mutex_lock(&split.lock);
+    split.eof = 1;
+    pthread_cond_broadcast(&split.read);
+    pthread_mutex_unlock(&split.lock);
+    for (unsigned int i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    gettimeofday(&time_list_head->time_e, NULL);
+
+    if (OK == ret) {
+        pthread_mutex_lock(&g_print_lock);
+        displayStats(time_list_head, src_file_stat.st_size, dst_file_size, 1);
+        pthread_mutex_unlock(&g_print_lock);
+    }
+
+    freeTimeList(time_list_head);
+    fclose(src_file);
+    fclose(dst_file);
+    for (unsigned int i = 0; i < split.n_chunks; i++) {
+        free(split.chunks[i].src);
+        free(split.chunks[i].dst);
+    }
+    free(split.chunks);
+    free(threads);
+    pthread_mutex_destroy(&split.lock);
+    pthread_cond_destroy(&split.read);
+    pthread_cond_destroy(&split.done);
+    if (!g_keep && OK == ret) {
+        unlink(src_file_name);
+    }
+    if (ret) {
+        exit(ret);
+    }
+}
+
+/*
+ * Group the members of a gzipext file into ranges of up to
+ * QZ_URING_CHUNK_SZ in and out, or less with --mem-limit. Fails if a
+ * member is not gzipext, the members of plain gzip can't be found
+ * without inflating them.
+ */
+static int splitMembers(QzipSplitDec_T *dec, off_t src_size)
+{
+    unsigned char buf[32];
+    QzGzH_T hdr;
+    QzipRange_T *range = NULL;
+    /* a range in and out per worker */
+    unsigned int range_sz = qzipBuffSize(QZ_URING_CHUNK_SZ, 2UL * g_threads);
+    unsigned long cap = 0;
+    unsigned long mbr_sz;
+    off_t off = 0, dst_off = 0;
+    ssize_t n;
+
+    while (off < src_size) {
+        n = pread(dec->src_fd, buf, sizeof(buf), off);
+        if (n < (ssize_t)sizeof(QzGzH_T)) {
+            return ERROR;
+        }
+        if (QZ_OK != qzGzipHeaderExt(buf, &hdr)) {
+            /* a member index ends the file and holds no data */
+            if (isMemberIndex(buf, n)) {
+                break;
+            }
+            return ERROR;
+        }
+        mbr_sz = sizeof(QzGzH_T) + (unsigned long)hdr.extra.qz_e.dest_sz +
+                 sizeof(StdGzF_T);
+        if (mbr_sz > UINT_MAX || off + (off_t)mbr_sz > src_size) {
+            return ERROR;
+        }
+
+        if (range && range->src_len + mbr_sz <= range_sz &&
+            range->dst_len + hdr.extra.qz_e.src_sz <= range_sz) {
+            range->src_len += mbr_sz;
+            range->dst_len += hdr.extra.qz_e.src_sz;
+        } else {
+            if (dec->n_ranges == cap) {
+                cap = cap ? 2 * cap : 64;
+                dec->ranges = realloc(dec->ranges, cap * sizeof(QzipRange_T));
+                assert(NULL != dec->ranges);
+            }
+            range = &dec->ranges[dec->n_ranges++];
+            range->src_off = off;
+            range->dst_off = dst_off;
+            range->src_len = mbr_sz;
+            range->dst_len = hdr.extra.qz_e.src_sz;
+        }
+        if (range->src_len > dec->src_max) {
+            dec->src_max = range->src_len;
+        }
+        if (range->dst_len > dec->dst_max) {
+            dec->dst_max = range->dst_len;
+        }
+        off += mbr_sz;
+        dst_off += hdr.extra.qz_e.src_sz;
+    }
+
+    return (dec->n_ranges > 1) ? OK : ERROR;
+}
+
+static int decompressRange(QzSession_T *sess, QzipSplitDec_T *dec,
+                           const QzipRange_T *range,
+                           unsigned char *src, unsigned char *dst)
+{
+    int ret;
+    unsigned int in_done = 0, out_done = 0;
+    unsigned int src_len, dst_len;
+    ssize_t n;
+
+    if (pread(dec->src_fd, src, range->src_len, range->src_off) !=
+        (ssize_t)range->src_len) {
+        QZ_ERROR("Cannot read %u Bytes at offset %lld\n", range->src_len,
+                 (long long)range->src_off);
+        return ERROR;
+    }
+
+    while (in_done < range->src_len) {
+        src_len = range->src_len - in_done;
+        dst_len = dec->dst_max - out_done;
+        /* a corrupt member can leave less than a header behind */
+        if (src_len < sizeof(QzGzH_T)) {
+            ret = QZ_DATA_ERROR;
+        } else {
+            ret = qzDecompress(sess, src + in_done, &src_len, dst + out_done,
+                               &dst_len);
+        }
+        if (QZ_OK == ret && 0 == src_len) {
+            ret = QZ_DATA_ERROR;
+        }
+        if (QZ_OK != ret) {
+            QZ_ERROR("Process file error: %d\n", ret);
+            return ERROR;
+        }
+        in_done += src_len;
+        out_done += dst_len;
+    }
+    if (out_done != range->dst_len) {
+        QZ_ERROR("Member at offset %lld decompressed to %u instead of %u "
+                 "Bytes\n", (long long)range->src_off, out_done,
+                 range->dst_len);
+        return ERROR;
+    }
+
+    for (out_done = 0; out_done < range->dst_len; out_done += n) {
+        n = pwrite(dec->dst_fd, dst + out_done, range->dst_len - out_done,
+                   range->dst_off + out_done);
+        if (n < 0) {
+            perror("pwrite");
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+/* Decompress ranges of dec until all are taken or one failed */
+static void *splitDecWorker(void *arg)
+{
+    QzipSplitDec_T *dec = (QzipSplitDec_T *)arg;
+    QzSession_T sess;
+    const QzipRange_T *range;
+    unsigned char *src = malloc(dec->src_max);
+    unsigned char *dst = malloc(dec->dst_max);
+
+    assert(NULL != src && NULL != dst);
+    memset(&sess, 0, sizeof(sess));
+    if (qatzipSetup(&sess, &g_params_th)) {
+        exit(ERROR);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&dec->lock);
+        if (dec->error || dec->next == dec->n_ranges) {
+            pthread_mutex_unlock(&dec->lock);
+            break;
+        }
+        range = &dec->ranges[dec->next++];
+        pthread_mutex_unlock(&dec->lock);
+
+        if (OK != decompressRange(&sess, dec, range, src, dst)) {
+            pthread_mutex_lock(&dec->lock);
+            dec->error = 1;
+            pthread_mutex_unlock(&dec->lock);
+            break;
+        }
+    }
+
+    /* qzClose would stop QAT for the whole process */
+    qzTeardownSession(&sess);
+    free(src);
+    free(dst);
+    return NULL;
+}
+
+/*
+ * doProcessFile for decompressing one gzipext file with -T. Returns ERROR,
+ * before the output is created, if the file is not all gzipext members or
+ * has a single range, such a file is left to the serial path.
+ */
+int doDecompressFileSplit(const char *src_file_name,
+                          const char *dst_file_name)
+{
+    int ret = OK;
+    struct stat src_file_stat;
+    QzipSplitDec_T dec;
+    pthread_t *threads = NULL;
+    unsigned int n_threads = 0;
+    off_t dst_file_size;
+    RunTimeList_T *time_list_head = NULL;
+
+    memset(&dec, 0, sizeof(dec));
+    dec.src_fd = open(src_file_name, O_RDONLY);
+    if (dec.src_fd < 0 || fstat(dec.src_fd, &src_file_stat)) {
+        perror(src_file_name);
+        exit(ERROR);
+    }
+    if (!S_ISREG(src_file_stat.st_mode) ||
+        OK != splitMembers(&dec, src_file_stat.st_size)) {
+        close(dec.src_fd);
+        free(dec.ranges);
+        return ERROR;
+    }
+    dst_file_size = dec.ranges[dec.n_ranges - 1].dst_off +
+                    dec.ranges[dec.n_ranges - 1].dst_len;
+
+    dec.dst_fd = open(dst_file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (dec.dst_fd < 0) {
+        perror(dst_file_name);
+        exit(ERROR);
+    }
+    pthread_mutex_init(&dec.lock, NULL);
+
+    time_list_head = malloc(sizeof(RunTimeList_T));
+    assert(NULL != time_list_head);
+    gettimeofday(&time_list_head->time_s, NULL);
+    time_list_head->next = NULL;
+
+    QZ_PRINT("Reading input file %s (%lld Bytes)\n", src_file_name,
+             (long long)src_file_stat.st_size);
+    puts("Decompressing...");
+
+    threads = calloc(g_threads, sizeof(pthread_t));
+    assert(NULL != threads);
+    for (; n_threads < g_threads && n_threads < dec.n_ranges; n_threads++) {
+        if (pthread_create(&threads[n_threads], NULL, splitDecWorker, &dec)) {
+            QZ_ERROR("Cannot create worker thread\n");
+            pthread_mutex_lock(&dec.lock);
+            dec.error = 1;
+            pthread_mutex_unlock(&dec.lock);
+            break;
+        }
+    }
+    for (unsigned int i = 0; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    gettimeofday(&time_list_head->time_e, NULL);
+    if (dec.error) {
+        ret = ERROR;
+    }
+
+    if (OK == ret) {
+        pthread_mutex_lock(&g_print_lock);
+        displayStats(time_list_head, src_file_stat.st_size, dst_file_size, 0);
+        pthread_mutex_unlock(&g_print_lock);
+    }
+
+    freeTimeList(time_list_head);
+    close(dec.src_fd);
+    close(dec.dst_fd);
+    free(dec.ranges);
+    free(threads);
+    pthread_mutex_destroy(&dec.lock);
+    if (!g_keep && OK == ret) {
+        unlink(src_file_name);
+    }
+    if (ret) {
+        exit(ret);
+    }
+    return OK;
+}
+
+static void processRegularFile(QzSession_T *sess, const char *in_name,
+                               const char *out_name, int is_compress)
+{
+    if (g_threads > 1 && 0 == g_pool.n_threads && !g_direct) {
+        if (is_compress && canSplit(in_name)) {
+            doCompressFileSplit(sess, in_name, out_name);
+            return;
+        }
+        if (!is_compress && OK == doDecompressFileSplit(in_name, out_name)) {
+            return;
+        }
+    }
+
+    if (g_io_uring > 0) {
+        doProcessFileIoUring(sess, in_name, out_name, is_compress);
+    } else {
+        doProcessFile(sess, in_name, out_name, is_compress);
+    }
+}
+
+/*
+ * A -T worker, with a session and ring of its own, takes files off the
+ * queue until qzipPoolFinish closes it.
+ */
+static void *poolWorker(void *arg)
+{
+    QzipPool_T *pool = (QzipPool_T *)arg;
+    QzUringConf_T conf = g_uring_conf;
+    QzSession_T sess;
+    QzipJob_T *job;
+
+    memset(&sess, 0, sizeof(sess));
+    if (qatzipSetup(&sess, &g_params_th)) {
+        exit(ERROR);
+    }
+    if (qzUringSetup(&ring, &conf)) {
+        exit(ERROR);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (NULL == pool->head && !pool->closing) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        job = pool->head;
+        if (job) {
+            pool->head = job->next;
+            if (NULL == pool->head) {
+                pool->tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (NULL == job) {
+            break;
+        }
+        processRegularFile(&sess, job->in_name, job->out_name,
+                           job->is_compress);
+        free(job->in_name);
+        free(job->out_name);
+        free(job);
+    }
+
+    io_uring_queue_exit(&ring);
+    /* qzClose would stop QAT for the whole process */
+    qzTeardownSession(&sess);
+    return NULL;
+}
+
+int qzipPoolStart(unsigned int n_threads)
+{
+    g_pool.threads = calloc(n_threads, sizeof(pthread_t));
+    if (NULL == g_pool.threads) {
+        return ERROR;
+    }
+    pthread_mutex_init(&g_pool.lock, NULL);
+    pthread_cond_init(&g_pool.cond, NULL);
+    g_pool.head = g_pool.tail = NULL;
+    g_pool.closing = 0;
+
+    for (g_pool.n_threads = 0; g_pool.n_threads < n_threads;
+         g_pool.n_threads++) {
+        if (pthread_create(&g_pool.threads[g_pool.n_threads], NULL,
+                           poolWorker, &g_pool)) {
+            QZ_ERROR("Cannot create worker thread\n");
+            qzipPoolFinish();
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+void qzipPoolAdd(const char *in_name, const char *out_name, int is_compress)
+{
+    QzipJob_T *job = calloc(1, sizeof(QzipJob_T));
+
+    assert(NULL != job);
+    job->in_name = strdup(in_name);
+    job->out_name = strdup(out_name);
+    assert(NULL != job->in_name && NULL != job->out_name);
+    job->is_compress = is_compress;
+
+    pthread_mutex_lock(&g_pool.lock);
+    if (g_pool.tail) {
+        g_pool.tail->next = job;
+    } else {
+        g_pool.head = job;
+    }
+    g_pool.tail = job;
+    pthread_cond_signal(&g_pool.cond);
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+/* Let the workers empty the queue and wait for them */
+void qzipPoolFinish(void)
+{
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.closing = 1;
+    pthread_cond_broadcast(&g_pool.cond);
+    pthread_mutex_unlock(&g_pool.lock);
+
+    for (unsigned int i = 0; i < g_pool.n_threads; i++) {
+        pthread_join(g_pool.threads[i], NULL);
+    }
+    free(g_pool.threads);
+    g_pool.threads = NULL;
+    g_pool.n_threads = 0;
+    pthread_mutex_destroy(&g_pool.lock);
+    pthread_cond_destroy(&g_pool.cond);
+}
+
 void processFile(QzSession_T *sess, const char *in_name,
                  const char *out_name, int is_compress)
 {
@@ -523,7 +1706,11 @@ void processFile(QzSession_T *sess, const char *in_name,
         if (makeOutName(in_name, out_name, oname, is_compress)) {
             return;
         }
-        doProcessFile(sess, in_name, oname, is_compress);
+        if (g_pool.n_threads) {
+            qzipPoolAdd(in_name, oname, is_compress);
+        } else {
+            processRegularFile(sess, in_name, oname, is_compress);
+        }
     }
 }
 
@@ -551,6 +1738,7 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
                    int is_compress)
 {
     int ret = OK;
+    size_t src_ring_size = 0;
     unsigned int src_buffer_size = 0;
     unsigned int dst_buffer_size = 0;
     off_t dst_file_size = 0;
@@ -561,6 +1749,7 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
     const unsigned int ratio_limit =
         sizeof(g_bufsz_expansion_ratio) / sizeof(unsigned int);
     unsigned int read_more = 0;
+    unsigned int last = 1;
     RunTimeList_T *time_list_head = malloc(sizeof(RunTimeList_T));
     assert(NULL != time_list_head);
     gettimeofday(&time_list_head->time_s, NULL);
@@ -568,8 +1757,10 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
     time_list_head->next = NULL;
     int pending_in = 0;
     int bytes_input = 0;
+    unsigned int src_offset = 0;
 
-    src_buffer_size = SRC_BUFF_LEN;
+    src_buffer_size = qzipBuffSize(SRC_BUFF_LEN, is_compress ? 2 :
+                                   1 + g_bufsz_expansion_ratio[0]);
     if (is_compress) {
         dst_buffer_size = qzMaxCompressedLength(src_buffer_size, sess);
     } else { /* decompress */
@@ -577,7 +1768,15 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
                           g_bufsz_expansion_ratio[ratio_idx++];
     }
 
-    src_buffer = malloc(src_buffer_size);
+    /* Mirrored ring, a partial member left by decompression stays in place
+     * and the next read is appended right behind it */
+    src_ring_size = src_buffer_size;
+    src_buffer = qzRingAlloc(&src_ring_size);
+    if (NULL == src_buffer) {
+        /* no ring, move the partial member to the front instead */
+        src_ring_size = 0;
+        src_buffer = malloc(src_buffer_size);
+    }
     assert(src_buffer != NULL);
     dst_buffer = malloc(dst_buffer_size);
     assert(dst_buffer != NULL);
@@ -585,7 +1784,7 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
     read_more = 1;
     while (!feof(stdin)) {
         if (read_more) {
-            bytes_read = fread(src_buffer + pending_in, 1,
+            bytes_read = fread(src_buffer + src_offset + pending_in, 1,
                                src_buffer_size - pending_in, src_file);
             if (0 == is_compress) {
                 bytes_read += pending_in;
@@ -594,9 +1793,12 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
             }
         }
 
-        ret = doProcessBuffer(sess, src_buffer, &bytes_read, dst_buffer,
-                              dst_buffer_size, time_list_head, dst_file,
-                              &dst_file_size, is_compress);
+        if (QZ_DEFLATE_BGZF == g_params_th.data_fmt) {
+            last = feof(src_file) ? 1 : 0;
+        }
+        ret = doProcessBuffer(sess, src_buffer + src_offset, &bytes_read,
+                              dst_buffer, dst_buffer_size, time_list_head,
+                              dst_file, &dst_file_size, is_compress, last);
 
         if (QZ_DATA_ERROR == ret || QZ_BUF_ERROR == ret) {
             if (!is_compress) {
@@ -604,9 +1806,10 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
             }
             bytes_processed += bytes_read;
             if (0 != bytes_read) {
-                if (!is_compress && pending_in > 0) {
-                    memmove(src_buffer, src_buffer + bytes_read,
-                            src_buffer_size - bytes_read);
+                if (!is_compress && pending_in > 0 && 0 != src_ring_size) {
+                    src_offset = (src_offset + bytes_read) % src_ring_size;
+                } else if (!is_compress && pending_in > 0) {
+                    memmove(src_buffer, src_buffer + bytes_read, pending_in);
                 }
                 read_more = 1;
             } else if (QZ_BUF_ERROR == ret) {
@@ -645,7 +1848,11 @@ void processStream(QzSession_T *sess, FILE *src_file, FILE *dst_file,
 
 exit:
     freeTimeList(time_list_head);
-    free(src_buffer);
+    if (0 != src_ring_size) {
+        qzRingFree(src_buffer, src_ring_size);
+    } else {
+        free(src_buffer);
+    }
     free(dst_buffer);
 
     if (ret) {
@@ -160,6 +160,7 @@
 #define MAX_PATH_LEN   1024 /* max pathname length */
 #define SUFFIX_GZ      ".gz"
 #define SUFFIX_7Z      ".7z"
+#define SUFFIX_GZI     ".gzi"
 
 typedef enum QzSuffix_E {
     E_SUFFIX_GZ,
@@ -297,7 +298,7 @@ typedef struct Qz7zFileItem_S {
     unsigned char   reserved[4]; /* 4byte */
     uint32_t        nameLength;  /* memory allocated length */
     size_t          size;        /* for file it's file's length*/
-    uint32_t        crc;
+    uint32_t        crc;         /* filled in while it is compressed */
     uint32_t        attribute;
     uint64_t        atime;
     uint32_t        atime_nano;
@@ -600,6 +601,224 @@ typedef struct WriteBuf_S {
     int size;
 } WriteBuf_T;
 
+/* io_uring pipeline slot states */
+#define QZ_SLOT_FREE                   0
+#define QZ_SLOT_READING                1
+#define QZ_SLOT_READY                  2
+#define QZ_SLOT_WRITING                3
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     One buffer pair of the io_uring pipeline
+ *
+ * @description
+ *     A slot owns a source and a destination buffer and holds at most one
+ *     read or write in flight. The slot address is the SQE user_data, so
+ *     completions are dispatched to it directly.
+ *
+ ******************************************************************************/
+typedef struct QzUringSlot_S {
+    unsigned char   *src;
+    unsigned char   *dst;
+    unsigned int    src_sz;      /* allocated size of src */
+    unsigned int    dst_sz;      /* allocated size of dst */
+    unsigned int    src_len;     /* bytes read into src */
+    unsigned int    dst_len;     /* bytes of output at dst + dst_head */
+    unsigned int    dst_head;    /* output starts behind the kept tail */
+    unsigned int    wr_start;    /* the write in flight starts here */
+    int             state;
+    int             fd;          /* fd of the I/O in flight */
+    off_t           off;         /* file offset of the I/O in flight */
+    unsigned int    io_len;      /* requested length of the I/O */
+    unsigned int    io_done;     /* bytes transferred so far */
+    unsigned int    head;        /* reads land at src + head */
+    int             buf_idx;     /* registered index of src, dst is next */
+    int             file_end;    /* last chunk of its source file */
+    int             last;        /* last chunk of the whole stream */
+} QzUringSlot_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     io_uring read/compress/write pipeline
+ *
+ * @description
+ *     Keeps up to depth slots in flight on one ring so reads of later
+ *     chunks and writes of earlier chunks overlap with compression.
+ *     Slot buffers and the files in use are registered with the ring when
+ *     the kernel allows it. A ring holds one such set at a time, so only
+ *     one pipeline may exist per ring.
+ *
+ ******************************************************************************/
+typedef struct QzUringPipe_S {
+    struct io_uring *ring;
+    QzUringSlot_T   *slots;
+    unsigned int    depth;
+    struct iovec    *iovecs;     /* registered buffers, NULL if refused */
+    int             *files;      /* registered file table, NULL if refused */
+    unsigned int    n_files;
+    unsigned int    align;       /* O_DIRECT alignment, 0 if buffered */
+    unsigned char   *tail;       /* unaligned output not written yet */
+    unsigned int    tail_len;
+    off_t           out_off;     /* file offset of the next write */
+    unsigned int    inflight;    /* SQEs submitted but not completed */
+    unsigned int    queued;      /* SQEs prepared but not submitted */
+    unsigned int    max_inflight;
+    unsigned long   depth_sum;   /* inflight summed over submits */
+    unsigned long   n_submit;
+    unsigned long   n_enter;     /* io_uring_enter calls made for it */
+    unsigned long   n_read;
+    unsigned long   n_write;
+    unsigned long   n_stall;     /* times the compressor waited for I/O */
+    int             error;
+} QzUringPipe_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     io_uring ring setup
+ *
+ * @description
+ *     Size and IORING_SETUP_* flags asked for on the command line. After
+ *     qzUringSetup flags holds the ones the kernel accepted.
+ *
+ ******************************************************************************/
+typedef struct QzUringConf_S {
+    unsigned int    entries;     /* SQ entries, 0 sizes it from the depth */
+    unsigned int    flags;       /* IORING_SETUP_* */
+    int             sq_cpu;      /* CPU of the SQPOLL thread, -1 for any */
+} QzUringConf_T;
+
+/* a file queued for the -T workers */
+typedef struct QzipJob_S {
+    char            *in_name;
+    char            *out_name;
+    int             is_compress;
+    struct QzipJob_S *next;
+} QzipJob_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     Worker pool of -T
+ *
+ * @description
+ *     processFile queues regular files here instead of processing them.
+ *     Every worker has its own session and io_uring ring and processes one
+ *     file at a time from the queue.
+ *
+ ******************************************************************************/
+typedef struct QzipPool_S {
+    pthread_t       *threads;
+    unsigned int    n_threads;   /* 0 while no pool is running */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;        /* a job was queued or the pool closes */
+    QzipJob_T       *head;
+    QzipJob_T       *tail;
+    int             closing;
+} QzipPool_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     One chunk of a file compressed by -T workers
+ *
+ * @description
+ *     A chunk goes FREE -> READ -> BUSY -> DONE -> FREE. Only the thread
+ *     that moved it to its current state touches the buffers.
+ *
+ ******************************************************************************/
+typedef enum QzipChunkState_E {
+    QZIP_CHUNK_FREE = 0,   /* the reader may fill it */
+    QZIP_CHUNK_READ,       /* holds input, waits for a worker */
+    QZIP_CHUNK_BUSY,       /* a worker compresses it */
+    QZIP_CHUNK_DONE        /* holds output, waits for its turn to be written */
+} QzipChunkState_T;
+
+typedef struct QzipChunk_S {
+    unsigned char    *src;
+    unsigned char    *dst;
+    unsigned int     src_len;
+    unsigned int     dst_len;
+    QzipChunkState_T state;
+    int              ret;
+} QzipChunk_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     Compression of one file by -T workers
+ *
+ * @description
+ *     The file is read into a fixed window of chunks. Chunk seq lives in
+ *     chunks[seq % n_chunks], workers take chunks in order of seq and the
+ *     output is written in order of seq, so at most n_chunks chunks are in
+ *     memory. Chunks end where the io_uring path ends a qzCompress call, so
+ *     the output is the same as without -T.
+ *
+ ******************************************************************************/
+typedef struct QzipSplit_S {
+    QzipChunk_T     *chunks;
+    unsigned int    n_chunks;
+    unsigned int    chunk_sz;    /* see splitChunkSize */
+    unsigned int    dst_sz;      /* compressed bound of chunk_sz */
+    pthread_mutex_t lock;
+    pthread_cond_t  read;        /* a chunk was read or the input ended */
+    pthread_cond_t  done;        /* a chunk was compressed */
+    unsigned long   n_read;      /* chunks read so far */
+    unsigned long   next;        /* next chunk for a worker */
+    int             eof;
+} QzipSplit_T;
+
+typedef struct QzipRange_S {
+    off_t        src_off;
+    off_t        dst_off;
+    unsigned int src_len;
+    unsigned int dst_len;
+} QzipRange_T;
+
+/**
+ ******************************************************************************
+ * @ingroup qatZip
+ *     Decompression of one gzipext file by -T workers
+ *
+ * @description
+ *     The members are grouped into ranges of whole members before any
+ *     output is written, their sizes are in the member headers. So every
+ *     range has a fixed place in the output, and a worker preads a range,
+ *     decompresses it with its own session and pwrites it there. Each
+ *     worker holds one range in memory at a time.
+ *
+ ******************************************************************************/
+typedef struct QzipSplitDec_S {
+    QzipRange_T     *ranges;
+    unsigned long   n_ranges;
+    unsigned long   next;        /* next range for a worker */
+    unsigned int    src_max;     /* longest range in and out, */
+    unsigned int    dst_max;     /* the size of the worker buffers */
+    int             src_fd;
+    int             dst_fd;
+    int             error;
+    pthread_mutex_t lock;
+} QzipSplitDec_T;
+
+#define QZIP_MAX_THREADS               256
+
+#define QZ_URING_DEPTH_DEFAULT         4
+#define QZ_URING_CHUNK_SZ              (8 * 1024 * 1024)
+#define QZ_DIRECT_ALIGN                4096
+/* input per gzip member compressed in software, see qzipMemberSize */
+#define QZIP_MEMBER_SZ                 QZ_HW_BUFF_MAX_SZ
+
+/* setup flags newer than some liburing headers */
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN      (1U << 8)
+#endif
+#ifndef IORING_SETUP_SINGLE_ISSUER
+#define IORING_SETUP_SINGLE_ISSUER     (1U << 12)
+#endif
+
 /* create a list return list head */
 QzListHead_T *qzListCreate(int num_per_node);
 
@@ -614,14 +833,12 @@ void qzListDestroy(QzListHead_T *head);
 
 /* create the file items list */
 Qz7zFileItem_T *fileItemCreate(char *pfilename);
-Qz7zFileItem_T *fileItemCreateIoUring(char *f, struct io_uring *ring_);
 
 /* destroy the items list */
 void itemListDestroy(Qz7zItemList_T *p);
 
 /* process the cmdline inputs */
 Qz7zItemList_T *itemListCreate(int n, char **files);
-Qz7zItemList_T *itemListCreateIoUring(int n, char **files, struct io_uring *ring_);
 
 
 /*
@@ -660,6 +877,30 @@ WriteBuf_T *generateWriteBuf(int size);
 void destroyIoUringFile(IoUringFile_T *fp);
 void destroyWriteBuf(WriteBuf_T *wb);
 
+/*
+ * io_uring pipeline functions
+ */
+QzUringPipe_T *qzUringPipeCreate(struct io_uring *ring_, unsigned int depth,
+                                 unsigned int src_sz, unsigned int dst_sz,
+                                 unsigned int align);
+void qzUringPipeDestroy(QzUringPipe_T *pipe);
+void qzUringRegisterFile(QzUringPipe_T *pipe, int fd);
+void qzUringUnregisterFile(QzUringPipe_T *pipe, int fd);
+void qzUringRead(QzUringPipe_T *pipe, QzUringSlot_T *slot, int fd,
+                 off_t off, unsigned int len);
+void qzUringWrite(QzUringPipe_T *pipe, QzUringSlot_T *slot, int fd);
+void qzUringOutStart(QzUringPipe_T *pipe, off_t off, const void *buf,
+                     unsigned int len);
+int qzUringFlush(QzUringPipe_T *pipe, int fd);
+void qzUringSetDirect(int fd, const char *file_name);
+int qzUringOpen(const char *file_name, int flags, mode_t mode);
+int qzUringSetup(struct io_uring *ring_, QzUringConf_T *conf);
+unsigned long qzUringEnterCount(void);
+int qzUringSubmit(QzUringPipe_T *pipe);
+int qzUringReap(QzUringPipe_T *pipe, int wait);
+int qzUringDrain(QzUringPipe_T *pipe);
+void qzUringReport(QzUringPipe_T *pipe);
+
 /*
  * write function
  */
@@ -779,10 +1020,24 @@ int doProcessBuffer(QzSession_T *sess,
                     unsigned char *src, unsigned int *src_len,
                     unsigned char *dst, unsigned int dst_len,
                     RunTimeList_T *time_list, FILE *dst_file,
-                    off_t *dst_file_size, int is_compress);
+                    off_t *dst_file_size, int is_compress, unsigned int last);
 
 void doProcessFile(QzSession_T *sess, const char *src_file_name,
                    const char *dst_file_name, int is_compress);
+void doProcessFileIoUring(QzSession_T *sess, const char *src_file_name,
+                          const char *dst_file_name, int is_compress);
+int doCompressSlot(QzSession_T *sess, QzUringSlot_T *slot,
+                   RunTimeList_T **time_node, unsigned long *crc);
+int benchIoUring(QzSession_T *sess, int n, char **files);
+unsigned int qzipBuffSize(unsigned int dflt, unsigned long n_bufs);
+unsigned int qzipMemberSize(QzSession_T *sess);
+void doCompressFileSplit(QzSession_T *sess, const char *src_file_name,
+                         const char *dst_file_name);
+int doDecompressFileSplit(const char *src_file_name,
+                          const char *dst_file_name);
+int qzipPoolStart(unsigned int n_threads);
+void qzipPoolAdd(const char *in_name, const char *out_name, int is_compress);
+void qzipPoolFinish(void);
 
 void processDir(QzSession_T *sess, const char *in_name,
                 const char *out_name, int is_compress);
@@ -813,6 +1068,12 @@ extern char const g_short_opts[];
 extern const struct option g_long_opts[];
 extern const unsigned int USDM_ALLOC_MAX_SZ;
 extern int errno;
-extern struct io_uring ring;
+extern __thread struct io_uring ring;
+extern int g_io_uring;
+extern int g_direct;
+extern QzUringConf_T g_uring_conf;
+extern int g_bench;
+extern unsigned int g_threads;
+extern unsigned long g_mem_limit;
 
 #endif
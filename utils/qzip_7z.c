@@ -97,6 +97,14 @@ time_t filetimeToUnixtime(FILETIME_T ft)
 #define writeByteIoUring(b, fp, crc) writeTagIoUring(b, fp, crc);
 
 static size_t bufWrite(const void *ptr, size_t size, size_t count, WriteBuf_T *wb) {
+    if (wb->off + size * count > wb->size) {
+        /* the end header grows with the number of files */
+        while (wb->off + size * count > wb->size) {
+            wb->size *= 2;
+        }
+        wb->buf = realloc(wb->buf, wb->size);
+        CHECK_ALLOC_RETURN_VALUE(wb->buf)
+    }
     memcpy(wb->buf + wb->off, ptr, size * count);
     wb->off += size * count;
     return size * count;
@@ -350,7 +358,8 @@ static ssize_t getIoUringResult(struct io_uring *ring_)
 {
     struct io_uring_cqe* cqe = NULL;
     ssize_t res = 0;
-    if(io_uring_submit(ring_) != 1) {
+    /* one io_uring_enter submits and waits */
+    if(io_uring_submit_and_wait(ring_, 1) != 1) {
         QZ_ERROR("Io_Uring sumbit failed\n");
         return -1;
     }
@@ -372,6 +381,7 @@ static int doCompressBuffer(QzSession_T *sess,
     unsigned int buf_remaining = *src_len;
     unsigned int bytes_written;
     unsigned int output_len = 0;
+    unsigned int dst_room = *dst_len;
     RunTimeList_T *time_node = time_list;
 
     while (time_node->next) {
@@ -387,7 +397,8 @@ static int doCompressBuffer(QzSession_T *sess,
 
         gettimeofday(&run_time->time_s, NULL);
 
-        /* do actual work */
+        /* do actual work, dst is written out after every call */
+        *dst_len = dst_room;
         ret = qzCompress(sess, src, src_len, dst, dst_len, last);
         if (QZ_BUF_ERROR == ret && 0 == *src_len) {
             done = 1;
@@ -426,74 +437,210 @@ static int doCompressBuffer(QzSession_T *sess,
     return ret;
 }
 
-static int doCompressBufferIoUring(QzSession_T *sess,
-                            unsigned char *src, unsigned int *src_len,
-                            unsigned char *dst, unsigned int *dst_len,
-                            RunTimeList_T *time_list, IoUringFile_T* dst_file,
-                            off_t *dst_file_size, int last, struct io_uring *ring_)
+/*
+ * get the size of a source file, block devices report it through ioctl
+ */
+static int getSourceSize(const char *file_name, off_t *size)
 {
-    int ret = QZ_FAIL;
-    unsigned int done = 0;
-    unsigned int buf_processed = 0;
-    unsigned int buf_remaining = *src_len;
-    ssize_t bytes_written;
-    unsigned int output_len = 0;
+    struct stat src_file_stat;
+    int src_fd;
+
+    if (lstat(file_name, &src_file_stat)) {
+        QZ_ERROR("stat(): failed\n");
+        return QZ7Z_ERR_STAT;
+    }
+
+    if (!S_ISBLK(src_file_stat.st_mode)) {
+        *size = src_file_stat.st_size;
+        return QZ7Z_OK;
+    }
+
+    if ((src_fd = open(file_name, O_RDONLY)) < 0) {
+        perror(file_name);
+        return QZ7Z_ERR_OPEN;
+    }
+    if (ioctl(src_fd, BLKGETSIZE, size) < 0) {
+        close(src_fd);
+        perror(file_name);
+        return QZ7Z_ERR_IOCTL;
+    }
+    /* size get via BLKGETSIZE is divided by 512 */
+    *size *= 512;
+    close(src_fd);
+    return QZ7Z_OK;
+}
+
+/*
+ * Compress all files of the list into one stream written at dst_file->off,
+ * behind the head_len bytes of head. Reads of the next chunks and the write
+ * of the previous chunk stay in flight on the ring while the current chunk
+ * is compressed.
+ */
+static int doCompressFilesPipelined(QzSession_T *sess, QzListHead_T *files,
+                                    IoUringFile_T *dst_file,
+                                    const unsigned char *head,
+                                    unsigned int head_len,
+                                    struct io_uring *ring_,
+                                    RunTimeList_T *time_list,
+                                    off_t *src_file_size,
+                                    off_t *dst_file_size)
+{
+    int ret = OK;
+    QzUringPipe_T *pipe = NULL;
+    QzUringSlot_T *slot = NULL;
+    Qz7zFileItem_T *cur_file = NULL;
     RunTimeList_T *time_node = time_list;
-    struct io_uring_sqe* sqe;
+    unsigned int n_files = files->total;
+    unsigned int rd_idx = 0;
+    unsigned int cp_idx = 0;
+    unsigned long crc = 0;
+    unsigned long rd_seq = 0;
+    unsigned long cp_seq = 0;
+    unsigned int chunk_sz = qzipBuffSize(QZ_URING_CHUNK_SZ,
+                                         2 * QZ_URING_DEPTH_DEFAULT);
+    int rd_fd = -1;
+    off_t rd_off = 0;
+    off_t rd_size = 0;
+    int done = 0;
 
     while (time_node->next) {
         time_node = time_node->next;
     }
 
+    pipe = qzUringPipeCreate(ring_, QZ_URING_DEPTH_DEFAULT, chunk_sz,
+                             qzMaxCompressedLength(chunk_sz, sess),
+                             g_direct ? QZ_DIRECT_ALIGN : 0);
+    if (!pipe) {
+        QZ_ERROR("Cannot allocate io_uring pipeline buffers\n");
+        return QZ7Z_ERR_OOM;
+    }
+    qzUringRegisterFile(pipe, dst_file->fd);
+    qzUringOutStart(pipe, dst_file->off, head, head_len);
+
     while (!done) {
-        RunTimeList_T *run_time = calloc(1, sizeof(RunTimeList_T));
-        CHECK_ALLOC_RETURN_VALUE(run_time)
-        run_time->next = NULL;
-        time_node->next = run_time;
-        time_node = run_time;
+        /* keep every free slot reading ahead of the compressor */
+        while (rd_idx < n_files &&
+               QZ_SLOT_FREE == pipe->slots[rd_seq % pipe->depth].state) {
+            unsigned int len;
+            slot = &pipe->slots[rd_seq % pipe->depth];
+
+            if (rd_fd < 0) {
+                cur_file = qzListGet(files, rd_idx);
+                ret = getSourceSize(cur_file->fileName, &rd_size);
+                if (ret) {
+                    goto exit;
+                }
+                rd_off = 0;
+                if (!cur_file->isSymLink &&
+                    (rd_fd = qzUringOpen(cur_file->fileName, O_RDONLY,
+                                         0)) < 0) {
+                    QZ_ERROR("create %s error\n", cur_file->fileName);
+                    ret = QZ7Z_ERR_OPEN;
+                    goto exit;
+                }
+                qzUringRegisterFile(pipe, rd_fd);
+                QZ_PRINT("Reading input file %s (%lu Bytes)\n",
+                         cur_file->fileName, (unsigned long)rd_size);
+            }
 
-        gettimeofday(&run_time->time_s, NULL);
+            len = (rd_size - rd_off > chunk_sz) ? chunk_sz : rd_size - rd_off;
+            slot->file_end = (rd_off + len == rd_size);
+            slot->last = slot->file_end && (rd_idx == n_files - 1);
 
-        /* do actual work */
-        ret = qzCompress(sess, src, src_len, dst, dst_len, last);
-        if (QZ_BUF_ERROR == ret && 0 == *src_len) {
-            done = 1;
+            if (cur_file->isSymLink) {
+                ssize_t size = readlink(cur_file->fileName,
+                                        (char *)slot->src, len);
+                if (size < 0) {
+                    perror(cur_file->fileName);
+                    ret = QZ7Z_ERR_READLINK;
+                    goto exit;
+                }
+                slot->fd = -1;
+                slot->io_len = len;
+                slot->src_len = size;
+                slot->state = QZ_SLOT_READY;
+            } else {
+                qzUringRead(pipe, slot, rd_fd, rd_off, len);
+            }
+
+            rd_off += len;
+            rd_seq++;
+            if (slot->file_end) {
+                /* the fd is closed once its last chunk is compressed */
+                rd_fd = -1;
+                rd_idx++;
+            }
         }
-        QZ_DEBUG("qzCompress returned: src_len=%u  dst_len=%u\n", *src_len,
-                 *dst_len);
 
-        if (ret != QZ_OK &&
-            ret != QZ_BUF_ERROR &&
-            ret != QZ_DATA_ERROR) {
-            QZ_ERROR("doCompressBuffer in qzip_7z.c :failed with error: %d\n",
-                     ret);
-            break;
+        qzUringReap(pipe, 0);
+        if (pipe->error) {
+            ret = ERROR;
+            goto exit;
         }
 
-        gettimeofday(&run_time->time_e, NULL);
+        slot = &pipe->slots[cp_seq % pipe->depth];
+        if (QZ_SLOT_FREE == slot->state) {
+            QZ_ERROR("io_uring pipeline has nothing to compress\n");
+            ret = QZ7Z_ERR_UNEXPECTED;
+            goto exit;
+        }
+        if (QZ_SLOT_READY != slot->state) {
+            /* the compressor caught up with the I/O */
+            pipe->n_stall++;
+            qzUringReap(pipe, 1);
+            continue;
+        }
 
-        sqe = io_uring_get_sqe(ring_);
-        CHECK_GET_SQE(sqe)
-        io_uring_prep_write(sqe, dst_file->fd, dst, *dst_len, dst_file->off);
-        bytes_written = getIoUringResult(ring_);
-        CHECK_IO_URING_WRITE_RETURN(bytes_written, *dst_len, "write compress")
-        *dst_file_size += bytes_written;
-        dst_file->off += bytes_written;
+        if (slot->src_len != slot->io_len) {
+            QZ_ERROR("Io_Uring read errors. short read\n");
+            ret = QZ7Z_ERR_READ_LESS;
+            goto exit;
+        }
+        if (slot->file_end && slot->fd >= 0) {
+            qzUringUnregisterFile(pipe, slot->fd);
+            close(slot->fd);
+            slot->fd = -1;
+        }
 
-        buf_processed += *src_len;
-        buf_remaining -= *src_len;
-        output_len += *dst_len;
-        if (0 == buf_remaining) {
-            done = 1;
+        /* the digests come from the data read for compression */
+        if (QZ_OK != doCompressSlot(sess, slot, &time_node, &crc)) {
+            ret = ERROR;
+            goto exit;
         }
-        src += *src_len;
-        QZ_DEBUG("src_len is %u ,buf_remaining is %u\n", *src_len,
-                 buf_remaining);
-        *src_len = buf_remaining;
+        if (slot->file_end) {
+            Qz7zFileItem_T *cp_file = qzListGet(files, cp_idx++);
+            cp_file->crc = crc;
+            crc = 0;
+        }
+        *src_file_size += slot->src_len;
+        *dst_file_size += slot->dst_len;
+
+        qzUringWrite(pipe, slot, dst_file->fd);
+        done = slot->last;
+        cp_seq++;
     }
 
-    *src_len = buf_processed;
-    *dst_len = output_len;
+exit:
+    if (OK == ret) {
+        ret = qzUringFlush(pipe, dst_file->fd);
+        dst_file->off = pipe->out_off;
+    } else {
+        qzUringDrain(pipe);
+    }
+    if (OK == ret) {
+        qzUringReport(pipe);
+    }
+    for (unsigned int i = 0; i < pipe->depth; i++) {
+        slot = &pipe->slots[i];
+        if (QZ_SLOT_READY == slot->state && slot->file_end &&
+            slot->fd >= 0) {
+            close(slot->fd);
+        }
+    }
+    if (rd_fd >= 0) {
+        close(rd_fd);
+    }
+    qzUringPipeDestroy(pipe);
     return ret;
 }
 
@@ -570,6 +717,8 @@ int doCompressFile(QzSession_T *sess, Qz7zItemList_T *list,
     struct stat src_file_stat;
     unsigned int src_buffer_size = 0;
     unsigned int dst_buffer_size = 0, dst_buffer_max_size = 0;
+    unsigned int dst_len = 0;
+    unsigned int buff_len = qzipBuffSize(SRC_BUFF_LEN, 2);
     off_t src_file_size = 0, dst_file_size = 0, file_remaining = 0;
     const char *src_file_name = NULL;
     unsigned char *src_buffer = NULL;
@@ -615,14 +764,14 @@ int doCompressFile(QzSession_T *sess, Qz7zItemList_T *list,
         goto exit;
     }
 
-    src_buffer = malloc(SRC_BUFF_LEN);
+    src_buffer = malloc(buff_len);
     if (!src_buffer) {
         QZ_DEBUG("malloc error\n");
         ret = QZ7Z_ERR_OOM;
         goto exit;
     }
 
-    dst_buffer_max_size = qzMaxCompressedLength(SRC_BUFF_LEN, sess);
+    dst_buffer_max_size = qzMaxCompressedLength(buff_len, sess);
     dst_buffer = malloc(dst_buffer_max_size);
     if (!src_buffer) {
         QZ_DEBUG("malloc error\n");
@@ -668,8 +817,8 @@ int doCompressFile(QzSession_T *sess, Qz7zItemList_T *list,
             } else {
                 src_file_size = src_file_stat.st_size;
             }
-            src_buffer_size = (src_file_size > SRC_BUFF_LEN) ?
-                              SRC_BUFF_LEN : src_file_size;
+            src_buffer_size = (src_file_size > buff_len) ?
+                              buff_len : src_file_size;
             dst_buffer_size = qzMaxCompressedLength(src_buffer_size, sess);
 
             src_file = fopen(src_file_name, "r");
@@ -682,8 +831,8 @@ int doCompressFile(QzSession_T *sess, Qz7zItemList_T *list,
             file_remaining = src_file_size;
             read_more = 1;
 
-            n_part = src_file_size / SRC_BUFF_LEN;
-            n_part = (src_file_size % SRC_BUFF_LEN) ? n_part + 1 : n_part;
+            n_part = src_file_size / buff_len;
+            n_part = (src_file_size % buff_len) ? n_part + 1 : n_part;
             is_last = 0;
             n_part_i = 1;
 
@@ -708,10 +857,14 @@ int doCompressFile(QzSession_T *sess, Qz7zItemList_T *list,
 
                 puts("Compressing...");
 
+                /* dst_len comes back as the bytes written */
+                dst_len = dst_buffer_size;
                 ret = doCompressBuffer(sess, src_buffer, &bytes_read,
-                                       dst_buffer, &dst_buffer_size,
+                                       dst_buffer, &dst_len,
                                        time_list_head, dst_file, &dst_file_size,
                                        is_last);
+                /* the digest comes from the data read for compression */
+                cur_file->crc = qzCrc32(cur_file->crc, src_buffer, bytes_read);
 
                 if (QZ_DATA_ERROR == ret || QZ_BUF_ERROR == ret) {
                     bytes_processed += bytes_read;
@@ -847,23 +1000,9 @@ int doCompressFileIoUring(QzSession_T *sess, Qz7zItemList_T *list,
                    const char *dst_file_name, struct io_uring *ring_)
 {
     int ret = OK;
-    struct stat src_file_stat;
-    unsigned int src_buffer_size = 0;
-    unsigned int dst_buffer_size = 0, dst_buffer_max_size = 0;
-    off_t src_file_size = 0, dst_file_size = 0, file_remaining = 0;
-    const char *src_file_name = NULL;
-    unsigned char *src_buffer = NULL;
-    unsigned char *dst_buffer = NULL;
-    IoUringFile_T *src_file = NULL;
+    off_t src_file_size = 0, dst_file_size = 0;
     IoUringFile_T *dst_file = NULL;
     Qz7zEndHeader_T *eheader = NULL;
-    unsigned int bytes_read = 0;
-    unsigned long bytes_processed = 0;
-    unsigned int ratio_idx = 0;
-    const unsigned int ratio_limit =
-        sizeof(g_bufsz_expansion_ratio) / sizeof(unsigned int);
-    unsigned int read_more = 0;
-    int src_fd = 0;
     uint64_t non_empty_number = 0;
     RunTimeList_T *time_list_head = malloc(sizeof(RunTimeList_T));
     Qz7zSignatureHeader_T *sheader = NULL;
@@ -881,9 +1020,6 @@ int doCompressFileIoUring(QzSession_T *sess, Qz7zItemList_T *list,
     time_list_head->next = NULL;
 
     size_t  total_compressed_size = 0;
-    int is_last;
-    int n_part; // how much parts can the src file be splited
-    int n_part_i;
 
 
     dst_file = generateIoUringFileWithMode(dst_file_name, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU | S_IRWXO);
@@ -900,177 +1036,39 @@ int doCompressFileIoUring(QzSession_T *sess, Qz7zItemList_T *list,
         goto exit;
     }
 
-    src_buffer = malloc(SRC_BUFF_LEN);
-    if (!src_buffer) {
-        QZ_DEBUG("malloc error\n");
-        ret = QZ7Z_ERR_OOM;
-        goto exit;
-    }
-
-    dst_buffer_max_size = qzMaxCompressedLength(SRC_BUFF_LEN, sess);
-    dst_buffer = malloc(dst_buffer_max_size);
-    if (!src_buffer) {
-        QZ_DEBUG("malloc error\n");
-        ret = QZ7Z_ERR_OOM;
-        goto exit;
-    }
-
     uint64_t sheader_size;
     ssize_t sheader_written;
+    unsigned int head_len = 0;
     sheader_wb = generateWriteBuf(500);
 
     sheader_size = writeSignatureHeaderIoUring(sheader, sheader_wb);
-
-    sqe = io_uring_get_sqe(ring_);
-    CHECK_GET_SQE(sqe)
-    io_uring_prep_write(sqe, dst_file->fd, sheader_wb->buf, sheader_size, dst_file->off);
-    sheader_written = getIoUringResult(ring_);
-    CHECK_IO_URING_WRITE_RETURN(sheader_size, sheader_written, "write signature header")
-    dst_file->off += sheader_written;
-
     non_empty_number = list->items[1]->total;
 
-    if (non_empty_number) {
-
-        for (int i = 0; i < non_empty_number; ++i) {
-
-            Qz7zFileItem_T *cur_file = qzListGet(list->items[1], i);
-            src_file_name = cur_file->fileName;
-
-            ret = lstat(src_file_name, &src_file_stat);
-            if (ret) {
-                QZ_ERROR("stat(): failed\n");
-                ret = QZ7Z_ERR_STAT;
-                goto exit;
-            }
-
-            if (S_ISBLK(src_file_stat.st_mode)) {
-                if ((src_fd = open(src_file_name, O_RDONLY)) < 0) {
-                    perror(src_file_name);
-                    ret = QZ7Z_ERR_OPEN;
-                    goto exit;
-                } else {
-                    if (ioctl(src_fd, BLKGETSIZE, &src_file_size) < 0) {
-                        close(src_fd);
-                        perror(src_file_name);
-                        ret = QZ7Z_ERR_IOCTL;
-                        goto exit;
-                    }
-                    src_file_size *= 512;
-                    /* size get via BLKGETSIZE is divided by 512 */
-                    close(src_fd);
-                }
-            } else {
-                src_file_size = src_file_stat.st_size;
-            }
-            src_buffer_size = (src_file_size > SRC_BUFF_LEN) ?
-                              SRC_BUFF_LEN : src_file_size;
-            dst_buffer_size = qzMaxCompressedLength(src_buffer_size, sess);
-
-            src_file = generateIoUringFile(src_file_name, O_RDONLY);
-            if (!src_file) {
-                QZ_ERROR("create %s error\n", src_file_name);
-                ret = QZ7Z_ERR_OPEN;
-                goto exit;
-            }
-
-            file_remaining = src_file_size;
-            read_more = 1;
-
-            n_part = src_file_size / SRC_BUFF_LEN;
-            n_part = (src_file_size % SRC_BUFF_LEN) ? n_part + 1 : n_part;
-            is_last = 0;
-            n_part_i = 1;
-
-            do {
-                is_last = (i == non_empty_number - 1) && (n_part_i++ == n_part);
-
-                if (read_more) {
-                    if (cur_file->isSymLink) {
-                        int size;
-                        size = readlink(cur_file->fileName, (char *)src_buffer,
-                                        src_buffer_size);
-                        bytes_read = size;
-                    } else {
-                        ssize_t temp_bytes_read;
-                        sqe = io_uring_get_sqe(ring_);
-                        CHECK_GET_SQE(sqe)
-                        io_uring_prep_read(sqe, src_file->fd, src_buffer, src_buffer_size, src_file->off);
-                        temp_bytes_read = getIoUringResult(ring_);
-                        if(temp_bytes_read <= 0) {
-                            bytes_read = 0;
-                        } else {
-                            bytes_read = temp_bytes_read;
-                        } 
-                        QZ_PRINT("Reading input file %s (%u Bytes)\n",
-                                 src_file_name, bytes_read);
-                        src_file->off += bytes_read;
-                    }
-                } else {
-                    bytes_read = file_remaining;
-                }
-
-                puts("Compressing...");
-
-                ret = doCompressBufferIoUring(sess, src_buffer, &bytes_read,
-                                       dst_buffer, &dst_buffer_size,
-                                       time_list_head, dst_file, &dst_file_size,
-                                       is_last, ring_);
-
-                if (QZ_DATA_ERROR == ret || QZ_BUF_ERROR == ret) {
-                    bytes_processed += bytes_read;
-                    if (0 != bytes_read) {
-                        src_file->off = bytes_processed;
-                        read_more = 1;
-                    } else if (QZ_BUF_ERROR == ret) {
-                        // dest buffer not long enough
-                        if (ratio_limit == ratio_idx) {
-                            QZ_ERROR("Could not expand more destination "
-                                     "buffer\n");
-                            ret = ERROR;
-                            goto exit;
-                        }
-
-                        free(dst_buffer);
-                        dst_buffer_size = src_buffer_size *
-                                          g_bufsz_expansion_ratio[ratio_idx++];
-                        dst_buffer = malloc(dst_buffer_size);
-                        if (NULL == dst_buffer) {
-                            QZ_ERROR("Fail to allocate destination buffer "
-                                     "with size %u\n", dst_buffer_size);
-                            ret = ERROR;
-                            goto exit;
-                        }
-
-                        read_more = 0;
-                    } else {
-                        // corrupt data
-                        ret = ERROR;
-                        goto exit;
-                    }
-                } else if (QZ_OK != ret) {
-                    QZ_ERROR("Process file error: %d\n", ret);
-                    ret = ERROR;
-                    goto exit;
-                } else {
-                    if (cur_file->isSymLink) {
-                        read_more = 0;
-                    } else {
-                        read_more = 1;
-                    }
-                }
-
-                file_remaining -= bytes_read;
-                total_compressed_size = dst_file_size;
-
-            } while (file_remaining > 0);
-
-            destroyIoUringFile(src_file);
-            src_file = NULL;
-        }// end for
-
+    if (g_direct && non_empty_number) {
+        /* O_DIRECT writes whole blocks, the header goes out with the first */
+        qzUringSetDirect(dst_file->fd, dst_file_name);
+        head_len = sheader_size;
     } else {
-        QZ_PRINT("Compressing...\n");
+        sqe = io_uring_get_sqe(ring_);
+        CHECK_GET_SQE(sqe)
+        io_uring_prep_write(sqe, dst_file->fd, sheader_wb->buf, sheader_size, dst_file->off);
+        sheader_written = getIoUringResult(ring_);
+        CHECK_IO_URING_WRITE_RETURN(sheader_size, sheader_written, "write signature header")
+        dst_file->off += sheader_written;
+    }
+
+    QZ_PRINT("Compressing...\n");
+    if (non_empty_number) {
+        ret = doCompressFilesPipelined(sess, list->items[1], dst_file,
+                                       (unsigned char *)sheader_wb->buf,
+                                       head_len,
+                                       ring_, time_list_head, &src_file_size,
+                                       &dst_file_size);
+        if (OK != ret) {
+            QZ_ERROR("Process file error: %d\n", ret);
+            goto exit;
+        }
+        total_compressed_size = dst_file_size;
     }
 
     eheader = generateEndHeader(list, total_compressed_size);
@@ -1136,15 +1134,6 @@ exit:
     if (eheader) {
         freeEndHeader(eheader, 1);
     }
-    if (src_file) {
-        destroyIoUringFile(src_file);
-    }
-    if (dst_buffer) {
-        free(dst_buffer);
-    }
-    if (src_buffer) {
-        free(src_buffer);
-    }
     if (sheader) {
         qzFree(sheader);
     }
@@ -2201,10 +2190,10 @@ int doDecompressFile(QzSession_T *sess, const char *src_file_name)
         sizeof(g_bufsz_expansion_ratio) / sizeof(unsigned int);
     unsigned int read_more = 0;
     int src_fd = 0;
+    unsigned int buff_len = qzipBuffSize(SRC_BUFF_LEN,
+                                         1 + g_bufsz_expansion_ratio[0]);
 
     int is_last;
-    int n_part; // how much parts can the src file be splited
-    int n_part_i;
     Qz7zSignatureHeader_T *sheader = NULL;
     Qz7zEndHeader_T *eheader = NULL;
     RunTimeList_T *run_time = NULL;
@@ -2323,8 +2312,8 @@ int doDecompressFile(QzSession_T *sess, const char *src_file_name)
         src_file_size -= sheader->nextHeaderSize;
         src_file_size -= 32;
 
-        src_buffer_size = (src_file_size > SRC_BUFF_LEN) ?
-                          SRC_BUFF_LEN : src_file_size;
+        src_buffer_size = (src_file_size > buff_len) ?
+                          buff_len : src_file_size;
         dst_buffer_size = src_buffer_size *
                           g_bufsz_expansion_ratio[ratio_idx++];
         saved_dst_buffer_size = dst_buffer_size;
@@ -2355,32 +2344,28 @@ int doDecompressFile(QzSession_T *sess, const char *src_file_name)
         file_remaining = src_file_size;
         read_more = 1;
 
-        n_part = src_file_size / SRC_BUFF_LEN;
-        n_part = (src_file_size % SRC_BUFF_LEN) ? n_part + 1 : n_part;
-        is_last = 0;
-        n_part_i = 1;
-
         off_t          cur_offset;
         cur_offset = 0;
-        int file_read_processed_size = 0;
+        off_t file_read_processed_size = 0;
         int need_check_file_with_same_name = 1;
 
         do {
-            is_last = (n_part_i++ == n_part);
-
             if (read_more) {
                 src_buffer = src_buffer_orig;
-                bytes_read = fread(src_buffer, 1, src_buffer_size, src_file);
+                /* the packed streams end where the end header starts */
+                bytes_read = fread(src_buffer, 1, (file_remaining <
+                                                   src_buffer_size) ?
+                                   file_remaining : src_buffer_size,
+                                   src_file);
                 QZ_PRINT("Reading input file %s (%u Bytes)\n", src_file_name,
                          bytes_read);
             } else {
                 bytes_read = file_remaining;
             }
+            is_last = (bytes_read == file_remaining);
 
             puts("Decompressing...");
 
-            if (n_part > 1 && is_last) bytes_read -= sheader->nextHeaderSize;
-
             int buffer_remaining = bytes_read;
             do {
                 bytes_read = buffer_remaining;
@@ -2393,8 +2378,8 @@ int doDecompressFile(QzSession_T *sess, const char *src_file_name)
                 buffer_remaining -= bytes_read;
                 if (QZ_DATA_ERROR == ret || QZ_BUF_ERROR == ret) {
                     if (0 != bytes_read) {
-                        if (-1 == fseek(src_file, file_read_processed_size,
-                                        SEEK_SET)) {
+                        if (-1 == fseek(src_file, 32 +
+                                        file_read_processed_size, SEEK_SET)) {
                             ret = ERROR;
                             goto exit;
                         }
@@ -2492,7 +2477,7 @@ int doDecompressFile(QzSession_T *sess, const char *src_file_name)
                     dst_buffer_size = saved_dst_buffer_size;
                 }
             } while (buffer_remaining);
-            file_remaining -= file_read_processed_size;
+            file_remaining = src_file_size - file_read_processed_size;
         } while (file_remaining > 0);
 
     } else {
@@ -2556,103 +2541,6 @@ int qz7zDecompress(QzSession_T *sess, const char *archive)
     return doDecompressFile(sess, archive);
 }
 
-/*
- * calculate a file's crc
- */
-static int64_t calculateCRC(char *filename, size_t n)
-{
-    clock_t start_crc_time = clock();
-    FILE          *fp;
-    uint32_t      crc = 0;
-    size_t        ret;
-
-    size_t remaining = n;
-    size_t len;
-
-    unsigned char *buf;
-    buf = malloc(SRC_BUFF_LEN);
-    if (!buf) {
-        QZ_ERROR("oom\n");
-        return QZ7Z_ERR_OOM;
-    }
-
-    fp = fopen(filename, "r");
-    if (!fp) {
-        QZ_ERROR("filename open error\n");
-        free(buf);
-        return QZ7Z_ERR_OPEN;
-    }
-
-    while (remaining > 0) {
-        if (remaining > SRC_BUFF_LEN)
-            len = SRC_BUFF_LEN;
-        else
-            len = remaining;
-
-        ret = fread(buf, 1, len, fp);
-        CHECK_FREAD_RETURN(ret, len)
-
-        crc = crc32(crc, buf, len);
-        remaining -= len;
-    }
-
-    free(buf);
-    fclose(fp);
-    QZ_DEBUG("%s crc: %08x\n", filename, crc);
-    clock_t end_crc_time = clock();
-    double duration = (end_crc_time - start_crc_time)/CLOCKS_PER_SEC;
-    QZ_PRINT("CRC Time: %fs\n", duration);
-    return crc;
-}
-
-static int64_t calculateCRCIoUring(char *filename, size_t n, struct io_uring *ring_)
-{
-    IoUringFile_T          *fp = NULL;
-    uint32_t      crc = 0;
-    ssize_t        ret;
-
-    size_t remaining = n;
-    size_t len;
-
-    struct io_uring_sqe *sqe;
-
-    unsigned char *buf;
-    buf = malloc(SRC_BUFF_LEN);
-    if (!buf) {
-        QZ_ERROR("oom\n");
-        return QZ7Z_ERR_OOM;
-    }
-
-    fp = generateIoUringFile(filename, O_RDONLY);
-    if (!fp) {
-        QZ_ERROR("filename open error\n");
-        free(buf);
-        return QZ7Z_ERR_OPEN;
-    }
-
-    while (remaining > 0) {
-        if (remaining > SRC_BUFF_LEN)
-            len = SRC_BUFF_LEN;
-        else
-            len = remaining;
-
-        sqe = io_uring_get_sqe(ring_);
-        CHECK_GET_SQE(sqe)
-        io_uring_prep_read(sqe, fp->fd, buf, len, fp->off);
-        ret = getIoUringResult(ring_);
-        CHECK_IO_URING_READ_RETURN(ret, len, "crc calculate")
-        fp->off += ret;
-
-        crc = crc32(crc, buf, len);
-        remaining -= len;
-    }
-
-    free(buf);
-    destroyIoUringFile(fp);
-    QZ_DEBUG("%s crc: %08x\n", filename, crc);
-    return crc;
-}
-
 void qzListDestroy(QzListHead_T *head)
 {
     Qz7zFileItem_T  *fi;
@@ -2694,28 +2582,6 @@ void itemListDestroy(Qz7zItemList_T *p)
     free(p);
 }
 
-static uint32_t calculateSymCRC(char *filename, size_t n)
-{
-    uint32_t   crc = 0;
-    char       *buf;
-    buf = malloc(PATH_MAX + 1);
-    if (!buf) {
-        QZ_ERROR("oom\n");
-        return 0;
-    }
-
-    ssize_t size = readlink(filename, buf, PATH_MAX);
-    if ((unsigned int)size != (unsigned int)n) {
-        QZ_ERROR("readlink error\n");
-        free(buf);
-        return 0;
-    }
-    crc = crc32(crc, (unsigned char *)buf, n);
-
-    free(buf);
-    return crc;
-}
-
 Qz7zFileItem_T *fileItemCreate(char *f)
 {
     Qz7zFileItem_T *p = malloc(sizeof(Qz7zFileItem_T));
@@ -2741,58 +2607,12 @@ Qz7zFileItem_T *fileItemCreate(char *f)
         }
         if (S_ISLNK(buf.st_mode)) {
             p->isSymLink = 1;
-            p->crc = calculateSymCRC(p->fileName, buf.st_size);
-            p->size = buf.st_size;
-        } else if (S_ISDIR(buf.st_mode)) {
-            p->isDir = 1;
-        } else {
-            p->size = buf.st_size;
-            p->isEmpty = buf.st_size ? 0 : 1;
-            p->crc = calculateCRC(p->fileName, p->size);
-        }
-        p->mtime = buf.st_mtime;
-        p->mtime_nano = buf.st_mtim.tv_nsec;
-        p->atime = buf.st_atime;
-        p->atime_nano = buf.st_atim.tv_nsec;
-        //p-7zip use 0x80000 as a unix file flag
-        p->attribute = buf.st_mode << 16 | (0x8000);
-    }
-    return p;
-}
-
-Qz7zFileItem_T *fileItemCreateIoUring(char *f, struct io_uring *ring_)
-{
-    Qz7zFileItem_T *p = malloc(sizeof(Qz7zFileItem_T));
-
-    if (p) {
-        memset(p, 0, sizeof(Qz7zFileItem_T));
-        p->nameLength = strlen(f) + 1;
-        p->fileName = (char *)malloc(p->nameLength);
-        if (!p->fileName) {
-            QZ_ERROR("oom\n");
-            free(p);
-            return NULL;
-        }
-        memset(p->fileName, 0, p->nameLength);
-        strcpy(p->fileName, f);
-    
-        struct stat buf;
-        if (lstat(p->fileName, &buf) < 0) {
-            QZ_ERROR("stat func error\n");
-            free(p->fileName);
-            free(p);
-            return NULL;
-        }
-        if (S_ISLNK(buf.st_mode)) {
-            p->isSymLink = 1;
-            p->crc = calculateSymCRC(p->fileName, buf.st_size);
             p->size = buf.st_size;
         } else if (S_ISDIR(buf.st_mode)) {
             p->isDir = 1;
         } else {
             p->size = buf.st_size;
             p->isEmpty = buf.st_size ? 0 : 1;
-            p->crc = calculateCRCIoUring(p->fileName, p->size, ring_);
         }
         p->mtime = buf.st_mtime;
         p->mtime_nano = buf.st_mtim.tv_nsec;
@@ -4040,108 +3860,6 @@ error:
     return NULL;
 }
 
-Qz7zItemList_T *itemListCreateIoUring(int n, char **files, struct io_uring *ring_)
-{
-    int      i;
-    uint32_t dir_index = 0;
-    // the index of next processing directory in the dir list
-    Qz7zFileItem_T *fi = NULL;
-    DIR *dirp = NULL;
-    Qz7zItemList_T *res = malloc(sizeof(Qz7zItemList_T));
-    if (!res) {
-        QZ_ERROR("malloc error\n");
-        return NULL;
-    }
-
-    res->items[0] = qzListCreate(QZ_DIRLIST_DEFAULT_NUM_PER_NODE);
-    res->items[1] = qzListCreate(QZ_FILELIST_DEFAULT_NUM_PER_NODE);
-
-    QzListHead_T *dirs_head = res->items[0];
-    QZ_DEBUG("dirs_head : %p\n", (void *)dirs_head);
-    QzListHead_T *files_head = res->items[1];
-    QZ_DEBUG("files_head : %p\n", (void *)files_head);
-    for (i = 0; i < n; ++i) {
-#ifdef QZ7Z_DEBUG
-        QZ_DEBUG("process %dth parameter: %s\n", i + 1, files[optind]);
-#endif
-
-        fi = fileItemCreateIoUring(files[optind], ring_);
-        if (!fi) {
-            QZ_ERROR("Cannot create file\n");
-            goto error;
-        }
-
-        if (fi->isDir || fi->isEmpty) {
-            qzListAdd(dirs_head, (void **)&fi);  // add it to directory list
-
-            while (dir_index < dirs_head->total) {
-                Qz7zFileItem_T  *processing =
-                    (Qz7zFileItem_T *)qzListGet(dirs_head, dir_index);
-
-                if (processing == NULL) {
-                    QZ_DEBUG("qzListGet got NULL!\n");
-                    goto error;
-                }
-                QZ_DEBUG("processing: %s\n", processing->fileName);
-
-                if (processing->isDir) {
-                    struct dirent *dentry;
-                    dirp = opendir(processing->fileName);
-                    if (!dirp) {
-                        QZ_ERROR("errors ocurs: %s \n", strerror(errno));
-                        goto error;
-                    }
-
-                    while ((dentry = readdir(dirp))) {
-                        char file_path[PATH_MAX + 1];
-                        memset(file_path, 0, PATH_MAX + 1);
-
-                        if (!strcmp(dentry->d_name, ".")) continue;
-                        if (!strcmp(dentry->d_name, "..")) continue;
-
-                        snprintf(file_path, sizeof file_path, "%s/%s",
-                                 processing->fileName, dentry->d_name);
-                        QZ_DEBUG(" file_path: %s\n", file_path);
-                        Qz7zFileItem_T *anotherfile =
-                            fileItemCreate(file_path);
-                        if (!anotherfile) {
-                            QZ_ERROR("Cannot create file\n");
-                            goto error;
-                        }
-
-                        if (anotherfile->isDir || anotherfile->isEmpty) {
-                            qzListAdd(dirs_head, (void **)&anotherfile);
-                        } else {
-                            qzListAdd(files_head, (void **)&anotherfile);
-                        }
-                    }
-                }
-                dir_index++;
-            }
-        } else {
-            qzListAdd(files_head, (void **)&fi);
-        }
-        optind++;
-    }// end for
-
-    /* now the res->items has been resolved successfully */
-    res->table = createCatagoryList();
-    scanFilesIntoCatagory(res);
-    return res;
-
-error:
-    if (dirp) {
-        closedir(dirp);
-    }
-    if (fi) {
-        free(fi);
-    }
-    if (res) {
-        itemListDestroy(res);
-    }
-    return NULL;
-}
-
 /**
  * return 1 if 7z archive is good, others if not
  */
@@ -46,6 +46,7 @@ int main(int argc, char **argv)
     Qz7zItemList_T *the_list;
     int is_good_7z = 0;
     int is_dir = 0;
+    int use_pool = 0; /* -T over several files */
     int recursive_mode = 0;
     errno = 0;
 
@@ -92,6 +93,8 @@ int main(int argc, char **argv)
                 g_params_th.huffman_hdr = QZ_STATIC_HDR;
             } else if (strcmp(optarg, "dynamic") == 0) {
                 g_params_th.huffman_hdr = QZ_DYNAMIC_HDR;
+            } else if (strcmp(optarg, "auto") == 0) {
+                g_params_th.huffman_hdr = QZ_AUTO_HDR;
             } else {
                 QZ_ERROR("Error huffman arg: %s\n", optarg);
                 return -1;
@@ -102,6 +105,8 @@ int main(int argc, char **argv)
                 g_params_th.data_fmt = QZ_DEFLATE_GZIP;
             } else if (strcmp(optarg, "gzipext") == 0) {
                 g_params_th.data_fmt = QZ_DEFLATE_GZIP_EXT;
+            } else if (strcmp(optarg, "bgzf") == 0) {
+                g_params_th.data_fmt = QZ_DEFLATE_BGZF;
             } else if (strcmp(optarg, "7z") == 0) {
                 g_params_th.data_fmt = QZ_DEFLATE_RAW;
             } else {
@@ -112,6 +117,9 @@ int main(int argc, char **argv)
         case 'o':
             out_name = optarg;
             break;
+        case 'G':
+            g_params_th.member_index = 1;
+            break;
         case 'L':
             g_params_th.comp_lvl = GET_LOWER_32BITS(strtoul(optarg, &stop, 0));
             if (*stop != '\0' || ERANGE == errno ||
@@ -150,6 +158,76 @@ int main(int argc, char **argv)
                 return -1;
             }
             break;
+        case 'I':
+            if (strcmp(optarg, "stdio") == 0) {
+                g_io_uring = 0;
+            } else if (strcmp(optarg, "uring") == 0) {
+                g_io_uring = 1;
+            } else {
+                QZ_ERROR("Error io arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'D':
+            g_direct = 1;
+            break;
+        case 'S':
+            g_uring_conf.entries = GET_LOWER_32BITS(strtoul(optarg, &stop, 0));
+            if (*stop != '\0' || ERANGE == errno ||
+                0 == g_uring_conf.entries || g_uring_conf.entries > 32768) {
+                QZ_ERROR("Error ring size arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'Q':
+            g_uring_conf.flags |= IORING_SETUP_SQPOLL;
+            if (optarg) {
+                g_uring_conf.sq_cpu = GET_LOWER_32BITS(strtoul(optarg, &stop,
+                                                               0));
+                if (*stop != '\0' || ERANGE == errno ||
+                    g_uring_conf.sq_cpu < 0) {
+                    QZ_ERROR("Error sqpoll cpu arg: %s\n", optarg);
+                    return -1;
+                }
+            }
+            break;
+        case 'U':
+            g_uring_conf.flags |= IORING_SETUP_COOP_TASKRUN |
+                                  IORING_SETUP_SINGLE_ISSUER;
+            break;
+        case 'B':
+            g_bench = 1;
+            break;
+        case 'T':
+            g_threads = GET_LOWER_32BITS(strtoul(optarg, &stop, 0));
+            if (*stop != '\0' || ERANGE == errno || 0 == g_threads ||
+                g_threads > QZIP_MAX_THREADS) {
+                QZ_ERROR("Error threads arg: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'M':
+            g_mem_limit = strtoul(optarg, &stop, 0);
+            switch (*stop) {
+            case 'G':
+            case 'g':
+                g_mem_limit <<= 10;
+            /* fall through */
+            case 'M':
+            case 'm':
+                g_mem_limit <<= 10;
+            /* fall through */
+            case 'K':
+            case 'k':
+                g_mem_limit <<= 10;
+                stop++;
+                break;
+            }
+            if (*stop != '\0' || ERANGE == errno || 0 == g_mem_limit) {
+                QZ_ERROR("Error mem-limit arg: %s\n", optarg);
+                return -1;
+            }
+            break;
         default:
             tryHelp();
         }
@@ -161,6 +239,28 @@ int main(int argc, char **argv)
         exit(OK);
     }
 
+    if (g_bench && (g_decompress || 0 == g_io_uring || 0 == arg_count ||
+                    QZ_DEFLATE_RAW == g_params_th.data_fmt ||
+                    1 == g_params_th.member_index)) {
+        QZ_ERROR("--bench compresses FILEs with --io uring to gzip, "
+                 "gzipext or bgzf without --gzi\n");
+        return -1;
+    }
+
+    if (g_direct && 0 == g_io_uring) {
+        QZ_ERROR("--direct only applies to --io uring\n");
+        return -1;
+    }
+    if (g_direct) {
+        g_io_uring = 1;
+    }
+
+    if (1 == g_params_th.member_index &&
+        (g_decompress || QZ_DEFLATE_BGZF != g_params_th.data_fmt)) {
+        QZ_ERROR("--gzi only applies to compressing with -O bgzf\n");
+        return -1;
+    }
+
     if (g_decompress) {
         g_params_th.direction = QZ_DIR_DECOMPRESS;
     } else {
@@ -171,10 +271,16 @@ int main(int argc, char **argv)
         exit(ERROR);
     }
 
-    const int init_io_uring_res = io_uring_queue_init(256, &ring, 0);
-    if(init_io_uring_res != 0) {
-        QZ_ERROR("Init Io_Uring failed\n");
-        exit(init_io_uring_res);
+    if (g_bench) {
+        ret = benchIoUring(&g_sess, arg_count, argv + optind);
+        if (qatzipClose(&g_sess)) {
+            exit(ERROR);
+        }
+        return ret;
+    }
+
+    if (qzUringSetup(&ring, &g_uring_conf)) {
+        exit(ERROR);
     }
 
     if (0 == arg_count) {
@@ -212,9 +318,19 @@ int main(int argc, char **argv)
         if (!the_list) {
             exit(ERROR);
         }
-        ret = qz7zCompress(&g_sess, the_list, out_name);
+        if (g_io_uring) {
+            ret = qz7zCompressIoUring(&g_sess, the_list, out_name, &ring);
+        } else {
+            ret = qz7zCompress(&g_sess, the_list, out_name);
+        }
         itemListDestroy(the_list);
     } else {  // decompress from 7z; compress into gz; decompress from gz
+        /* a single file is split over the -T workers instead */
+        use_pool = g_threads > 1 &&
+                   (arg_count > 1 || checkDirectory(argv[optind]));
+        if (use_pool && qzipPoolStart(g_threads)) {
+            exit(ERROR);
+        }
         while (optind < argc) {
 
             if (access(argv[optind], F_OK)) {
@@ -274,6 +390,9 @@ int main(int argc, char **argv)
                             g_decompress == 0);
             }
         }
+        if (use_pool) {
+            qzipPoolFinish();
+        }
     }
 
     if (qatzipClose(&g_sess)) {
@@ -0,0 +1,602 @@
+/***************************************************************************
+ *
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2007-2021 Intel Corporation. All rights reserved.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***************************************************************************/
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include "qzip.h"
+
+/* io_uring_enter calls of all pipelines and threads, for --bench */
+static unsigned long g_enter_count = 0;
+
+/* index of fd in the registered file table, -1 if not registered */
+static int fixedFile(QzUringPipe_T *pipe, int fd)
+{
+    if (NULL == pipe->files || fd < 0) {
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < pipe->n_files; i++) {
+        if (pipe->files[i] == fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void prepSlot(QzUringPipe_T *pipe, QzUringSlot_T *slot)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(pipe->ring);
+    int idx = fixedFile(pipe, slot->fd);
+    int fd = (idx >= 0) ? idx : slot->fd;
+
+    if (NULL == sqe) {
+        /* SQ ring full, flush what is queued and retry */
+        qzUringSubmit(pipe);
+        sqe = io_uring_get_sqe(pipe->ring);
+    }
+    CHECK_GET_SQE(sqe)
+
+    if (QZ_SLOT_READING == slot->state) {
+        unsigned char *buf = slot->src + slot->head + slot->io_done;
+        unsigned int len = slot->io_len - slot->io_done;
+        off_t off = slot->off + slot->io_done;
+
+        if (pipe->align) {
+            /* O_DIRECT wants whole blocks, reading past EOF is fine */
+            len = (len + pipe->align - 1) & ~(pipe->align - 1);
+            if (len > slot->src_sz - slot->head - slot->io_done) {
+                len = slot->src_sz - slot->head - slot->io_done;
+            }
+        }
+
+        if (pipe->iovecs) {
+            io_uring_prep_read_fixed(sqe, fd, buf, len, off, slot->buf_idx);
+        } else {
+            io_uring_prep_read(sqe, fd, buf, len, off);
+        }
+    } else {
+        unsigned char *buf = slot->dst + slot->wr_start + slot->io_done;
+        unsigned int len = slot->io_len - slot->io_done;
+        off_t off = slot->off + slot->io_done;
+
+        if (pipe->iovecs) {
+            io_uring_prep_write_fixed(sqe, fd, buf, len, off,
+                                      slot->buf_idx + 1);
+        } else {
+            io_uring_prep_write(sqe, fd, buf, len, off);
+        }
+    }
+    if (idx >= 0) {
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    }
+    io_uring_sqe_set_data(sqe, slot);
+    pipe->queued++;
+}
+
+static void completeSlot(QzUringPipe_T *pipe, QzUringSlot_T *slot, int res)
+{
+    int is_read = (QZ_SLOT_READING == slot->state);
+
+    pipe->inflight--;
+    if (res < 0 || (0 == res && !is_read)) {
+        QZ_ERROR("io_uring %s failed: %s\n", is_read ? "read" : "write",
+                 res < 0 ? strerror(-res) : "no progress");
+        pipe->error = ERROR;
+        return;
+    }
+
+    slot->io_done += res;
+    if (res > 0 && slot->io_done < slot->io_len) {
+        /* short transfer, queue the remainder */
+        prepSlot(pipe, slot);
+        return;
+    }
+
+    if (is_read) {
+        /* a zero length read is EOF, the caller checks src_len */
+        slot->src_len = (slot->io_done < slot->io_len) ?
+                        slot->io_done : slot->io_len;
+        slot->state = QZ_SLOT_READY;
+    } else {
+        slot->state = QZ_SLOT_FREE;
+    }
+}
+
+/* pinned memory lets the library hand the buffer to HW without a copy */
+static unsigned char *allocIoBuf(unsigned int sz, unsigned int align)
+{
+    unsigned char *buf = NULL;
+
+    if (align) {
+        /* O_DIRECT alignment, qzFree falls back to free() for it */
+        if (posix_memalign((void **)&buf, align, sz)) {
+            return NULL;
+        }
+        return buf;
+    }
+
+    buf = qzMalloc(sz, 0, PINNED_MEM);
+    if (NULL == buf) {
+        buf = qzMalloc(sz, 0, COMMON_MEM);
+    }
+    return buf;
+}
+
+static void registerBuffers(QzUringPipe_T *pipe)
+{
+    unsigned int n = 0;
+
+    pipe->iovecs = calloc(2 * pipe->depth, sizeof(struct iovec));
+    if (NULL == pipe->iovecs) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < pipe->depth; i++) {
+        QzUringSlot_T *slot = &pipe->slots[i];
+        slot->buf_idx = n;
+        pipe->iovecs[n].iov_base = slot->src;
+        pipe->iovecs[n++].iov_len = slot->src_sz;
+        if (slot->dst) {
+            pipe->iovecs[n].iov_base = slot->dst;
+            pipe->iovecs[n++].iov_len = pipe->align + slot->dst_sz;
+        }
+    }
+
+    if (io_uring_register_buffers(pipe->ring, pipe->iovecs, n)) {
+        QZ_DEBUG("io_uring refused buffer registration, "
+                 "using plain read/write\n");
+        free(pipe->iovecs);
+        pipe->iovecs = NULL;
+    }
+}
+
+static void registerFiles(QzUringPipe_T *pipe)
+{
+    /* the output, the file being opened and one source per slot */
+    pipe->n_files = pipe->depth + 2;
+    pipe->files = malloc(pipe->n_files * sizeof(int));
+    if (NULL == pipe->files) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < pipe->n_files; i++) {
+        pipe->files[i] = -1;
+    }
+
+    if (io_uring_register_files(pipe->ring, pipe->files, pipe->n_files)) {
+        QZ_DEBUG("io_uring refused file registration, using plain fds\n");
+        free(pipe->files);
+        pipe->files = NULL;
+    }
+}
+
+QzUringPipe_T *qzUringPipeCreate(struct io_uring *ring_, unsigned int depth,
+                                 unsigned int src_sz, unsigned int dst_sz,
+                                 unsigned int align)
+{
+    QzUringPipe_T *pipe = calloc(1, sizeof(QzUringPipe_T));
+    if (NULL == pipe) {
+        return NULL;
+    }
+
+    pipe->ring = ring_;
+    pipe->depth = depth;
+    pipe->align = align;
+    if (align && posix_memalign((void **)&pipe->tail, align, align)) {
+        pipe->tail = NULL;
+        goto fail;
+    }
+    pipe->slots = calloc(depth, sizeof(QzUringSlot_T));
+    if (NULL == pipe->slots) {
+        goto fail;
+    }
+
+    for (unsigned int i = 0; i < depth; i++) {
+        QzUringSlot_T *slot = &pipe->slots[i];
+        slot->src = allocIoBuf(src_sz, align);
+        if (NULL == slot->src) {
+            goto fail;
+        }
+        if (dst_sz) {
+            /* room in front of the output for the unaligned tail of
+             * earlier output */
+            slot->dst = allocIoBuf(align + dst_sz, align);
+            if (NULL == slot->dst) {
+                goto fail;
+            }
+        }
+        slot->src_sz = src_sz;
+        slot->dst_sz = dst_sz;
+        slot->state = QZ_SLOT_FREE;
+        slot->fd = -1;
+    }
+
+    registerBuffers(pipe);
+    registerFiles(pipe);
+    return pipe;
+
+fail:
+    qzUringPipeDestroy(pipe);
+    return NULL;
+}
+
+void qzUringPipeDestroy(QzUringPipe_T *pipe)
+{
+    if (NULL == pipe) {
+        return;
+    }
+
+    if (pipe->inflight || pipe->queued) {
+        /* buffers may still be owned by the kernel */
+        qzUringDrain(pipe);
+    }
+
+    if (pipe->iovecs) {
+        io_uring_unregister_buffers(pipe->ring);
+        free(pipe->iovecs);
+    }
+    if (pipe->files) {
+        io_uring_unregister_files(pipe->ring);
+        free(pipe->files);
+    }
+
+    if (pipe->slots) {
+        for (unsigned int i = 0; i < pipe->depth; i++) {
+            qzFree(pipe->slots[i].src);
+            qzFree(pipe->slots[i].dst);
+        }
+        free(pipe->slots);
+    }
+    free(pipe->tail);
+    free(pipe);
+}
+
+/*
+ * Add fd to the registered file table. I/O on an fd that could not be
+ * registered still works through the plain fd.
+ */
+void qzUringRegisterFile(QzUringPipe_T *pipe, int fd)
+{
+    unsigned int idx;
+
+    if (NULL == pipe->files || fixedFile(pipe, fd) >= 0) {
+        return;
+    }
+
+    for (idx = 0; idx < pipe->n_files; idx++) {
+        if (-1 == pipe->files[idx]) {
+            break;
+        }
+    }
+    if (idx == pipe->n_files) {
+        return;
+    }
+
+    pipe->files[idx] = fd;
+    if (1 != io_uring_register_files_update(pipe->ring, idx,
+                                            &pipe->files[idx], 1)) {
+        pipe->files[idx] = -1;
+    }
+}
+
+void qzUringUnregisterFile(QzUringPipe_T *pipe, int fd)
+{
+    int idx = fixedFile(pipe, fd);
+
+    if (idx < 0) {
+        return;
+    }
+
+    pipe->files[idx] = -1;
+    io_uring_register_files_update(pipe->ring, idx, &pipe->files[idx], 1);
+}
+
+/* keep len bytes of output back, the next output goes in behind them */
+static void setTail(QzUringPipe_T *pipe, const void *buf, unsigned int len)
+{
+    memcpy(pipe->tail, buf, len);
+    pipe->tail_len = len;
+    for (unsigned int i = 0; i < pipe->depth; i++) {
+        pipe->slots[i].dst_head = len;
+    }
+}
+
+void qzUringRead(QzUringPipe_T *pipe, QzUringSlot_T *slot, int fd,
+                 off_t off, unsigned int len)
+{
+    assert(QZ_SLOT_FREE == slot->state && slot->head + len <= slot->src_sz);
+    slot->state = QZ_SLOT_READING;
+    slot->fd = fd;
+    slot->off = off;
+    slot->io_len = len;
+    slot->io_done = 0;
+    slot->src_len = 0;
+    pipe->n_read++;
+    prepSlot(pipe, slot);
+}
+
+/*
+ * Queue the dst_len bytes of output at dst + dst_head for writing at the
+ * output offset. With O_DIRECT only whole blocks go out: the unaligned
+ * tail of earlier output is put in front and the new tail is kept back.
+ */
+void qzUringWrite(QzUringPipe_T *pipe, QzUringSlot_T *slot, int fd)
+{
+    unsigned int start = slot->dst_head;
+    unsigned int len = slot->dst_len;
+
+    assert(QZ_SLOT_READY == slot->state && len <= slot->dst_sz);
+    if (pipe->align) {
+        /* the output sits right behind room for the tail, so the write
+         * starts at the aligned dst */
+        assert(slot->dst_head == pipe->tail_len);
+        start = 0;
+        memcpy(slot->dst, pipe->tail, pipe->tail_len);
+        len += pipe->tail_len;
+        setTail(pipe, slot->dst + len - (len & (pipe->align - 1)),
+                len & (pipe->align - 1));
+        len -= pipe->tail_len;
+    }
+
+    if (0 == len) {
+        slot->state = QZ_SLOT_FREE;
+        return;
+    }
+
+    slot->state = QZ_SLOT_WRITING;
+    slot->fd = fd;
+    slot->off = pipe->out_off;
+    slot->wr_start = start;
+    slot->io_len = len;
+    slot->io_done = 0;
+    pipe->out_off += len;
+    pipe->n_write++;
+    prepSlot(pipe, slot);
+}
+
+/*
+ * Start the output at off with len bytes already in buf. With O_DIRECT,
+ * off must be aligned and len below the alignment.
+ */
+void qzUringOutStart(QzUringPipe_T *pipe, off_t off, const void *buf,
+                     unsigned int len)
+{
+    assert(0 == pipe->align || (0 == (off & (pipe->align - 1)) &&
+                                len < pipe->align));
+    pipe->out_off = off;
+    if (pipe->align) {
+        setTail(pipe, buf, len);
+    }
+}
+
+/*
+ * Wait for all output and write the kept back tail. fd leaves O_DIRECT for
+ * it, so whatever the caller writes next is plain buffered I/O.
+ */
+int qzUringFlush(QzUringPipe_T *pipe, int fd)
+{
+    int flags;
+
+    if (qzUringDrain(pipe)) {
+        return pipe->error;
+    }
+    if (0 == pipe->align) {
+        return OK;
+    }
+
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+        perror("fcntl");
+        return ERROR;
+    }
+    if (pipe->tail_len &&
+        pwrite(fd, pipe->tail, pipe->tail_len, pipe->out_off) !=
+        (ssize_t)pipe->tail_len) {
+        perror("pwrite");
+        return ERROR;
+    }
+    pipe->out_off += pipe->tail_len;
+    setTail(pipe, pipe->tail, 0);
+    return OK;
+}
+
+/*
+ * Set up ring_ as conf asks. The ring is sized for one SQE per pipeline
+ * slot plus one synchronous request unless conf->entries is set. Flags the
+ * kernel refuses are dropped, the optional ones first, and conf->flags is
+ * left with what was applied.
+ */
+int qzUringSetup(struct io_uring *ring_, QzUringConf_T *conf)
+{
+    struct io_uring_params params;
+    unsigned int entries = conf->entries ? conf->entries :
+                           QZ_URING_DEPTH_DEFAULT + 1;
+    unsigned int taskrun = IORING_SETUP_COOP_TASKRUN |
+                           IORING_SETUP_SINGLE_ISSUER;
+    int ret;
+
+    for (;;) {
+        memset(&params, 0, sizeof(params));
+        params.flags = conf->flags;
+        if ((conf->flags & IORING_SETUP_SQPOLL) && conf->sq_cpu >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = conf->sq_cpu;
+        }
+
+        ret = io_uring_queue_init_params(entries, ring_, &params);
+        if (0 == ret) {
+            return OK;
+        }
+
+        if (conf->flags & taskrun) {
+            QZ_ERROR("io_uring: COOP_TASKRUN/SINGLE_ISSUER refused (%s), "
+                     "not using them\n", strerror(-ret));
+            conf->flags &= ~taskrun;
+        } else if (conf->flags & IORING_SETUP_SQPOLL) {
+            QZ_ERROR("io_uring: SQPOLL refused (%s), not using it\n",
+                     strerror(-ret));
+            conf->flags &= ~IORING_SETUP_SQPOLL;
+        } else {
+            QZ_ERROR("Init Io_Uring failed: %s\n", strerror(-ret));
+            return ret;
+        }
+    }
+}
+
+unsigned long qzUringEnterCount(void)
+{
+    return g_enter_count;
+}
+
+/* Switch fd to O_DIRECT, file systems that refuse it stay buffered */
+void qzUringSetDirect(int fd, const char *file_name)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) < 0) {
+        QZ_ERROR("%s: O_DIRECT not supported, using buffered I/O\n",
+                 file_name);
+    }
+}
+
+int qzUringOpen(const char *file_name, int flags, mode_t mode)
+{
+    int fd = open(file_name, flags, mode);
+
+    if (fd >= 0 && g_direct) {
+        qzUringSetDirect(fd, file_name);
+    }
+    return fd;
+}
+
+/*
+ * Submit what is queued and, with wait_nr set, wait for that many
+ * completions in the same io_uring_enter.
+ */
+static int submitWait(QzUringPipe_T *pipe, unsigned int wait_nr)
+{
+    int ret;
+
+    if (0 == pipe->queued && 0 == wait_nr) {
+        return 0;
+    }
+
+    /* an SQPOLL thread picks SQEs up by itself unless it fell asleep */
+    if (wait_nr || !(pipe->ring->flags & IORING_SETUP_SQPOLL) ||
+        (*pipe->ring->sq.kflags & IORING_SQ_NEED_WAKEUP)) {
+        pipe->n_enter++;
+        __atomic_add_fetch(&g_enter_count, 1, __ATOMIC_RELAXED);
+    }
+
+    do {
+        ret = io_uring_submit_and_wait(pipe->ring, wait_nr);
+    } while (-EINTR == ret);
+    if (ret < 0) {
+        QZ_ERROR("io_uring submit failed: %s\n", strerror(-ret));
+        pipe->error = ERROR;
+        return ret;
+    }
+    if (0 == ret) {
+        return 0;
+    }
+
+    pipe->queued -= ret;
+    pipe->inflight += ret;
+    pipe->n_submit++;
+    pipe->depth_sum += pipe->inflight;
+    if (pipe->inflight > pipe->max_inflight) {
+        pipe->max_inflight = pipe->inflight;
+    }
+    return ret;
+}
+
+int qzUringSubmit(QzUringPipe_T *pipe)
+{
+    return submitWait(pipe, 0);
+}
+
+/*
+ * Dispatch every available completion to its slot. With wait set, block
+ * for at least one completion if anything is in flight.
+ */
+int qzUringReap(QzUringPipe_T *pipe, int wait)
+{
+    struct io_uring_cqe *cqe = NULL;
+    int n = 0;
+
+    if (wait && (pipe->inflight || pipe->queued) &&
+        io_uring_peek_cqe(pipe->ring, &cqe)) {
+        /* nothing completed yet */
+        submitWait(pipe, 1);
+    } else {
+        qzUringSubmit(pipe);
+    }
+
+    while (0 == io_uring_peek_cqe(pipe->ring, &cqe)) {
+        QzUringSlot_T *slot = io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+
+        io_uring_cqe_seen(pipe->ring, cqe);
+        completeSlot(pipe, slot, res);
+        n++;
+    }
+
+    /* push out remainders of short transfers */
+    qzUringSubmit(pipe);
+    return pipe->error ? -pipe->error : n;
+}
+
+int qzUringDrain(QzUringPipe_T *pipe)
+{
+    while (pipe->inflight || pipe->queued) {
+        if (qzUringReap(pipe, 1) < 0 && 0 == pipe->inflight) {
+            break;
+        }
+    }
+    return pipe->error;
+}
+
+void qzUringReport(QzUringPipe_T *pipe)
+{
+    double avg = pipe->n_submit ?
+                 (double)pipe->depth_sum / pipe->n_submit : 0;
+
+    QZ_PRINT("io_uring: %lu reads, %lu writes in %lu submits, "
+             "%lu io_uring_enter calls\n",
+             pipe->n_read, pipe->n_write, pipe->n_submit, pipe->n_enter);
+    QZ_PRINT("io_uring queue depth: avg %.2f max %u of %u slots, "
+             "%lu compressor stalls\n",
+             avg, pipe->max_inflight, pipe->depth, pipe->n_stall);
+}